@@ -0,0 +1,531 @@
+// bench_detection.cpp
+// 偵測流程各階段的微基準測試 (Google Benchmark)
+// 灰階轉換、模糊、Otsu 二值化、輪廓擷取、面積過濾與繪製各自計時，不含 HighGUI 與標準輸出；
+// 同一階段的 OpenCV 路徑與替代核心並列，作為接受或退回處理器最佳化的依據
+//
+// 輸入以 res/density 參數選擇：res 0~2 為 VGA/720p/1080p 的合成畫面，density 為每百萬像素的物體數等級；
+// res 3 為範例圖像 img1.png（可用環境變數 BENCH_IMAGE 指定其他圖像）
+// 計數器：
+//   s/px          每像素時間（顯示為 n 即奈秒）
+//   allocs/frame  每幀的記憶體配置次數（malloc 系列，包含 OpenCV 的緩衝區）
+//   threads       參與運算的執行緒數
+//   first_ms/p50_ms  BM_ProcessImage_FirstFrame：新處理器的第一幀與之後穩態的中位數（毫秒）
+// 計時：OpenCV 的函數在內部使用多執行緒，CPU 時間只計主執行緒，會低估其成本；
+// 因此 OpenCV 路徑與並列比較的替代核心都以實際經過時間 (UseRealTime) 計時
+#include "frame_kernels.h"
+#include "tiled_filter.h"
+#include "object_labeling.h"
+#include "processed_object.h"
+#include "image_processor.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef BENCH_SAMPLE_IMAGE
+#define BENCH_SAMPLE_IMAGE "img1.png"
+#endif
+
+namespace {
+
+// 記憶體配置計數：取代 malloc 系列並轉呼叫 glibc 的實作，operator new 與 cv::fastMalloc 都會經過這裡
+std::atomic<uint64_t> g_allocations{0};
+
+} // namespace
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+}
+#endif
+
+namespace {
+
+constexpr int BLUR_SIZE = 5;
+constexpr double MIN_OBJECT_AREA = 500.0;   // 與 ImageProcessor 的預設值相同
+
+struct Resolution {
+    int width;
+    int height;
+    const char* name;
+};
+
+const Resolution RESOLUTIONS[] = {{640, 480, "VGA"}, {1280, 720, "720p"}, {1920, 1080, "1080p"}};
+constexpr int SAMPLE_IMAGE = 3;
+
+// 每百萬像素的物體數
+const int DENSITIES[] = {20, 200, 2000};
+
+// 各階段的輸入，以 OpenCV 路徑預先算好，每種參數只產生一次
+struct StageInputs {
+    std::string label;
+    cv::Mat image;
+    cv::Mat gray;
+    cv::Mat blurred;
+    cv::Mat binary;
+    std::vector<std::vector<cv::Point>> contours;
+    std::vector<ProcessedObject> objects;
+};
+
+// 合成畫面：淺色帶噪點的背景上散布大小不一的深色橢圓，部分小於面積門檻
+cv::Mat makeScene(const Resolution& resolution, int density, uint64_t seed) {
+    cv::RNG rng(seed);
+    cv::Mat scene(resolution.height, resolution.width, CV_8UC3, cv::Scalar(200, 200, 200));
+
+    const int object_count = static_cast<int>(static_cast<double>(density) * resolution.width * resolution.height / 1e6);
+    for (int i = 0; i < object_count; i++) {
+        cv::Point center(rng.uniform(0, resolution.width), rng.uniform(0, resolution.height));
+        cv::Size axes(rng.uniform(4, 40), rng.uniform(4, 40));
+        int shade = rng.uniform(0, 90);
+        cv::ellipse(scene, center, axes, rng.uniform(0, 180), 0, 360, cv::Scalar(shade, shade, shade), cv::FILLED);
+    }
+
+    // 帶正負號的感光噪點，加回時飽和到 0~255
+    cv::Mat noise(scene.size(), CV_16SC3);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 8);
+    cv::add(scene, noise, scene, cv::noArray(), CV_8UC3);
+    return scene;
+}
+
+const StageInputs* inputsFor(benchmark::State& state) {
+    static std::map<std::pair<int, int>, StageInputs> cache;
+
+    const int res = static_cast<int>(state.range(0));
+    const int density = static_cast<int>(state.range(1));
+    auto it = cache.find({res, density});
+    if (it != cache.end()) {
+        return &it->second;
+    }
+
+    StageInputs inputs;
+    if (res == SAMPLE_IMAGE) {
+        const char* path = std::getenv("BENCH_IMAGE");
+        if (!path) path = BENCH_SAMPLE_IMAGE;
+        inputs.image = cv::imread(path);
+        if (inputs.image.empty()) {
+            state.SkipWithError(("無法讀取範例圖像: " + std::string(path)).c_str());
+            return nullptr;
+        }
+        inputs.label = "img1 " + std::to_string(inputs.image.cols) + "x" + std::to_string(inputs.image.rows);
+    } else {
+        inputs.image = makeScene(RESOLUTIONS[res], DENSITIES[density], 12345 + res * 10 + density);
+        inputs.label = std::string(RESOLUTIONS[res].name) + " " + std::to_string(DENSITIES[density]) + " obj/MP";
+    }
+
+    cv::cvtColor(inputs.image, inputs.gray, cv::COLOR_BGR2GRAY);
+    cv::GaussianBlur(inputs.gray, inputs.blurred, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+    cv::threshold(inputs.blurred, inputs.binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+    cv::findContours(inputs.binary, inputs.contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    objectsFromContours(inputs.contours, MIN_OBJECT_AREA, inputs.objects);
+
+    return &cache.emplace(std::make_pair(res, density), std::move(inputs)).first->second;
+}
+
+// 在計時循環結束後設置計數器
+void setFrameCounters(benchmark::State& state, const StageInputs& inputs, uint64_t allocations, int threads) {
+    state.SetLabel(inputs.label);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["s/px"] = benchmark::Counter(static_cast<double>(inputs.image.total()),
+                                                benchmark::Counter::kIsIterationInvariantRate |
+                                                    benchmark::Counter::kInvert);
+    state.counters["allocs/frame"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+    state.counters["threads"] = threads;
+}
+
+// 所有解析度與密度的組合，加上範例圖像
+void frameArgs(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"res", "density"});
+    for (int res = 0; res < SAMPLE_IMAGE; res++) {
+        for (int density = 0; density < static_cast<int>(std::size(DENSITIES)); density++) {
+            bench->Args({res, density});
+        }
+    }
+    bench->Args({SAMPLE_IMAGE, 0});
+}
+
+// 像素級的階段與物體數無關，只跑中等密度與範例圖像
+void pixelArgs(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"res", "density"});
+    for (int res = 0; res < SAMPLE_IMAGE; res++) {
+        bench->Args({res, 1});
+    }
+    bench->Args({SAMPLE_IMAGE, 0});
+}
+
+// 條帶平行的版本另外加上執行緒數
+void tiledArgs(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"res", "density", "threads"});
+    for (int threads : {2, 4}) {
+        for (int res = 0; res < SAMPLE_IMAGE; res++) {
+            bench->Args({res, 1, threads});
+        }
+        bench->Args({SAMPLE_IMAGE, 0, threads});
+    }
+}
+
+uint64_t allocationCount() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+// ---- 灰階轉換 ----
+
+void BM_CvtColor_OpenCV(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    cv::Mat gray;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        cv::cvtColor(inputs->image, gray, cv::COLOR_BGR2GRAY);
+        benchmark::DoNotOptimize(gray.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, cv::getNumThreads());
+}
+BENCHMARK(BM_CvtColor_OpenCV)->Apply(pixelArgs)->UseRealTime();
+
+void BM_CvtColor_Specialized(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    cv::Mat gray(inputs->image.rows, inputs->image.cols, CV_8UC1);
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        for (int y = 0; y < inputs->image.rows; y++) {
+            frame_kernels::grayRow<uint8_t, 3>(inputs->image.ptr<uint8_t>(y), gray.ptr<uint8_t>(y), inputs->image.cols);
+        }
+        benchmark::DoNotOptimize(gray.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, 1);
+}
+BENCHMARK(BM_CvtColor_Specialized)->Apply(pixelArgs)->UseRealTime();
+
+// ---- 高斯模糊 ----
+
+void BM_Blur_OpenCV(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    cv::Mat blurred;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        cv::GaussianBlur(inputs->gray, blurred, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+        benchmark::DoNotOptimize(blurred.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, cv::getNumThreads());
+}
+BENCHMARK(BM_Blur_OpenCV)->Apply(pixelArgs)->UseRealTime();
+
+void BM_Blur_Specialized(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    cv::Mat blurred;
+    cv::Mat workspace;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        frame_kernels::gaussianBlur8u<BLUR_SIZE>(inputs->gray, blurred, workspace);
+        benchmark::DoNotOptimize(blurred.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, 1);
+}
+BENCHMARK(BM_Blur_Specialized)->Apply(pixelArgs)->UseRealTime();
+
+// ---- Otsu 二值化 ----
+
+void BM_Otsu_OpenCV(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    cv::Mat binary;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        cv::threshold(inputs->blurred, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+        benchmark::DoNotOptimize(binary.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, cv::getNumThreads());
+}
+BENCHMARK(BM_Otsu_OpenCV)->Apply(pixelArgs)->UseRealTime();
+
+// ---- 灰階 + 模糊 + 二值化（處理器實際使用的三種組合） ----
+
+void BM_GrayBlurOtsu_OpenCV(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    cv::Mat gray;
+    cv::Mat blurred;
+    cv::Mat binary;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        cv::cvtColor(inputs->image, gray, cv::COLOR_BGR2GRAY);
+        cv::GaussianBlur(gray, blurred, cv::Size(BLUR_SIZE, BLUR_SIZE), 0);
+        cv::threshold(blurred, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+        benchmark::DoNotOptimize(binary.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, cv::getNumThreads());
+}
+BENCHMARK(BM_GrayBlurOtsu_OpenCV)->Apply(pixelArgs)->UseRealTime();
+
+void BM_GrayBlurOtsu_Specialized(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    GrayBlurKernel kernel = selectGrayBlurKernel(inputs->image.type(), BLUR_SIZE);
+    if (!kernel) {
+        state.SkipWithError("沒有對應的特化核心");
+        return;
+    }
+    cv::Mat gray;
+    cv::Mat blurred;
+    cv::Mat binary;
+    cv::Mat workspace;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        kernel(inputs->image, gray, blurred, workspace);
+        cv::threshold(blurred, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+        benchmark::DoNotOptimize(binary.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, 1);
+}
+BENCHMARK(BM_GrayBlurOtsu_Specialized)->Apply(pixelArgs)->UseRealTime();
+
+void BM_GrayBlurOtsu_Tiled(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    const size_t threads = static_cast<size_t>(state.range(2));
+    if (!TiledBlurThreshold::supports(inputs->image.type(), BLUR_SIZE)) {
+        state.SkipWithError("條帶平行不支援此圖像類型");
+        return;
+    }
+    // 與 ImageProcessor::setIntraFrameThreads() 相同：呼叫端執行緒也參與
+    WorkStealingPool pool(threads - 1);
+    TiledBlurThreshold filter(pool);
+    cv::Mat blurred;
+    cv::Mat binary;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        filter.apply(inputs->image, BLUR_SIZE, blurred, binary);
+        benchmark::DoNotOptimize(binary.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, static_cast<int>(pool.concurrency()));
+}
+BENCHMARK(BM_GrayBlurOtsu_Tiled)->Apply(tiledArgs)->UseRealTime();
+
+// ---- 物體擷取 ----
+
+void BM_Contours_OpenCV(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    std::vector<std::vector<cv::Point>> contours;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        cv::findContours(inputs->binary, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+        benchmark::DoNotOptimize(contours.data());
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, 1);
+    state.counters["objects"] = static_cast<double>(inputs->contours.size());
+}
+BENCHMARK(BM_Contours_OpenCV)->Apply(frameArgs)->UseRealTime();
+
+void BM_Contours_Labeling(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    ParallelLabeler labeler;
+    size_t components = 0;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        components = labeler.label(inputs->binary).size();
+        benchmark::DoNotOptimize(components);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, cv::getNumThreads());
+    state.counters["objects"] = static_cast<double>(components);
+}
+BENCHMARK(BM_Contours_Labeling)->Apply(frameArgs)->UseRealTime();
+
+// ---- 面積過濾與物體建立 ----
+
+void BM_Filter_Contours(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    std::vector<ProcessedObject> objects;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        objects.clear();
+        objectsFromContours(inputs->contours, MIN_OBJECT_AREA, objects);
+        benchmark::DoNotOptimize(objects.data());
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, 1);
+    state.counters["objects"] = static_cast<double>(objects.size());
+}
+BENCHMARK(BM_Filter_Contours)->Apply(frameArgs);
+
+void BM_Filter_Labeling(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    ParallelLabeler labeler;
+    const std::vector<LabeledComponent>& components = labeler.label(inputs->binary);
+    std::vector<ProcessedObject> objects;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        objects.clear();
+        objectsFromComponents(labeler, components, MIN_OBJECT_AREA, false, objects);
+        benchmark::DoNotOptimize(objects.data());
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, 1);
+    state.counters["objects"] = static_cast<double>(objects.size());
+}
+BENCHMARK(BM_Filter_Labeling)->Apply(frameArgs);
+
+// ---- 繪製 ----
+
+void BM_Render(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    cv::Mat result;
+
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        // 與處理器相同：複製原圖後繪製
+        result = inputs->image.clone();
+        drawDetectedObjects(result, inputs->objects);
+        benchmark::DoNotOptimize(result.data);
+    }
+    setFrameCounters(state, *inputs, allocationCount() - allocations, 1);
+    state.counters["objects"] = static_cast<double>(inputs->objects.size());
+}
+BENCHMARK(BM_Render)->Apply(frameArgs);
+
+// ---- 整個 processImage（含標準輸出，關閉視窗與結果快取） ----
+
+void BM_ProcessImage(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    ImageProcessor processor;
+    processor.setShowWindows(false);
+    processor.setResultCacheCapacity(0);
+    cv::Mat result;
+
+    // 丟棄處理器的日誌，避免干擾基準測試的輸出
+    std::streambuf* stdout_buffer = std::cout.rdbuf(nullptr);
+    const uint64_t allocations = allocationCount();
+    for (auto _ : state) {
+        std::vector<ProcessedObject> objects = processor.processImage(inputs->image, result);
+        benchmark::DoNotOptimize(objects.data());
+    }
+    const uint64_t allocated = allocationCount() - allocations;
+    std::cout.rdbuf(stdout_buffer);
+    std::cout.clear();
+
+    setFrameCounters(state, *inputs, allocated, cv::getNumThreads());
+}
+BENCHMARK(BM_ProcessImage)->Apply(frameArgs)->UseRealTime();
+
+// ---- 第一幀與穩態：預熱是否讓第一幀的延遲接近穩態的中位數 ----
+
+// 每次迭代建立新的處理器（warm 為 1 時先呼叫 warmUp()），計時的是第一次 processImage()，
+// 之後再處理 STEADY_FRAMES 幀取中位數；first/p50 接近 1 表示第一幀不再承擔配置工作區與選擇核心的成本
+// OpenCV 執行緒池與配置器等進程層級的狀態已由先前的基準測試喚醒，
+// 單獨以 --benchmark_filter=BM_ProcessImage_FirstFrame 執行時第一次迭代也包含這些成本
+void BM_ProcessImage_FirstFrame(benchmark::State& state) {
+    const StageInputs* inputs = inputsFor(state);
+    if (!inputs) return;
+    const bool warm = state.range(2) != 0;
+    constexpr int STEADY_FRAMES = 31;
+    using Clock = std::chrono::steady_clock;
+
+    std::streambuf* stdout_buffer = std::cout.rdbuf(nullptr);
+    double first_ms_sum = 0;
+    double p50_ms_sum = 0;
+    for (auto _ : state) {
+        ImageProcessor processor;
+        processor.setShowWindows(false);
+        processor.setResultCacheCapacity(0);
+        if (warm) {
+            WarmUpConfig config;
+            config.max_size = inputs->image.size();
+            config.type = inputs->image.type();
+            processor.warmUp(config);
+        }
+        cv::Mat result;
+
+        Clock::time_point start = Clock::now();
+        std::vector<ProcessedObject> objects = processor.processImage(inputs->image, result);
+        benchmark::DoNotOptimize(objects.data());
+        const double first_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        state.SetIterationTime(first_ms / 1e3);
+
+        std::vector<double> steady_ms(STEADY_FRAMES);
+        for (double& elapsed : steady_ms) {
+            start = Clock::now();
+            objects = processor.processImage(inputs->image, result);
+            benchmark::DoNotOptimize(objects.data());
+            elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        std::nth_element(steady_ms.begin(), steady_ms.begin() + STEADY_FRAMES / 2, steady_ms.end());
+        first_ms_sum += first_ms;
+        p50_ms_sum += steady_ms[STEADY_FRAMES / 2];
+    }
+    std::cout.rdbuf(stdout_buffer);
+    std::cout.clear();
+
+    const double iterations = static_cast<double>(state.iterations());
+    state.SetLabel(inputs->label + (warm ? " warm" : " cold"));
+    state.counters["first_ms"] = first_ms_sum / iterations;
+    state.counters["p50_ms"] = p50_ms_sum / iterations;
+    state.counters["first/p50"] = p50_ms_sum > 0 ? first_ms_sum / p50_ms_sum : 0;
+}
+BENCHMARK(BM_ProcessImage_FirstFrame)
+    ->ArgNames({"res", "density", "warm"})
+    ->ArgsProduct({{0, 1, 2}, {1}, {0, 1}})
+    ->Iterations(5)
+    ->UseManualTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
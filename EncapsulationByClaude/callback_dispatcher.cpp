@@ -0,0 +1,115 @@
+// callback_dispatcher.cpp
+#include "callback_dispatcher.h"
+#include <algorithm>
+#include <iostream>
+
+CallbackDispatcher::CallbackDispatcher(size_t capacity, OverflowPolicy policy, size_t worker_count,
+                                       QueueDepthListener on_complete)
+    : capacity_(std::max<size_t>(capacity, 1)), policy_(policy), on_complete_(std::move(on_complete)) {
+    worker_count = std::max<size_t>(worker_count, 1);
+    for (size_t i = 0; i < worker_count; i++) {
+        workers_.emplace_back(&CallbackDispatcher::workerLoop, this);
+    }
+}
+
+CallbackDispatcher::~CallbackDispatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+bool CallbackDispatcher::post(std::function<void()> task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (queue_.size() >= capacity_) {
+        switch (policy_) {
+            case OverflowPolicy::BLOCK:
+                not_full_.wait(lock, [this] { return queue_.size() < capacity_ || stopping_; });
+                if (stopping_) {
+                    return false;
+                }
+                break;
+            case OverflowPolicy::DROP_OLDEST:
+                queue_.pop_front();
+                stats_.dropped++;
+                break;
+            case OverflowPolicy::DROP_NEWEST:
+                stats_.dropped++;
+                return false;
+        }
+    }
+
+    queue_.push_back(Task{std::move(task), std::chrono::steady_clock::now()});
+    stats_.posted++;
+    stats_.max_queue_depth = std::max(stats_.max_queue_depth, queue_.size());
+    lock.unlock();
+
+    not_empty_.notify_one();
+    return true;
+}
+
+CallbackDispatchStats CallbackDispatcher::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CallbackDispatchStats result = stats_;
+    result.queue_depth = queue_.size();
+    if (stats_.completed > 0) {
+        result.avg_queue_wait_ms = total_queue_wait_ms_ / stats_.completed;
+        result.avg_callback_ms = total_callback_ms_ / stats_.completed;
+    }
+    return result;
+}
+
+bool CallbackDispatcher::onWorkerThread() const {
+    const std::thread::id self = std::this_thread::get_id();
+    return std::any_of(workers_.begin(), workers_.end(),
+                       [self](const std::thread& worker) { return worker.get_id() == self; });
+}
+
+void CallbackDispatcher::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        not_empty_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+        if (queue_.empty()) {
+            // 停止且佇列已清空
+            return;
+        }
+
+        Task task = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+
+        auto start = std::chrono::steady_clock::now();
+        try {
+            task.fn();
+        } catch (const std::exception& ex) {
+            std::cerr << "回調執行時出錯: " << ex.what() << std::endl;
+        }
+        auto end = std::chrono::steady_clock::now();
+        // 回調持有的資源（例如緩衝池槽位）先釋放，再回報佇列長度
+        task.fn = nullptr;
+
+        lock.lock();
+        const double wait_ms = std::chrono::duration<double, std::milli>(start - task.enqueued).count();
+        const double run_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        total_queue_wait_ms_ += wait_ms;
+        total_callback_ms_ += run_ms;
+        stats_.max_callback_ms = std::max(stats_.max_callback_ms, run_ms);
+        stats_.completed++;
+        
+        if (on_complete_) {
+            const size_t depth = queue_.size();
+            lock.unlock();
+            on_complete_(depth);
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,87 @@
+// callback_dispatcher.h
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 回調執行方式
+enum class CallbackDispatchMode {
+    SYNC,   // 在處理執行緒上直接呼叫（預設）
+    ASYNC   // 放入佇列，由背景執行緒呼叫，不阻塞管線
+};
+
+// 佇列已滿時的處理策略
+enum class OverflowPolicy {
+    BLOCK,        // 等待佇列有空位（回壓到管線）
+    DROP_OLDEST,  // 丟棄最舊的待執行回調
+    DROP_NEWEST   // 丟棄這次的回調
+};
+
+// 回調佇列的統計數據
+struct CallbackDispatchStats {
+    size_t queue_depth = 0;          // 目前佇列長度
+    size_t max_queue_depth = 0;      // 最大佇列長度
+    uint64_t posted = 0;             // 送入佇列的回調數
+    uint64_t completed = 0;          // 已執行完成的回調數
+    uint64_t dropped = 0;            // 因佇列已滿而丟棄的回調數
+    double avg_queue_wait_ms = 0;    // 平均排隊時間
+    double avg_callback_ms = 0;      // 平均回調執行時間
+    double max_callback_ms = 0;      // 最長回調執行時間
+};
+
+// 回調執行完成後通知剩餘的佇列長度（在背景執行緒上、不持有佇列的鎖）
+using QueueDepthListener = std::function<void(size_t queue_depth)>;
+
+// 有界佇列 + 背景執行緒的回調派送器
+class CallbackDispatcher {
+public:
+    CallbackDispatcher(size_t capacity = 16, OverflowPolicy policy = OverflowPolicy::DROP_OLDEST,
+                       size_t worker_count = 1, QueueDepthListener on_complete = nullptr);
+
+    // 解構函數 - 執行完剩餘的回調後停止背景執行緒
+    ~CallbackDispatcher();
+
+    CallbackDispatcher(const CallbackDispatcher&) = delete;
+    CallbackDispatcher& operator=(const CallbackDispatcher&) = delete;
+
+    // 送出一個回調，被丟棄時回傳 false
+    bool post(std::function<void()> task);
+
+    // 取得統計數據
+    CallbackDispatchStats stats() const;
+
+    // 目前執行緒是否為本派送器的背景執行緒（即正在回調中）；此時解構會等待自己結束
+    bool onWorkerThread() const;
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    size_t capacity_;
+    OverflowPolicy policy_;
+    QueueDepthListener on_complete_;
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Task> queue_;
+    bool stopping_ = false;
+
+    // 統計（受 mutex_ 保護）
+    CallbackDispatchStats stats_;
+    double total_queue_wait_ms_ = 0;
+    double total_callback_ms_ = 0;
+
+    // 背景執行緒循環
+    void workerLoop();
+};
@@ -0,0 +1,398 @@
+// detection_pipeline.cpp
+#include "detection_pipeline.h"
+#include "frame_kernels.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+const char* portTypeName(PortType type) {
+    switch (type) {
+        case PortType::IMAGE: return "IMAGE";
+        case PortType::GRAY8: return "GRAY8";
+        case PortType::CONTOURS: return "CONTOURS";
+        case PortType::OBJECTS: return "OBJECTS";
+    }
+    return "UNKNOWN";
+}
+
+DetectionPipeline::DetectionPipeline(WorkStealingPool* pool) : pool_(pool) {}
+
+DetectionPipeline& DetectionPipeline::add(std::unique_ptr<PipelineStage> stage,
+                                          std::vector<std::string> inputs, std::vector<std::string> outputs) {
+    Node node;
+    node.stage = std::move(stage);
+    node.input_names = std::move(inputs);
+    node.output_names = std::move(outputs);
+    nodes_.push_back(std::move(node));
+    built_ = false;
+    return *this;
+}
+
+bool DetectionPipeline::build(const std::vector<std::string>& requested, std::string* error) {
+    auto fail = [error](const std::string& reason) {
+        if (error) *error = reason;
+        return false;
+    };
+
+    built_ = false;
+    values_.clear();
+    value_index_.clear();
+    levels_.clear();
+    buffers_.clear();
+    outputs_.clear();
+
+    // 登記所有數據與其產生者
+    values_.push_back(Value{SOURCE, PortType::IMAGE, -1});
+    value_index_[SOURCE] = 0;
+    values_.push_back(Value{LUMA, PortType::GRAY8, -1});
+    value_index_[LUMA] = 1;
+    for (size_t n = 0; n < nodes_.size(); n++) {
+        Node& node = nodes_[n];
+        node.inputs.clear();
+        node.outputs.clear();
+        node.in_ptrs.clear();
+        node.out_ptrs.clear();
+        node.level = 0;
+        node.active = false;
+
+        const std::vector<PortType> input_types = node.stage->inputs();
+        const std::vector<PortType> output_types = node.stage->outputs();
+        if (input_types.size() != node.input_names.size() || output_types.size() != node.output_names.size()) {
+            return fail(std::string("節點 ") + node.stage->name() + " 的輸入輸出數量不符");
+        }
+        for (size_t i = 0; i < output_types.size(); i++) {
+            const std::string& name = node.output_names[i];
+            if (value_index_.count(name)) {
+                return fail("數據名稱重複: " + name);
+            }
+            value_index_[name] = static_cast<int>(values_.size());
+            node.outputs.push_back(static_cast<int>(values_.size()));
+            values_.push_back(Value{name, output_types[i], static_cast<int>(n)});
+        }
+    }
+
+    // 連接輸入並檢查類型
+    for (Node& node : nodes_) {
+        const std::vector<PortType> input_types = node.stage->inputs();
+        for (size_t i = 0; i < input_types.size(); i++) {
+            auto it = value_index_.find(node.input_names[i]);
+            if (it == value_index_.end()) {
+                return fail(std::string("節點 ") + node.stage->name() + " 的輸入不存在: " + node.input_names[i]);
+            }
+            if (values_[it->second].type != input_types[i]) {
+                return fail(std::string("節點 ") + node.stage->name() + " 的輸入 " + node.input_names[i] + " 類型不符 (" +
+                            portTypeName(values_[it->second].type) + " != " + portTypeName(input_types[i]) + ")");
+            }
+            node.inputs.push_back(it->second);
+        }
+    }
+
+    // 只保留產生所需輸出的節點
+    std::vector<int> stack;
+    for (const std::string& name : requested) {
+        auto it = value_index_.find(name);
+        if (it == value_index_.end()) {
+            return fail("要求的輸出不存在: " + name);
+        }
+        if (values_[it->second].producer >= 0) {
+            stack.push_back(values_[it->second].producer);
+        }
+    }
+    while (!stack.empty()) {
+        Node& node = nodes_[stack.back()];
+        stack.pop_back();
+        if (node.active) continue;
+        node.active = true;
+        for (int v : node.inputs) {
+            if (values_[v].producer >= 0) stack.push_back(values_[v].producer);
+        }
+    }
+
+    // 依相依關係分層：節點的層為其輸入產生者的最大層加一，外部輸入為第 0 層
+    size_t active_count = 0;
+    std::vector<int> pending(nodes_.size(), 0);
+    std::vector<std::vector<int>> consumers(nodes_.size());
+    std::vector<int> ready;
+    for (size_t n = 0; n < nodes_.size(); n++) {
+        if (!nodes_[n].active) continue;
+        active_count++;
+        for (int v : nodes_[n].inputs) {
+            const int producer = values_[v].producer;
+            if (producer >= 0) {
+                pending[n]++;
+                consumers[producer].push_back(static_cast<int>(n));
+            }
+        }
+        if (pending[n] == 0) {
+            nodes_[n].level = 1;
+            ready.push_back(static_cast<int>(n));
+        }
+    }
+    size_t ordered = 0;
+    while (!ready.empty()) {
+        const int n = ready.back();
+        ready.pop_back();
+        ordered++;
+        if (static_cast<int>(levels_.size()) < nodes_[n].level) {
+            levels_.resize(nodes_[n].level);
+        }
+        levels_[nodes_[n].level - 1].push_back(n);
+        for (int c : consumers[n]) {
+            nodes_[c].level = std::max(nodes_[c].level, nodes_[n].level + 1);
+            if (--pending[c] == 0) ready.push_back(c);
+        }
+    }
+    if (ordered != active_count) {
+        return fail("管線中有循環相依");
+    }
+
+    // 數據的生命期：從產生的層到最後使用的層；要求的輸出保留到最後
+    for (Value& value : values_) {
+        value.last_use = value.producer >= 0 ? nodes_[value.producer].level : 0;
+        value.buffer = -1;
+    }
+    for (const Node& node : nodes_) {
+        if (!node.active) continue;
+        for (int v : node.inputs) {
+            values_[v].last_use = std::max(values_[v].last_use, node.level);
+        }
+    }
+    for (const std::string& name : requested) {
+        values_[value_index_[name]].last_use = INT_MAX;
+    }
+
+    // 分配緩衝區：同類型且前一個使用者在更早的層就已結束時重用（同一層可能並行，不可共用）
+    std::vector<PortType> buffer_types;
+    std::vector<int> buffer_free_after;
+    for (size_t l = 0; l < levels_.size(); l++) {
+        const int level = static_cast<int>(l) + 1;
+        for (int n : levels_[l]) {
+            for (int v : nodes_[n].outputs) {
+                Value& value = values_[v];
+                for (size_t b = 0; b < buffer_types.size(); b++) {
+                    if (buffer_types[b] == value.type && buffer_free_after[b] < level) {
+                        value.buffer = static_cast<int>(b);
+                        break;
+                    }
+                }
+                if (value.buffer < 0) {
+                    value.buffer = static_cast<int>(buffer_types.size());
+                    buffer_types.push_back(value.type);
+                    buffer_free_after.push_back(0);
+                }
+                buffer_free_after[value.buffer] = value.last_use;
+            }
+        }
+    }
+
+    // 緩衝區數量固定後才取指針
+    buffers_.resize(buffer_types.size());
+    for (size_t b = 0; b < buffers_.size(); b++) {
+        buffers_[b].type = buffer_types[b];
+    }
+    auto bufferOf = [this](int v) -> PipelineBuffer* {
+        if (values_[v].producer < 0) {
+            return v == value_index_.at(LUMA) ? &luma_source_ : &source_;
+        }
+        return &buffers_[values_[v].buffer];
+    };
+    for (Node& node : nodes_) {
+        if (!node.active) continue;
+        for (int v : node.inputs) node.in_ptrs.push_back(bufferOf(v));
+        for (int v : node.outputs) node.out_ptrs.push_back(bufferOf(v));
+    }
+    for (const std::string& name : requested) {
+        outputs_[name] = bufferOf(value_index_[name]);
+    }
+
+    built_ = true;
+    return true;
+}
+
+void DetectionPipeline::run(const cv::Mat& image, const cv::Mat& luma) {
+    if (!built_) {
+        std::cerr << "管線尚未建立" << std::endl;
+        return;
+    }
+
+    source_.mat = image;
+    luma_source_.mat = luma;
+    for (const std::vector<int>& level : levels_) {
+        if (pool_ && level.size() > 1) {
+            // 同一層的節點互不相依，並行執行
+            pool_->parallelFor(level.size(), [this, &level](size_t i) { runNode(level[i]); });
+        } else {
+            for (int n : level) {
+                runNode(n);
+            }
+        }
+    }
+}
+
+void DetectionPipeline::setResolutionTier(int tier) {
+    for (Node& node : nodes_) {
+        node.stage->setResolutionTier(tier);
+    }
+}
+
+void DetectionPipeline::runNode(int index) {
+    Node& node = nodes_[index];
+    node.stage->run(node.in_ptrs.data(), node.out_ptrs.data());
+}
+
+const cv::Mat& DetectionPipeline::mat(const std::string& name) const {
+    return outputs_.at(name)->mat;
+}
+
+const std::vector<ProcessedObject>& DetectionPipeline::objects(const std::string& name) const {
+    return outputs_.at(name)->objects;
+}
+
+size_t DetectionPipeline::activeStageCount() const {
+    return std::count_if(nodes_.begin(), nodes_.end(), [](const Node& node) { return node.active; });
+}
+
+std::string DetectionPipeline::describe() const {
+    std::ostringstream out;
+    for (size_t l = 0; l < levels_.size(); l++) {
+        out << "第 " << l + 1 << " 層:";
+        for (int n : levels_[l]) {
+            const Node& node = nodes_[n];
+            out << " " << node.stage->name() << "(";
+            for (size_t i = 0; i < node.output_names.size(); i++) {
+                out << (i ? ", " : "") << node.output_names[i] << " -> #" << values_[node.outputs[i]].buffer;
+            }
+            out << ")";
+        }
+        out << "\n";
+    }
+    out << "節點 " << activeStageCount() << " / " << nodes_.size() << "，緩衝區 " << buffers_.size();
+    return out.str();
+}
+
+std::unique_ptr<DetectionPipeline> buildDetectionPipeline(const DetectionRecipe& recipe, WorkStealingPool* pool) {
+    auto pipeline = std::make_unique<DetectionPipeline>(pool);
+
+    pipeline->add(std::make_unique<GrayStage>(true), {DetectionPipeline::SOURCE, DetectionPipeline::LUMA}, {"gray"});
+    if (recipe.tiled && pool) {
+        pipeline->add(std::make_unique<TiledBlurThresholdStage>(*pool, recipe.blur_size), {"gray"}, {"binary"});
+    } else {
+        pipeline->add(std::make_unique<GaussianBlurStage>(recipe.blur_size), {"gray"}, {"blurred"});
+        pipeline->add(std::make_unique<OtsuThresholdStage>(), {"blurred"}, {"binary"});
+    }
+
+    if (recipe.extraction == ObjectExtraction::LABELING) {
+        pipeline->add(std::make_unique<LabelingStage>(recipe.min_object_area, recipe.extract_contours),
+                      {"binary"}, {"objects"});
+    } else {
+        pipeline->add(std::make_unique<ContourStage>(), {"binary"}, {"contours"});
+        pipeline->add(std::make_unique<ContourFilterStage>(recipe.min_object_area), {"contours"}, {"objects"});
+    }
+
+    // 不需要結果圖時，繪製節點會在 build() 時被剔除
+    pipeline->add(std::make_unique<RenderStage>(), {DetectionPipeline::SOURCE, "objects"}, {"result"});
+
+    std::vector<std::string> requested = {"objects"};
+    if (recipe.render) {
+        requested.push_back("result");
+    }
+
+    std::string error;
+    if (!pipeline->build(requested, &error)) {
+        std::cerr << "建立偵測管線失敗: " << error << std::endl;
+        return nullptr;
+    }
+    return pipeline;
+}
+
+void GrayStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    const cv::Mat& src = in[0]->mat;
+    cv::Mat& dst = out[0]->mat;
+
+    if (use_luma_) {
+        const cv::Mat& luma = in[1]->mat;
+        if (!luma.empty() && luma.type() == CV_8UC1 && luma.rows == src.rows && luma.cols == src.cols) {
+            // 輸出緩衝區可能被其他數據重用，不能直接參考共享記憶體中的灰階平面
+            luma.copyTo(dst);
+            return;
+        }
+    }
+
+    switch (src.type()) {
+        case CV_8UC1:
+            // 輸出緩衝區可能被其他數據重用，不能直接參考輸入
+            src.copyTo(dst);
+            return;
+        case CV_8UC3:
+        case CV_8UC4:
+        case CV_16UC1:
+            dst.create(src.rows, src.cols, CV_8UC1);
+            for (int y = 0; y < src.rows; y++) {
+                uint8_t* row = dst.ptr<uint8_t>(y);
+                if (src.type() == CV_8UC3) {
+                    frame_kernels::grayRow<uint8_t, 3>(src.ptr<uint8_t>(y), row, src.cols);
+                } else if (src.type() == CV_8UC4) {
+                    frame_kernels::grayRow<uint8_t, 4>(src.ptr<uint8_t>(y), row, src.cols);
+                } else {
+                    frame_kernels::grayRow<uint16_t, 1>(src.ptr<uint16_t>(y), row, src.cols);
+                }
+            }
+            return;
+        default: {
+            // 其他格式交給 OpenCV
+            cv::Mat gray = src;
+            if (src.channels() != 1) {
+                cv::cvtColor(src, gray, src.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+            }
+            gray.convertTo(dst, CV_8U, gray.depth() == CV_16U ? 1.0 / 256 : 1.0);
+            return;
+        }
+    }
+}
+
+void GaussianBlurStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    const cv::Mat& src = in[0]->mat;
+    cv::Mat& dst = out[0]->mat;
+
+    switch (ksize_) {
+        case 3: frame_kernels::gaussianBlur8u<3>(src, dst, workspace_); break;
+        case 5: frame_kernels::gaussianBlur8u<5>(src, dst, workspace_); break;
+        case 7: frame_kernels::gaussianBlur8u<7>(src, dst, workspace_); break;
+        default: cv::GaussianBlur(src, dst, cv::Size(ksize_, ksize_), 0); break;
+    }
+}
+
+void OtsuThresholdStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    cv::threshold(in[0]->mat, out[0]->mat, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+}
+
+void TiledBlurThresholdStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    if (TiledBlurThreshold::supports(CV_8UC1, ksize_)) {
+        filter_.apply(in[0]->mat, ksize_, blurred_, out[0]->mat);
+    } else {
+        cv::GaussianBlur(in[0]->mat, blurred_, cv::Size(ksize_, ksize_), 0);
+        cv::threshold(blurred_, out[0]->mat, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+    }
+}
+
+void ContourStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    cv::findContours(in[0]->mat, out[0]->contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+}
+
+void ContourFilterStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    out[0]->objects.clear();
+    objectsFromContours(in[0]->contours, std::ldexp(min_area_, -2 * tier_), out[0]->objects);
+}
+
+void LabelingStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    out[0]->objects.clear();
+    objectsFromComponents(labeler_, labeler_.label(in[0]->mat), std::ldexp(min_area_, -2 * tier_), with_contours_,
+                          out[0]->objects);
+}
+
+void RenderStage::run(const PipelineBuffer* const* in, PipelineBuffer* const* out) {
+    in[0]->mat.copyTo(out[0]->mat);
+    drawDetectedObjects(out[0]->mat, in[1]->objects);
+}
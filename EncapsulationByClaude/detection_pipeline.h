@@ -0,0 +1,247 @@
+// detection_pipeline.h
+#pragma once
+
+#include "processed_object.h"
+#include "object_labeling.h"
+#include "tiled_filter.h"
+#include "work_stealing_pool.h"
+#include <opencv2/opencv.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 節點輸入輸出的類型
+enum class PortType {
+    IMAGE,      // 與輸入同格式的圖像（彩色或灰階）
+    GRAY8,      // 與輸入同尺寸的 8 位元單通道圖（灰階、模糊、二值）
+    CONTOURS,   // 外輪廓
+    OBJECTS     // 偵測到的物體
+};
+
+const char* portTypeName(PortType type);
+
+// 節點之間傳遞的緩衝區；依類型只使用其中一個欄位
+// 緩衝區在建構時配置好並跨幀重用，同類型且生命期不重疊的數據共用同一個緩衝區
+struct PipelineBuffer {
+    PortType type = PortType::IMAGE;
+    cv::Mat mat;
+    std::vector<std::vector<cv::Point>> contours;
+    std::vector<ProcessedObject> objects;
+};
+
+// 管線節點
+// run() 的輸出緩衝區可能保留著上一個使用者的內容，節點必須完整覆寫
+class PipelineStage {
+public:
+    virtual ~PipelineStage() = default;
+
+    virtual const char* name() const = 0;
+    virtual std::vector<PortType> inputs() const = 0;
+    virtual std::vector<PortType> outputs() const = 0;
+    virtual void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) = 0;
+
+    // 之後的幀已縮小 2^tier 倍（速率控制的解析度層級）；以像素計的參數（例如面積門檻）據此換算
+    virtual void setResolutionTier(int /*tier*/) {}
+};
+
+// 可設定的偵測管線
+// 以名稱連接各節點的輸入輸出，build() 時檢查類型、剔除與所需輸出無關的節點、
+// 依相依關係分層（同一層的節點互不相依，有執行緒池時並行執行），並依生命期規劃緩衝區的重用；
+// 之後每幀的 run() 只依計畫執行，不再配置緩衝區（尺寸不變時）
+class DetectionPipeline {
+public:
+    // 外部輸入的名稱 (IMAGE)
+    static constexpr const char* SOURCE = "image";
+    // 選用的外部輸入 (GRAY8)：生產者預先算好的灰階圖，沒有時為空
+    static constexpr const char* LUMA = "luma";
+
+    // pool 為空時所有節點依序執行
+    explicit DetectionPipeline(WorkStealingPool* pool = nullptr);
+
+    DetectionPipeline(const DetectionPipeline&) = delete;
+    DetectionPipeline& operator=(const DetectionPipeline&) = delete;
+
+    // 加入節點，inputs / outputs 為數據名稱，數量須與節點宣告的一致
+    DetectionPipeline& add(std::unique_ptr<PipelineStage> stage,
+                           std::vector<std::string> inputs, std::vector<std::string> outputs);
+
+    // 建立執行計畫，只保留產生 requested 所需的節點；失敗時回傳 false 並填入原因
+    bool build(const std::vector<std::string>& requested, std::string* error = nullptr);
+
+    bool built() const { return built_; }
+
+    // 執行一幀；luma 為與 image 對應的灰階圖（可為空），供使用 LUMA 輸入的節點略過轉換
+    void run(const cv::Mat& image, const cv::Mat& luma = cv::Mat());
+    
+    // 通知各節點之後的幀所屬的解析度層級
+    void setResolutionTier(int tier);
+
+    // 是否可取得某個輸出（build() 時要求的輸出）
+    bool has(const std::string& name) const { return outputs_.count(name) != 0; }
+
+    // 取得輸出，在下次 run() 前有效
+    const cv::Mat& mat(const std::string& name) const;
+    const std::vector<ProcessedObject>& objects(const std::string& name) const;
+
+    // 實際執行的節點數與緩衝區數
+    size_t activeStageCount() const;
+    size_t bufferCount() const { return buffers_.size(); }
+
+    // 執行計畫的文字描述（每層的節點與各數據所用的緩衝區）
+    std::string describe() const;
+
+private:
+    struct Node {
+        std::unique_ptr<PipelineStage> stage;
+        std::vector<std::string> input_names;
+        std::vector<std::string> output_names;
+        std::vector<int> inputs;                       // 數據索引
+        std::vector<int> outputs;
+        std::vector<const PipelineBuffer*> in_ptrs;    // build() 後固定
+        std::vector<PipelineBuffer*> out_ptrs;
+        int level = 0;
+        bool active = false;
+    };
+
+    struct Value {
+        std::string name;
+        PortType type;
+        int producer;         // 產生此數據的節點，-1 為外部輸入
+        int last_use = 0;     // 最後使用的層
+        int buffer = -1;      // 分配到的緩衝區
+    };
+
+    WorkStealingPool* pool_;
+    std::vector<Node> nodes_;
+    std::vector<Value> values_;
+    std::map<std::string, int> value_index_;
+    std::vector<std::vector<int>> levels_;     // 每層的節點
+    std::vector<PipelineBuffer> buffers_;
+    PipelineBuffer source_;
+    PipelineBuffer luma_source_;
+    std::map<std::string, const PipelineBuffer*> outputs_;
+    bool built_ = false;
+
+    void runNode(int index);
+};
+
+// 常用的偵測流程參數，由 buildDetectionPipeline() 組成管線
+struct DetectionRecipe {
+    int blur_size = 5;
+    double min_object_area = 500.0;
+    ObjectExtraction extraction = ObjectExtraction::CONTOURS;
+    bool extract_contours = true;   // LABELING 時是否追蹤輪廓
+    bool render = true;             // 是否輸出繪製好的結果圖 "result"
+    bool tiled = false;             // 模糊 + 二值化使用條帶平行（需要執行緒池）
+};
+
+// 依參數組成並建立管線，輸出 "objects"（以及 render 時的 "result"）
+std::unique_ptr<DetectionPipeline> buildDetectionPipeline(const DetectionRecipe& recipe,
+                                                          WorkStealingPool* pool = nullptr);
+
+// ---- 內建節點 ----
+
+// IMAGE -> GRAY8：轉為 8 位元灰階
+// use_luma 時多一個 GRAY8 輸入（通常接 DetectionPipeline::LUMA），其內容與圖像同尺寸時直接複製，不做轉換
+class GrayStage : public PipelineStage {
+public:
+    explicit GrayStage(bool use_luma = false) : use_luma_(use_luma) {}
+    const char* name() const override { return "gray"; }
+    std::vector<PortType> inputs() const override {
+        return use_luma_ ? std::vector<PortType>{PortType::IMAGE, PortType::GRAY8} : std::vector<PortType>{PortType::IMAGE};
+    }
+    std::vector<PortType> outputs() const override { return {PortType::GRAY8}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+
+private:
+    bool use_luma_;
+};
+
+// GRAY8 -> GRAY8：高斯模糊
+class GaussianBlurStage : public PipelineStage {
+public:
+    explicit GaussianBlurStage(int ksize) : ksize_(ksize) {}
+    const char* name() const override { return "blur"; }
+    std::vector<PortType> inputs() const override { return {PortType::GRAY8}; }
+    std::vector<PortType> outputs() const override { return {PortType::GRAY8}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+
+private:
+    int ksize_;
+    cv::Mat workspace_;
+};
+
+// GRAY8 -> GRAY8：Otsu 反相二值化
+class OtsuThresholdStage : public PipelineStage {
+public:
+    const char* name() const override { return "otsu"; }
+    std::vector<PortType> inputs() const override { return {PortType::GRAY8}; }
+    std::vector<PortType> outputs() const override { return {PortType::GRAY8}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+};
+
+// GRAY8 -> GRAY8：條帶平行的模糊 + Otsu 反相二值化
+class TiledBlurThresholdStage : public PipelineStage {
+public:
+    TiledBlurThresholdStage(WorkStealingPool& pool, int ksize) : filter_(pool), ksize_(ksize) {}
+    const char* name() const override { return "tiled_blur_otsu"; }
+    std::vector<PortType> inputs() const override { return {PortType::GRAY8}; }
+    std::vector<PortType> outputs() const override { return {PortType::GRAY8}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+
+private:
+    TiledBlurThreshold filter_;
+    int ksize_;
+    cv::Mat blurred_;
+};
+
+// GRAY8 -> CONTOURS：外輪廓
+class ContourStage : public PipelineStage {
+public:
+    const char* name() const override { return "contours"; }
+    std::vector<PortType> inputs() const override { return {PortType::GRAY8}; }
+    std::vector<PortType> outputs() const override { return {PortType::CONTOURS}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+};
+
+// CONTOURS -> OBJECTS：依面積過濾
+class ContourFilterStage : public PipelineStage {
+public:
+    explicit ContourFilterStage(double min_area) : min_area_(min_area) {}
+    const char* name() const override { return "contour_filter"; }
+    std::vector<PortType> inputs() const override { return {PortType::CONTOURS}; }
+    std::vector<PortType> outputs() const override { return {PortType::OBJECTS}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+    void setResolutionTier(int tier) override { tier_ = tier; }
+
+private:
+    double min_area_;   // 原始解析度下的面積門檻
+    int tier_ = 0;
+};
+
+// GRAY8 -> OBJECTS：平行連通元件標記並依面積過濾
+class LabelingStage : public PipelineStage {
+public:
+    LabelingStage(double min_area, bool with_contours) : min_area_(min_area), with_contours_(with_contours) {}
+    const char* name() const override { return "labeling"; }
+    std::vector<PortType> inputs() const override { return {PortType::GRAY8}; }
+    std::vector<PortType> outputs() const override { return {PortType::OBJECTS}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+    void setResolutionTier(int tier) override { tier_ = tier; }
+
+private:
+    double min_area_;   // 原始解析度下的面積門檻
+    bool with_contours_;
+    int tier_ = 0;
+    ParallelLabeler labeler_;
+};
+
+// IMAGE + OBJECTS -> IMAGE：繪製結果圖
+class RenderStage : public PipelineStage {
+public:
+    const char* name() const override { return "render"; }
+    std::vector<PortType> inputs() const override { return {PortType::IMAGE, PortType::OBJECTS}; }
+    std::vector<PortType> outputs() const override { return {PortType::IMAGE}; }
+    void run(const PipelineBuffer* const* in, PipelineBuffer* const* out) override;
+};
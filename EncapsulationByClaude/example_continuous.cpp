@@ -29,6 +29,7 @@ int main(int argc, char** argv) {
         
         // 建立共享記憶體管理器
         SharedMemoryManager shm("continuous_processing_shm", SharedMemoryMode::CREATE);
+        shm.setPublishLuma(true);  // 寫入時一併產生灰階平面
         
         // 建立處理者和讀取者
         ImageProcessor processor("continuous_processing_shm");
@@ -39,13 +40,15 @@ int main(int argc, char** argv) {
         processor.setShowWindows(true);
         
         // 設置處理回調
-        processor.setResultCallback([](const cv::Mat& result, const std::vector<ProcessedObject>& objects) {
-            std::cout << "處理完成，偵測到 " << objects.size() << " 個物體" << std::endl;
+        processor.setLateThreshold(200.0);  // 擷取到處理完成超過 200 ms 視為遲到
+        processor.setResultCacheCapacity(64);  // 靜止畫面重複時直接使用先前的結果（生產者隨之計算內容雜湊）
+        processor.setResultCallback([](const cv::Mat& result, const std::vector<ProcessedObject>& objects,
+                                       const FrameInfo& frame) {
+            const double latency_ms = (captureTimestampNow() - frame.capture_ns) / 1e6;
+            std::cout << "第 " << frame.sequence << " 幀處理完成，偵測到 " << objects.size()
+                      << " 個物體，延遲 " << latency_ms << " ms" << std::endl;
         });
         
-        // 啟動處理循環（非阻塞）
-        processor.startProcessingLoop();
-        
         // 打開攝像頭
         std::cout << "開啟攝像頭 #" << camera_id << std::endl;
         cv::VideoCapture cap(camera_id);
@@ -54,10 +57,30 @@ int main(int argc, char** argv) {
             return -1;
         }
         
+        // 依攝像頭的解析度預熱兩端，第一幀的延遲與穩態相同
+        WarmUpConfig warm_up;
+        warm_up.max_size = cv::Size(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)),
+                                    static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+        if (warm_up.max_size.area() > 0) {
+            shm.prefault();
+            shm.warmUpWriter(makeWarmUpFrame(warm_up.max_size, warm_up.type));
+            shm.setReady(true);
+            processor.warmUp(warm_up);
+        }
+        
+        // 啟動處理循環（非阻塞）
+        processor.startProcessingLoop();
+        
         std::cout << "連續處理已啟動，按 Ctrl+C 停止" << std::endl;
         
+        // 依處理者回報的處理時間調節發佈速率，取代固定超時後盲目跳幀
+        RateControlConfig rate_config;
+        rate_config.latency_budget_ms = 100.0;
+        RateController rate_controller(rate_config);
+        
         // 主循環
         cv::Mat frame;
+        cv::Mat scaled;
         while (running) {
             // 讀取一幀
             cap >> frame;
@@ -65,19 +88,22 @@ int main(int argc, char** argv) {
                 std::cerr << "讀取攝像頭幀失敗" << std::endl;
                 break;
             }
+            const int64_t capture_ns = captureTimestampNow();
             
             // 顯示原始幀
             cv::imshow("輸入", frame);
             
-            // 寫入圖像到共享記憶體
-            shm.writeImage(frame);
-            
-            // 通知處理進程
-            shm.notifyNewImage();
-            
-            // 等待處理完成，但有超時
-            if (!shm.waitForProcessingDone(100)) {
-                std::cout << "處理超時，跳過此幀" << std::endl;
+            // 處理者忙碌或未到發佈間隔時略過此幀
+            RateDecision decision = rate_controller.onFrame(shm.consumerFeedback());
+            if (decision.publish) {
+                RateController::applyTier(frame, scaled, decision.resolution_tier);
+                shm.setResolutionTier(decision.resolution_tier);
+                
+                // 寫入圖像到共享記憶體，擷取時間以讀到幀的時刻為準
+                shm.writeImage(scaled, capture_ns);
+                
+                // 通知處理進程
+                shm.notifyNewImage();
             }
             
             // 檢查按鍵
@@ -89,6 +115,19 @@ int main(int argc, char** argv) {
         // 停止處理循環
         processor.stopProcessingLoop();
         
+        RateControlStats stats = rate_controller.stats();
+        std::cout << "發佈 " << stats.published << " 幀，略過 " << stats.skipped
+                  << " 幀 (" << stats.skip_ratio * 100 << "%)" << std::endl;
+        
+        FrameTransportStats transport = processor.transportStats();
+        std::cout << "處理 " << transport.frames << " 幀，漏接 " << transport.missed << " 幀，遲到 "
+                  << transport.late << " 幀，平均延遲 " << transport.avg_latency_ms << " ms，最大延遲 "
+                  << transport.max_latency_ms << " ms" << std::endl;
+        
+        ResultCacheStats cache = processor.resultCacheStats();
+        std::cout << "結果快取命中率 " << cache.hitRate() * 100 << "% (" << cache.hits << "/" << cache.lookups
+                  << ")，省下 " << cache.bytes_saved / (1024 * 1024) << " MB、約 " << cache.saved_ms << " ms" << std::endl;
+        
         // 釋放資源
         cap.release();
         cv::destroyAllWindows();
@@ -0,0 +1,67 @@
+// example_coroutine.cpp
+// 協程範例：單一事件循環執行緒服務多個共享記憶體段
+#include "image_processor.h"
+#include <iostream>
+#include <csignal>
+#include <atomic>
+#include <list>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+std::atomic<bool> running(true);
+int stop_fd = -1;   // 信號處理中寫入，喚醒監看協程
+
+void signalHandler(int signum) {
+    running = false;
+    // write 可在信號處理中呼叫
+    uint64_t one = 1;
+    ssize_t written = write(stop_fd, &one, sizeof(one));
+    (void)written;
+}
+
+int main(int argc, char** argv) {
+    // 註冊信號處理
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    signal(SIGINT, signalHandler);
+    
+    if (argc < 2) {
+        std::cerr << "用法: " << argv[0] << " <共享記憶體名稱>..." << std::endl;
+        return -1;
+    }
+    
+    try {
+        FrameReactor reactor;
+        
+        // 每個共享記憶體段一個處理者，全部共用同一個執行緒
+        std::list<ImageProcessor> processors;
+        for (int i = 1; i < argc; i++) {
+            processors.emplace_back(argv[i]);
+            ImageProcessor& processor = processors.back();
+            processor.setShowWindows(false);
+            processor.setResultCallback([name = std::string(argv[i])](const cv::Mat&, const std::vector<ProcessedObject>& objects) {
+                std::cout << "[" << name << "] 偵測到 " << objects.size() << " 個物體" << std::endl;
+            });
+            reactor.spawn(processor.processingTask(reactor, running));
+        }
+        
+        std::cout << "以單一執行緒服務 " << processors.size() << " 個共享記憶體段，按 Ctrl+C 停止" << std::endl;
+        
+        // 信號處理中不可呼叫 stop()，由監看協程在 running 變為 false 後停止事件循環
+        // 以 stop_fd 喚醒，事件循環不必為了監看而定期檢查
+        auto watchdog = [](FrameReactor& reactor) -> ReactorTask {
+            co_await SegmentAwaiter(reactor, [] { return !running.load(); }, -1, stop_fd);
+            reactor.stop();
+        };
+        reactor.spawn(watchdog(reactor));
+        
+        reactor.run();
+        
+    } catch (const std::exception& ex) {
+        std::cerr << "錯誤: " << ex.what() << std::endl;
+        return -1;
+    }
+    
+    close(stop_fd);
+    std::cout << "程式正常退出" << std::endl;
+    return 0;
+}
@@ -0,0 +1,98 @@
+// example_multi_producer.cpp
+// 多生產者佇列範例：多個相機（或圖像）進程寫入同一個佇列，一個或多個處理者進程取出處理
+#include "frame_slot_queue.h"
+#include "image_processor.h"
+#include <iostream>
+#include <csignal>
+#include <atomic>
+#include <string>
+#include <thread>
+
+std::atomic<bool> running(true);
+
+void signalHandler(int signum) {
+    running = false;
+}
+
+// 生產者：來源為數字時視為相機ID，否則為圖像路徑（以約 30 fps 重複發佈）
+int runProducer(const std::string& queue_name, const std::string& source) {
+    cv::VideoCapture camera;
+    cv::Mat image;
+
+    bool use_camera = !source.empty() && source.find_first_not_of("0123456789") == std::string::npos;
+    if (use_camera) {
+        std::cout << "啟動攝像頭 #" << source << std::endl;
+        if (!camera.open(std::stoi(source))) {
+            std::cerr << "無法啟動攝像頭" << std::endl;
+            return -1;
+        }
+    } else {
+        image = cv::imread(source);
+        if (image.empty()) {
+            std::cerr << "無法讀取圖像文件: " << source << std::endl;
+            return -1;
+        }
+    }
+
+    FrameSlotQueue queue(queue_name);
+    uint32_t producer_id = queue.registerProducer();
+    std::cout << "生產者 #" << producer_id << " 已登記，公平配額 " << queue.fairShare() << " 幀" << std::endl;
+
+    uint64_t frames = 0;
+    while (running) {
+        if (use_camera) {
+            if (!camera.read(image) || image.empty()) {
+                std::cerr << "讀取相機畫面失敗" << std::endl;
+                break;
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(33));
+        }
+
+        PushResult result = queue.push(image);
+        if (result == PushResult::TOO_LARGE) {
+            std::cerr << "圖像超過槽位大小" << std::endl;
+            break;
+        }
+        if (result != PushResult::OK && ++frames % 30 == 0) {
+            std::cout << "生產者 #" << producer_id << " 丟棄幀: " << pushResultName(result) << std::endl;
+        }
+    }
+    return 0;
+}
+
+// 處理者：不連接共享記憶體，只從佇列取出
+int runConsumer(const std::string& queue_name) {
+    FrameSlotQueue queue(queue_name);
+
+    ImageProcessor processor;
+    processor.setShowWindows(false);
+    processor.setResultCallback([](const cv::Mat&, const std::vector<ProcessedObject>& objects, const FrameInfo& frame) {
+        std::cout << "來源 #" << frame.source_id << " 第 " << frame.sequence << " 幀偵測到 "
+                  << objects.size() << " 個物體" << std::endl;
+    });
+
+    processor.processSlotQueue(queue, running);
+
+    for (const SlotQueueProducerStats& stats : queue.producerStats()) {
+        std::cout << "生產者 #" << stats.producer_id << " (進程 " << stats.pid << "): 放入 " << stats.pushed
+                  << " 幀，超過配額 " << stats.throttled << " 幀，佇列已滿 " << stats.full << " 幀" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    if (argc >= 4 && std::string(argv[1]) == "producer") {
+        return runProducer(argv[2], argv[3]);
+    }
+    if (argc >= 3 && std::string(argv[1]) == "consumer") {
+        return runConsumer(argv[2]);
+    }
+
+    std::cerr << "用法: " << argv[0] << " producer <佇列名稱> <相機ID|圖像路徑>" << std::endl;
+    std::cerr << "      " << argv[0] << " consumer <佇列名稱>" << std::endl;
+    return -1;
+}
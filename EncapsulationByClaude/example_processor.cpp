@@ -22,10 +22,15 @@ int main() {
         processor.setMinObjectArea(500);
         processor.setBlurSize(5);
         processor.setShowWindows(true);
+        // 單次處理的範例，輸出每一步的訊息
+        processor.setVerbose(true);
         
         // 設置回調函數
         processor.setResultCallback(onResultCallback);
         
+        // 預熱後才標示就緒，讀取者等到就緒再發佈，第一幀不會特別慢
+        processor.warmUp();
+        
         std::cout << "處理者已啟動，等待圖像..." << std::endl;
         
         // 單次處理模式
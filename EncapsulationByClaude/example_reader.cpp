@@ -34,6 +34,14 @@ int main(int argc, char** argv) {
         
         // 設置回調函數
         reader.setImageReadyCallback(onImageReady);
+        // 單次發佈的範例，輸出每一步的訊息
+        reader.setVerbose(true);
+        
+        // 預熱並等待處理者完成預熱，處理者尚未啟動時逾時後照常發佈
+        reader.warmUp();
+        if (!reader.waitForProcessorReady(5000)) {
+            std::cout << "處理者尚未就緒，直接發佈" << std::endl;
+        }
         
         if (use_camera) {
             // 使用攝像頭
@@ -0,0 +1,81 @@
+// example_replay.cpp
+// 錄製與回放範例
+#include "image_reader.h"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+
+void printUsage(const char* prog) {
+    std::cerr << "用法: " << prog << " record <camera_id> <錄製檔案> [秒數]" << std::endl;
+    std::cerr << "      " << prog << " play <錄製檔案> [original|fast|lockstep|<fps>] [loop]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    
+    std::string command = argv[1];
+    
+    try {
+        // 建立讀取者
+        ImageReader reader("image_processing_shm");
+        
+        if (command == "record" && argc >= 4) {
+            int camera_id = std::stoi(argv[2]);
+            int seconds = argc >= 5 ? std::stoi(argv[4]) : 10;
+            
+            if (!reader.startRecording(argv[3])) {
+                return -1;
+            }
+            
+            // 連續模式擷取，需要處理者在另一個進程中運行
+            std::cout << "錄製攝像頭 #" << camera_id << " " << seconds << " 秒" << std::endl;
+            if (!reader.startCamera(camera_id, true)) {
+                std::cerr << "無法啟動攝像頭" << std::endl;
+                return -1;
+            }
+            
+            std::this_thread::sleep_for(std::chrono::seconds(seconds));
+            reader.stopCamera();
+            reader.stopRecording();
+            
+        } else if (command == "play") {
+            ReplayMode mode = ReplayMode::ORIGINAL_TIMING;
+            double fps = 0;
+            
+            if (argc >= 4) {
+                std::string speed = argv[3];
+                if (speed == "fast") {
+                    mode = ReplayMode::AS_FAST_AS_POSSIBLE;
+                } else if (speed == "lockstep") {
+                    mode = ReplayMode::LOCKSTEP;
+                } else if (speed != "original") {
+                    mode = ReplayMode::FIXED_RATE;
+                    fps = std::stod(speed);
+                }
+            }
+            bool loop = argc >= 5 && std::string(argv[4]) == "loop";
+            
+            if (!reader.startReplay(argv[2], mode, fps, loop)) {
+                return -1;
+            }
+            
+            std::cout << "回放中，按 Enter 停止..." << std::endl;
+            std::cin.get();
+            reader.stopReplay();
+            
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+        
+    } catch (const std::exception& ex) {
+        std::cerr << "錯誤: " << ex.what() << std::endl;
+        return -1;
+    }
+    
+    return 0;
+}
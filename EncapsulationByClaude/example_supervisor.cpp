@@ -0,0 +1,72 @@
+// example_supervisor.cpp
+// 監督程式範例：管理多個處理者工作進程，崩潰時重啟並依負載增減數量
+#include "process_supervisor.h"
+#include "image_processor.h"
+#include <iostream>
+#include <csignal>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+std::atomic<bool> running(true);
+
+void signalHandler(int signum) {
+    running = false;
+}
+
+// 工作進程：以 WORKER 模式連接共享記憶體，與其他工作進程共同處理
+int runWorker(const std::string& shm_name) {
+    try {
+        ImageProcessor processor(shm_name, SharedMemoryMode::WORKER);
+        processor.setShowWindows(false);
+        processor.setResultCallback([](const cv::Mat&, const std::vector<ProcessedObject>& objects, const FrameInfo& frame) {
+            std::cout << "[工作進程 " << getpid() << "] 第 " << frame.sequence << " 幀偵測到 "
+                      << objects.size() << " 個物體" << std::endl;
+        });
+        
+        processor.startProcessingLoop();
+        while (running) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        processor.stopProcessingLoop();
+    } catch (const std::exception& ex) {
+        std::cerr << "工作進程錯誤: " << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // 註冊信號處理；監督程式以 SIGTERM 停止工作進程
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+    
+    if (argc >= 3 && std::string(argv[1]) == "--worker") {
+        return runWorker(argv[2]);
+    }
+    
+    if (argc < 2) {
+        std::cerr << "用法: " << argv[0] << " <共享記憶體名稱> [最少工作進程數] [最多工作進程數]" << std::endl;
+        return -1;
+    }
+    
+    try {
+        SupervisorConfig config;
+        config.shm_name = argv[1];
+        // 工作進程執行同一個程式的 --worker 模式
+        config.worker_command = {"/proc/self/exe", "--worker", config.shm_name};
+        if (argc >= 3) config.min_workers = std::stoi(argv[2]);
+        if (argc >= 4) config.max_workers = std::stoi(argv[3]);
+        
+        ProcessSupervisor supervisor(config);
+        std::cout << "監督程式已啟動，按 Ctrl+C 停止" << std::endl;
+        supervisor.run(running);
+        
+    } catch (const std::exception& ex) {
+        std::cerr << "錯誤: " << ex.what() << std::endl;
+        return -1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,328 @@
+// frame_capture.cpp
+#include "frame_capture.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+int64_t captureTimestampNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameRecorder::FrameRecorder(const std::string& path, size_t max_frames, size_t initial_size)
+    : path_(path) {
+
+    const size_t data_offset = alignUp(sizeof(CaptureFileHeader) + max_frames * sizeof(CaptureIndexEntry),
+                                       CAPTURE_FRAME_ALIGNMENT);
+    file_size_ = std::max(initial_size, data_offset);
+
+    try {
+        // 創建空檔案並設置初始大小
+        {
+            std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("無法創建錄製檔案: " + path_);
+            }
+        }
+        std::filesystem::resize_file(path_, file_size_);
+
+        // 映射整個檔案
+        file_ = bip::file_mapping(path_.c_str(), bip::read_write);
+        region_ = bip::mapped_region(file_, bip::read_write);
+
+        // 初始化標頭
+        CaptureFileHeader* hdr = header();
+        std::memcpy(hdr->magic, CAPTURE_FILE_MAGIC, sizeof(hdr->magic));
+        hdr->version = CAPTURE_FILE_VERSION;
+        hdr->header_size = sizeof(CaptureFileHeader);
+        hdr->max_frames = max_frames;
+        hdr->frame_count = 0;
+        hdr->data_offset = data_offset;
+        hdr->write_offset = data_offset;
+
+        std::cout << "創建錄製檔案: " << path_ << " (索引容量 " << max_frames << " 幀)" << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "錄製檔案錯誤: " << ex.what() << std::endl;
+        throw;
+    }
+}
+
+FrameRecorder::~FrameRecorder() {
+    close();
+}
+
+bool FrameRecorder::append(const cv::Mat& frame, int64_t timestamp_ns) {
+    if (closed_ || frame.empty()) {
+        return false;
+    }
+
+    const size_t data_size = frame.total() * frame.elemSize();
+    uint64_t offset = 0;
+    char* dst = reserve(data_size, offset);
+    if (!dst) {
+        return false;
+    }
+
+    CaptureFrameHeader* fh = reinterpret_cast<CaptureFrameHeader*>(dst);
+    fh->width = frame.cols;
+    fh->height = frame.rows;
+    fh->channels = frame.channels();
+    fh->type = frame.type();
+    fh->data_size = data_size;
+    fh->timestamp_ns = timestamp_ns;
+
+    // 非連續圖像需要逐行複製
+    char* pixels = dst + alignUp(sizeof(CaptureFrameHeader), CAPTURE_FRAME_ALIGNMENT);
+    if (frame.isContinuous()) {
+        std::memcpy(pixels, frame.data, data_size);
+    } else {
+        const size_t row_size = frame.cols * frame.elemSize();
+        for (int y = 0; y < frame.rows; y++) {
+            std::memcpy(pixels + y * row_size, frame.ptr(y), row_size);
+        }
+    }
+
+    commit(offset, data_size, timestamp_ns);
+    return true;
+}
+
+bool FrameRecorder::appendFromSharedMemory(SharedMemoryManager& shm, int64_t timestamp_ns) {
+    if (closed_) {
+        return false;
+    }
+
+    SharedImageData* data = shm.getData();
+    const SharedImageData::ProducerState& producer = data->producer;
+
+    // 先在鎖外預留空間：擴大檔案要重新映射，不能讓共享記憶體的其他使用者等待檔案操作
+    size_t reserved_size = 0;
+    {
+        std::lock_guard<RobustMutex> lock(data->mutex);
+        reserved_size = producer.data_size;
+    }
+    if (reserved_size == 0) {
+        return false;
+    }
+
+    uint64_t offset = 0;
+    char* dst = nullptr;
+    std::unique_lock<RobustMutex> lock(data->mutex, std::defer_lock);
+    while (true) {
+        dst = reserve(reserved_size, offset);
+        if (!dst) {
+            return false;
+        }
+
+        // 獲取鎖，直接從共享記憶體複製，不經過中間的 cv::Mat
+        lock.lock();
+        if (producer.data_size == 0) {
+            return false;
+        }
+        if (producer.data_size <= reserved_size) {
+            break;
+        }
+        // 兩次加鎖之間生產者寫入了更大的幀，依新的大小重新預留
+        reserved_size = producer.data_size;
+        lock.unlock();
+    }
+
+    CaptureFrameHeader* fh = reinterpret_cast<CaptureFrameHeader*>(dst);
+    fh->width = producer.width;
+    fh->height = producer.height;
+    fh->channels = producer.channels;
+    fh->type = producer.type;
+    fh->data_size = producer.data_size;
+    fh->timestamp_ns = timestamp_ns;
+
+    // 錄製檔案一律存放原始像素；編碼過的幀直接解碼到檔案中
+    char* pixels = dst + alignUp(sizeof(CaptureFrameHeader), CAPTURE_FRAME_ALIGNMENT);
+    const FrameEncoding encoding = static_cast<FrameEncoding>(producer.encoding);
+    if (encoding == FrameEncoding::RAW) {
+        std::memcpy(pixels, data->frameData(), producer.data_size);
+    } else {
+        cv::Mat target(producer.height, producer.width, producer.type, pixels);
+        if (!decodeFrame(data->frameData(), producer.payload_size, encoding,
+                         producer.height, producer.width, producer.type, target)) {
+            std::cerr << "錄製時解碼失敗" << std::endl;
+            return false;
+        }
+    }
+
+    commit(offset, producer.data_size, timestamp_ns);
+    return true;
+}
+
+char* FrameRecorder::reserve(size_t data_size, uint64_t& offset) {
+    CaptureFileHeader* hdr = header();
+    if (hdr->frame_count >= hdr->max_frames) {
+        std::cerr << "錄製檔案索引已滿 (" << hdr->max_frames << " 幀)" << std::endl;
+        return nullptr;
+    }
+
+    offset = hdr->write_offset;
+    const size_t record_size = alignUp(sizeof(CaptureFrameHeader), CAPTURE_FRAME_ALIGNMENT)
+                             + alignUp(data_size, CAPTURE_FRAME_ALIGNMENT);
+    if (offset + record_size > file_size_) {
+        try {
+            grow(offset + record_size);
+        } catch (const std::exception& ex) {
+            std::cerr << "無法擴大錄製檔案: " << ex.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    return static_cast<char*>(region_.get_address()) + offset;
+}
+
+void FrameRecorder::commit(uint64_t offset, size_t data_size, int64_t timestamp_ns) {
+    CaptureFileHeader* hdr = header();
+
+    CaptureIndexEntry& entry = index()[hdr->frame_count];
+    entry.offset = offset;
+    entry.timestamp_ns = timestamp_ns;
+
+    hdr->write_offset = offset + alignUp(sizeof(CaptureFrameHeader), CAPTURE_FRAME_ALIGNMENT)
+                      + alignUp(data_size, CAPTURE_FRAME_ALIGNMENT);
+    // 最後才更新幀數，讀取端只會看到完整的幀
+    hdr->frame_count++;
+    frame_count_ = hdr->frame_count;
+}
+
+void FrameRecorder::grow(size_t min_size) {
+    size_t new_size = file_size_;
+    while (new_size < min_size) {
+        new_size *= 2;
+    }
+
+    // 先解除映射，擴大檔案後重新映射；不在這裡 msync，寫回磁碟留給 close()
+    region_ = bip::mapped_region();
+    std::filesystem::resize_file(path_, new_size);
+    region_ = bip::mapped_region(file_, bip::read_write);
+    file_size_ = new_size;
+
+    std::cout << "擴大錄製檔案: " << path_ << " (" << new_size << " bytes)" << std::endl;
+}
+
+void FrameRecorder::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+
+    const size_t used_size = header()->write_offset;
+    const size_t frames = header()->frame_count;
+
+    // 寫回磁碟並去掉預留的空間
+    region_.flush();
+    region_ = bip::mapped_region();
+    try {
+        std::filesystem::resize_file(path_, used_size);
+    } catch (const std::exception& ex) {
+        std::cerr << "截斷錄製檔案失敗: " << ex.what() << std::endl;
+    }
+
+    std::cout << "錄製完成: " << path_ << " (" << frames << " 幀, " << used_size << " bytes)" << std::endl;
+}
+
+FrameReplaySource::FrameReplaySource(const std::string& path) {
+    try {
+        file_ = bip::file_mapping(path.c_str(), bip::read_only);
+        region_ = bip::mapped_region(file_, bip::read_only);
+    } catch (const std::exception& ex) {
+        std::cerr << "無法打開錄製檔案: " << ex.what() << std::endl;
+        throw;
+    }
+
+    if (region_.get_size() < sizeof(CaptureFileHeader)) {
+        throw std::runtime_error("錄製檔案太小: " + path);
+    }
+
+    const CaptureFileHeader* hdr = reinterpret_cast<const CaptureFileHeader*>(base());
+    if (std::memcmp(hdr->magic, CAPTURE_FILE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != CAPTURE_FILE_VERSION ||
+        hdr->header_size != sizeof(CaptureFileHeader)) {
+        throw std::runtime_error("錄製檔案格式不符: " + path);
+    }
+
+    // 索引必須完整落在標頭與數據區之間
+    const size_t file_size = region_.get_size();
+    const uint64_t index_capacity = (file_size - sizeof(CaptureFileHeader)) / sizeof(CaptureIndexEntry);
+    if (hdr->max_frames > index_capacity || hdr->frame_count > hdr->max_frames ||
+        hdr->data_offset < sizeof(CaptureFileHeader) + hdr->max_frames * sizeof(CaptureIndexEntry) ||
+        hdr->data_offset > file_size) {
+        throw std::runtime_error("錄製檔案索引損毀: " + path);
+    }
+
+    // 只接受完整落在檔案範圍內且標頭合理的幀，其餘略過
+    const CaptureIndexEntry* index = reinterpret_cast<const CaptureIndexEntry*>(base() + sizeof(CaptureFileHeader));
+    entries_.reserve(hdr->frame_count);
+    size_t skipped = 0;
+    for (size_t i = 0; i < hdr->frame_count; i++) {
+        if (validEntry(index[i], hdr->data_offset)) {
+            entries_.push_back(index[i]);
+        } else {
+            skipped++;
+        }
+    }
+    frame_count_ = entries_.size();
+
+    std::cout << "打開錄製檔案: " << path << " (" << frame_count_ << " 幀";
+    if (skipped > 0) {
+        std::cout << "，略過 " << skipped << " 個損毀的幀";
+    }
+    std::cout << ")" << std::endl;
+}
+
+bool FrameReplaySource::validEntry(const CaptureIndexEntry& entry, uint64_t data_offset) const {
+    const uint64_t file_size = region_.get_size();
+    const uint64_t header_size = alignUp(sizeof(CaptureFrameHeader), CAPTURE_FRAME_ALIGNMENT);
+    // 各項比較都先確認不會溢位
+    if (entry.offset < data_offset || entry.offset % CAPTURE_FRAME_ALIGNMENT != 0 ||
+        entry.offset > file_size || file_size - entry.offset < header_size) {
+        return false;
+    }
+
+    const CaptureFrameHeader* fh = reinterpret_cast<const CaptureFrameHeader*>(base() + entry.offset);
+    const int type = fh->type;
+    if ((type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(type) > CV_64F ||
+        static_cast<uint32_t>(CV_MAT_CN(type)) != fh->channels ||
+        fh->width == 0 || fh->height == 0 || fh->width > INT32_MAX || fh->height > INT32_MAX) {
+        return false;
+    }
+
+    // 寬高與類型推算出的大小必須等於記錄的大小，且數據不超出檔案
+    const uint64_t row_size = static_cast<uint64_t>(fh->width) * CV_ELEM_SIZE(type);
+    if (fh->height > fh->data_size / row_size || row_size * fh->height != fh->data_size) {
+        return false;
+    }
+    return fh->data_size <= file_size - entry.offset - header_size;
+}
+
+cv::Mat FrameReplaySource::frame(size_t i) const {
+    if (i >= frame_count_) {
+        return cv::Mat();
+    }
+
+    const char* record = base() + entries_[i].offset;
+    const CaptureFrameHeader* fh = reinterpret_cast<const CaptureFrameHeader*>(record);
+    const char* pixels = record + alignUp(sizeof(CaptureFrameHeader), CAPTURE_FRAME_ALIGNMENT);
+
+    // 直接指向映射區域；映射為唯讀，使用者不可修改
+    return cv::Mat(fh->height, fh->width, fh->type, const_cast<char*>(pixels));
+}
+
+int64_t FrameReplaySource::timestamp(size_t i) const {
+    return i < frame_count_ ? entries_[i].timestamp_ns : 0;
+}
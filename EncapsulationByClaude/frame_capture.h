@@ -0,0 +1,128 @@
+// frame_capture.h
+#pragma once
+
+#include "shared_memory_manager.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 錄製檔案格式：
+// [CaptureFileHeader][CaptureIndexEntry x max_frames][對齊][CaptureFrameHeader + 圖像數據]...
+// 檔案只會在尾端追加，frame_count 最後才更新，因此中途崩潰也只會遺失最後一幀
+
+// 錄製檔案魔數
+constexpr char CAPTURE_FILE_MAGIC[8] = {'I', 'P', 'C', 'C', 'A', 'P', '1', '\0'};
+constexpr uint32_t CAPTURE_FILE_VERSION = 1;
+// 每幀數據的對齊大小
+constexpr size_t CAPTURE_FRAME_ALIGNMENT = 64;
+
+// 錄製檔案標頭
+struct CaptureFileHeader {
+    char magic[8];                 // 檔案魔數
+    uint32_t version;              // 格式版本
+    uint32_t header_size;          // 標頭大小，用於相容性檢查
+    uint64_t max_frames;           // 索引容量
+    uint64_t frame_count;          // 已寫入的幀數
+    uint64_t data_offset;          // 幀數據區起始位置
+    uint64_t write_offset;         // 下一幀的寫入位置
+};
+
+// 索引項目
+struct CaptureIndexEntry {
+    uint64_t offset;               // 幀標頭在檔案中的位置
+    int64_t timestamp_ns;          // 擷取時間 (steady_clock, 奈秒)
+};
+
+// 每幀的標頭
+struct CaptureFrameHeader {
+    uint32_t width;                // 圖像寬度
+    uint32_t height;               // 圖像高度
+    uint32_t channels;             // 圖像通道數
+    int32_t type;                  // OpenCV 圖像類型
+    uint64_t data_size;            // 圖像數據大小
+    int64_t timestamp_ns;          // 擷取時間 (steady_clock, 奈秒)
+};
+
+// 回放速度模式
+enum class ReplayMode {
+    ORIGINAL_TIMING,   // 依照錄製時的時間間隔
+    FIXED_RATE,        // 固定幀率
+    AS_FAST_AS_POSSIBLE, // 不等待，盡可能快
+    LOCKSTEP           // 每幀等處理完成才發佈下一幀，結果可重現（速度受處理者限制）
+};
+
+// 目前的 steady_clock 時間 (奈秒)
+int64_t captureTimestampNow();
+
+// 幀錄製器：以記憶體映射方式追加寫入錄製檔案
+class FrameRecorder {
+public:
+    // 建構函數 - 創建錄製檔案
+    FrameRecorder(const std::string& path, size_t max_frames = 10000, size_t initial_size = 256 * 1024 * 1024);
+
+    // 解構函數 - 截斷多餘空間並寫回磁碟
+    ~FrameRecorder();
+
+    // 追加一幀
+    bool append(const cv::Mat& frame, int64_t timestamp_ns);
+
+    // 直接從共享記憶體中的當前圖像追加一幀
+    // 在鎖外預留空間（必要時擴大檔案），只在複製或解碼時持有共享記憶體的鎖
+    bool appendFromSharedMemory(SharedMemoryManager& shm, int64_t timestamp_ns);
+
+    // 已錄製的幀數（close() 之後仍可呼叫）
+    size_t frameCount() const { return frame_count_; }
+
+    // 寫回磁碟並截斷檔案到實際大小
+    void close();
+
+private:
+    std::string path_;
+    bip::file_mapping file_;
+    bip::mapped_region region_;
+    size_t file_size_;
+    size_t frame_count_ = 0;    // 已錄製的幀數；close() 後映射已解除，不能再讀標頭
+    bool closed_ = false;
+
+    CaptureFileHeader* header() const { return static_cast<CaptureFileHeader*>(region_.get_address()); }
+    CaptureIndexEntry* index() const { return reinterpret_cast<CaptureIndexEntry*>(header() + 1); }
+
+    // 預留一幀的空間，必要時擴大檔案並重新映射
+    char* reserve(size_t data_size, uint64_t& offset);
+
+    // 完成一幀的寫入並更新索引
+    void commit(uint64_t offset, size_t data_size, int64_t timestamp_ns);
+
+    // 擴大檔案（不寫回磁碟，解除映射後數據仍在分頁快取中）
+    void grow(size_t min_size);
+};
+
+// 幀回放來源：唯讀映射錄製檔案，幀數據不經複製直接使用
+class FrameReplaySource {
+public:
+    // 建構函數 - 打開並驗證錄製檔案；索引或幀標頭不合理（截斷、損毀）的幀會被略過
+    explicit FrameReplaySource(const std::string& path);
+
+    // 幀數
+    size_t frameCount() const { return frame_count_; }
+
+    // 取得第 i 幀 (指向映射區域，不複製)
+    cv::Mat frame(size_t i) const;
+
+    // 取得第 i 幀的擷取時間
+    int64_t timestamp(size_t i) const;
+
+private:
+    bip::file_mapping file_;
+    bip::mapped_region region_;
+    size_t frame_count_ = 0;
+    std::vector<CaptureIndexEntry> entries_;   // 通過驗證的幀
+
+    const char* base() const { return static_cast<const char*>(region_.get_address()); }
+
+    // 檢查一個索引項目指向的幀是否完整落在檔案內且標頭合理
+    bool validEntry(const CaptureIndexEntry& entry, uint64_t data_offset) const;
+};
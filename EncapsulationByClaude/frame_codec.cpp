@@ -0,0 +1,205 @@
+// frame_codec.cpp
+#include "frame_codec.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// DELTA_RLE 控制位元組：
+//   0x00-0x7F：其後緊接 (c + 1) 個字面值
+//   0x80-0xFF：(c - 0x7F) 個零
+constexpr int MAX_RUN = 128;
+
+// 將一段差分後的數據寫成控制位元組串流
+size_t emitRun(const uint8_t* delta, size_t length, uint8_t* out, size_t out_pos, size_t capacity) {
+    size_t i = 0;
+    while (i < length) {
+        if (delta[i] == 0) {
+            size_t run = 1;
+            while (i + run < length && run < MAX_RUN && delta[i + run] == 0) run++;
+            if (out_pos + 1 > capacity) return 0;
+            out[out_pos++] = static_cast<uint8_t>(0x7F + run);
+            i += run;
+        } else {
+            // 字面值持續到出現至少兩個連續的零為止
+            size_t run = 1;
+            while (i + run < length && run < MAX_RUN &&
+                   !(delta[i + run] == 0 && (i + run + 1 >= length || delta[i + run + 1] == 0))) {
+                run++;
+            }
+            if (out_pos + 1 + run > capacity) return 0;
+            out[out_pos++] = static_cast<uint8_t>(run - 1);
+            std::memcpy(out + out_pos, delta + i, run);
+            out_pos += run;
+            i += run;
+        }
+    }
+    return out_pos;
+}
+
+size_t encodeDeltaRle(const cv::Mat& image, uint8_t* dst, size_t capacity, cv::Mat& workspace) {
+    const size_t row_bytes = image.cols * image.elemSize();
+    workspace.create(1, static_cast<int>(row_bytes), CV_8UC1);
+    uint8_t* delta = workspace.ptr<uint8_t>(0);
+
+    size_t out_pos = 0;
+    for (int y = 0; y < image.rows; y++) {
+        const uint8_t* row = image.ptr<uint8_t>(y);
+        if (y == 0) {
+            std::memcpy(delta, row, row_bytes);
+        } else {
+            // 與上一列相減，靜態或平滑的畫面會產生大量的零
+            const uint8_t* prev = image.ptr<uint8_t>(y - 1);
+            for (size_t x = 0; x < row_bytes; x++) {
+                delta[x] = static_cast<uint8_t>(row[x] - prev[x]);
+            }
+        }
+
+        out_pos = emitRun(delta, row_bytes, dst, out_pos, capacity);
+        if (out_pos == 0) return 0;
+    }
+    return out_pos;
+}
+
+bool decodeDeltaRle(const uint8_t* src, size_t payload_size, cv::Mat& image) {
+    const size_t row_bytes = image.cols * image.elemSize();
+    size_t in_pos = 0;
+
+    for (int y = 0; y < image.rows; y++) {
+        uint8_t* row = image.ptr<uint8_t>(y);
+
+        // 先還原差分值
+        size_t x = 0;
+        while (x < row_bytes) {
+            if (in_pos >= payload_size) return false;
+            uint8_t c = src[in_pos++];
+            if (c >= 0x80) {
+                size_t run = c - 0x7F;
+                if (x + run > row_bytes) return false;
+                std::memset(row + x, 0, run);
+                x += run;
+            } else {
+                size_t run = c + 1;
+                if (x + run > row_bytes || in_pos + run > payload_size) return false;
+                std::memcpy(row + x, src + in_pos, run);
+                in_pos += run;
+                x += run;
+            }
+        }
+
+        // 再加上一列
+        if (y > 0) {
+            const uint8_t* prev = image.ptr<uint8_t>(y - 1);
+            for (size_t i = 0; i < row_bytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + prev[i]);
+            }
+        }
+    }
+    return in_pos == payload_size;
+}
+
+} // namespace
+
+const char* frameEncodingName(FrameEncoding encoding) {
+    switch (encoding) {
+        case FrameEncoding::RAW: return "RAW";
+        case FrameEncoding::NV12: return "NV12";
+        case FrameEncoding::I420: return "I420";
+        case FrameEncoding::DELTA_RLE: return "DELTA_RLE";
+    }
+    return "UNKNOWN";
+}
+
+size_t encodeFrame(const cv::Mat& image, FrameEncoding encoding, char* dst, size_t capacity, cv::Mat& workspace) {
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+
+    switch (encoding) {
+        case FrameEncoding::RAW:
+            return 0;
+
+        case FrameEncoding::NV12:
+        case FrameEncoding::I420: {
+            // 只支援偶數尺寸的 8 位元 BGR
+            if (image.type() != CV_8UC3 || image.cols % 2 != 0 || image.rows % 2 != 0) return 0;
+            const size_t y_size = static_cast<size_t>(image.cols) * image.rows;
+            const size_t size = y_size * 3 / 2;
+            if (size > capacity) return 0;
+
+            if (encoding == FrameEncoding::I420) {
+                // 直接轉換到共享記憶體
+                cv::Mat yuv(image.rows * 3 / 2, image.cols, CV_8UC1, dst);
+                cv::cvtColor(image, yuv, cv::COLOR_BGR2YUV_I420);
+                return size;
+            }
+
+            // NV12：先轉為 I420，再把 U、V 交錯寫入
+            cv::cvtColor(image, workspace, cv::COLOR_BGR2YUV_I420);
+            const uint8_t* planes = workspace.ptr<uint8_t>(0);
+            std::memcpy(out, planes, y_size);
+            const uint8_t* u = planes + y_size;
+            const uint8_t* v = u + y_size / 4;
+            uint8_t* uv = out + y_size;
+            for (size_t i = 0; i < y_size / 4; i++) {
+                uv[2 * i] = u[i];
+                uv[2 * i + 1] = v[i];
+            }
+            return size;
+        }
+
+        case FrameEncoding::DELTA_RLE:
+            return encodeDeltaRle(image, out, capacity, workspace);
+    }
+    return 0;
+}
+
+bool decodeFrame(const char* src, size_t payload_size, FrameEncoding encoding,
+                 int rows, int cols, int type, cv::Mat& image) {
+    switch (encoding) {
+        case FrameEncoding::RAW: {
+            cv::Mat view(rows, cols, type, const_cast<char*>(src));
+            view.copyTo(image);
+            return true;
+        }
+
+        case FrameEncoding::NV12:
+        case FrameEncoding::I420: {
+            if (payload_size < static_cast<size_t>(rows) * cols * 3 / 2) return false;
+            cv::Mat yuv(rows * 3 / 2, cols, CV_8UC1, const_cast<char*>(src));
+            cv::cvtColor(yuv, image, encoding == FrameEncoding::NV12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420);
+            return true;
+        }
+
+        case FrameEncoding::DELTA_RLE:
+            image.create(rows, cols, type);
+            return decodeDeltaRle(reinterpret_cast<const uint8_t*>(src), payload_size, image);
+    }
+    return false;
+}
+
+bool decodeLuma(const char* src, size_t payload_size, FrameEncoding encoding, int rows, int cols, cv::Mat& gray) {
+    if (encoding != FrameEncoding::NV12 && encoding != FrameEncoding::I420) return false;
+    if (payload_size < static_cast<size_t>(rows) * cols * 3 / 2) return false;
+
+    // 有限值域到完整值域的查表：(y - 16) * 255 / 219，四捨五入並截斷到 0-255
+    static const std::array<uint8_t, 256> full_range = [] {
+        std::array<uint8_t, 256> table{};
+        for (int y = 0; y < 256; y++) {
+            const int value = ((y - 16) * 255 * 2 + 219) / (219 * 2);
+            table[y] = static_cast<uint8_t>(std::clamp(value, 0, 255));
+        }
+        return table;
+    }();
+
+    gray.create(rows, cols, CV_8UC1);
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    for (int y = 0; y < rows; y++) {
+        const uint8_t* row_in = in + static_cast<size_t>(y) * cols;
+        uint8_t* row_out = gray.ptr<uint8_t>(y);
+        for (int x = 0; x < cols; x++) {
+            row_out[x] = full_range[row_in[x]];
+        }
+    }
+    return true;
+}
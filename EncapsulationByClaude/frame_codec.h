@@ -0,0 +1,31 @@
+// frame_codec.h
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// 共享記憶體中幀數據的編碼方式，記錄在幀標頭中
+enum class FrameEncoding : uint32_t {
+    RAW = 0,        // 原始像素 (預設)
+    NV12 = 1,       // Y 平面 + 交錯的 UV 平面，BGR 的一半大小
+    I420 = 2,       // Y 平面 + U 平面 + V 平面，BGR 的一半大小
+    DELTA_RLE = 3   // 逐列差分後以零值行程編碼，無損
+};
+
+// 取得編碼名稱
+const char* frameEncodingName(FrameEncoding encoding);
+
+// 將圖像編碼到 dst，回傳編碼後的大小
+// 圖像格式不支援該編碼或超出 capacity 時回傳 0，呼叫端應改用 RAW
+// workspace 為中間緩衝區，由呼叫端保存以重複使用
+size_t encodeFrame(const cv::Mat& image, FrameEncoding encoding, char* dst, size_t capacity, cv::Mat& workspace);
+
+// 將 src 解碼為原始圖像 (rows x cols, type)
+bool decodeFrame(const char* src, size_t payload_size, FrameEncoding encoding,
+                 int rows, int cols, int type, cv::Mat& image);
+
+// 將 YUV 編碼的 Y 平面轉為灰階圖，不必先解碼為彩色
+// Y 平面是有限值域 (16-235)，轉換時擴展到 0-255，與 cvtColor(BGR2GRAY) 的結果一致
+// 其他編碼或 payload_size 不足時回傳 false
+bool decodeLuma(const char* src, size_t payload_size, FrameEncoding encoding, int rows, int cols, cv::Mat& gray);
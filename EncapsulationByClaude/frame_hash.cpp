@@ -0,0 +1,192 @@
+// frame_hash.cpp
+#include "frame_hash.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr size_t LANES = 8;
+constexpr size_t STRIPE_SIZE = LANES * sizeof(uint64_t);   // 64 位元組
+constexpr size_t STRIPES_PER_BLOCK = 16;                   // 每 1 KB 攪拌一次累加器
+constexpr size_t BLOCK_SIZE = STRIPE_SIZE * STRIPES_PER_BLOCK;
+
+constexpr uint64_t PRIME32_1 = 0x9E3779B1U;
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+
+// 以 splitmix64 產生的金鑰；每個條帶使用錯開的一段，交換兩個條帶的內容會得到不同的雜湊
+constexpr size_t SECRET_WORDS = STRIPES_PER_BLOCK + LANES + LANES;
+
+constexpr std::array<uint64_t, SECRET_WORDS> makeSecret() {
+    std::array<uint64_t, SECRET_WORDS> secret{};
+    uint64_t state = 0x243F6A8885A308D3ULL;
+    for (uint64_t& word : secret) {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        word = z ^ (z >> 31);
+    }
+    return secret;
+}
+
+constexpr std::array<uint64_t, SECRET_WORDS> SECRET = makeSecret();
+
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// 累加一個條帶：相鄰通道交換原始數據，並加上金鑰混合後高低 32 位元的乘積
+inline void accumulateStripe(uint64_t* acc, const uint8_t* stripe, const uint64_t* key) {
+    for (size_t i = 0; i < LANES; i++) {
+        const uint64_t value = load64(stripe + i * sizeof(uint64_t));
+        const uint64_t keyed = value ^ key[i];
+        acc[i ^ 1] += value;
+        acc[i] += (keyed & 0xFFFFFFFFULL) * (keyed >> 32);
+    }
+}
+
+// 每個區塊結束時攪拌，讓區塊的順序影響結果
+inline void scramble(uint64_t* acc) {
+    const uint64_t* key = SECRET.data() + STRIPES_PER_BLOCK;
+    for (size_t i = 0; i < LANES; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+// 連續處理完整的區塊；累加器放在區域變數中，編譯器不必顧慮與輸入重疊而能保留在暫存器
+void accumulateBlocks(uint64_t* acc, const uint8_t* p, size_t blocks) {
+    alignas(64) uint64_t local[LANES];
+    std::memcpy(local, acc, sizeof(local));
+    for (size_t b = 0; b < blocks; b++, p += BLOCK_SIZE) {
+        for (size_t s = 0; s < STRIPES_PER_BLOCK; s++) {
+            accumulateStripe(local, p + s * STRIPE_SIZE, SECRET.data() + s);
+        }
+        scramble(local);
+    }
+    std::memcpy(acc, local, sizeof(local));
+}
+
+inline uint64_t mulFold64(uint64_t a, uint64_t b) {
+    const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// 串流狀態：逐段輸入時結果與一次輸入整段相同，圖像的列間距不影響雜湊
+struct HashState {
+    alignas(64) uint64_t acc[LANES];
+    alignas(64) uint8_t buffer[STRIPE_SIZE];
+    size_t buffered = 0;    // buffer 中尚未累加的位元組
+    size_t stripe = 0;      // 目前區塊中的條帶編號
+    uint64_t total = 0;     // 已輸入的位元組數
+
+    explicit HashState(uint64_t seed) {
+        static constexpr uint64_t INIT[LANES] = {
+            0xC2B2AE3DULL, PRIME64_1, PRIME64_2, 0x165667B19E3779F9ULL,
+            0x85EBCA77C2B2AE63ULL, 0x85EBCA77ULL, 0x27D4EB2F165667C5ULL, PRIME32_1,
+        };
+        for (size_t i = 0; i < LANES; i++) {
+            acc[i] = INIT[i] ^ ((i & 1) ? seed : ~seed);
+        }
+    }
+
+    void consume(const uint8_t* data) {
+        accumulateStripe(acc, data, SECRET.data() + stripe);
+        if (++stripe == STRIPES_PER_BLOCK) {
+            scramble(acc);
+            stripe = 0;
+        }
+    }
+
+    void update(const uint8_t* p, size_t size) {
+        total += size;
+
+        // 先補滿上一段留下的條帶
+        if (buffered > 0) {
+            const size_t take = std::min(size, STRIPE_SIZE - buffered);
+            std::memcpy(buffer + buffered, p, take);
+            buffered += take;
+            p += take;
+            size -= take;
+            if (buffered < STRIPE_SIZE) {
+                return;
+            }
+            consume(buffer);
+            buffered = 0;
+        }
+
+        // 對齊到區塊邊界後整塊處理
+        for (; stripe != 0 && size >= STRIPE_SIZE; p += STRIPE_SIZE, size -= STRIPE_SIZE) {
+            consume(p);
+        }
+        const size_t blocks = size / BLOCK_SIZE;
+        accumulateBlocks(acc, p, blocks);
+        p += blocks * BLOCK_SIZE;
+        size -= blocks * BLOCK_SIZE;
+        for (; size >= STRIPE_SIZE; p += STRIPE_SIZE, size -= STRIPE_SIZE) {
+            consume(p);
+        }
+
+        std::memcpy(buffer, p, size);
+        buffered = size;
+    }
+
+    uint64_t finish() {
+        // 剩餘的位元組補零成一個條帶，使用與前面錯開的金鑰
+        if (buffered > 0) {
+            std::memset(buffer + buffered, 0, STRIPE_SIZE - buffered);
+            accumulateStripe(acc, buffer, SECRET.data() + LANES + (STRIPES_PER_BLOCK - 1 - stripe));
+        }
+
+        // 合併通道；長度一併計入，補零的尾端不會與真正的零位元組混淆
+        const uint64_t* key = SECRET.data() + STRIPES_PER_BLOCK + LANES;
+        uint64_t h = total * PRIME64_1;
+        for (size_t i = 0; i < LANES; i += 2) {
+            h += mulFold64(acc[i] ^ key[i], acc[i + 1] ^ key[i + 1]);
+        }
+        return avalanche(h);
+    }
+};
+
+} // namespace
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    HashState state(seed);
+    state.update(static_cast<const uint8_t*>(data), size);
+    return state.finish();
+}
+
+uint64_t hashFrame(const cv::Mat& image) {
+    if (image.empty()) {
+        return 0;
+    }
+
+    const uint64_t seed = static_cast<uint64_t>(image.type()) << 48 ^
+                          static_cast<uint64_t>(image.rows) << 24 ^
+                          static_cast<uint64_t>(image.cols);
+    const size_t row_size = image.cols * image.elemSize();
+
+    HashState state(seed);
+    if (image.isContinuous()) {
+        state.update(image.data, row_size * image.rows);
+    } else {
+        for (int y = 0; y < image.rows; y++) {
+            state.update(image.ptr(y), row_size);
+        }
+    }
+    const uint64_t h = state.finish();
+    return h != 0 ? h : 1;
+}
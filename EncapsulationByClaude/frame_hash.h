@@ -0,0 +1,15 @@
+// frame_hash.h
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// 快速的 64 位元內容雜湊（仿 XXH3 的累加結構，但不與 xxHash 相容）
+// 8 條獨立的 64 位元通道，每次處理 64 位元組，只用 32x32 位元乘法，編譯器可直接向量化
+// 用於辨識內容相同的幀，不具密碼學強度
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// 圖像的內容雜湊：寬高與類型一併計入，非連續圖像逐列處理
+// 結果不為 0，0 保留給幀標頭表示「未計算」
+uint64_t hashFrame(const cv::Mat& image);
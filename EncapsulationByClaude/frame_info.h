@@ -0,0 +1,14 @@
+// frame_info.h
+#pragma once
+
+#include <cstdint>
+
+// 幀的識別資訊：由生產者寫入共享記憶體標頭，隨處理結果交回
+// 時間戳使用 steady_clock (CLOCK_MONOTONIC)，同一台主機的各進程間可直接比較
+struct FrameInfo {
+    uint64_t sequence = 0;     // 生產者的幀序號，從 1 開始遞增（0 表示未知）
+    int64_t capture_ns = 0;    // 擷取時間 (奈秒)
+    int64_t publish_ns = 0;    // 發佈時間 (奈秒)
+    uint32_t source_id = 0;    // 來源編號
+    uint64_t content_hash = 0; // 圖像內容雜湊 (hashFrame)，內容相同的幀相同（0 表示未計算）
+};
@@ -0,0 +1,28 @@
+// frame_kernels.cpp
+#include "frame_kernels.h"
+
+namespace {
+
+// 依模糊核大小選擇實例
+template <typename T, int CN>
+GrayBlurKernel selectForKernelSize(int ksize) {
+    switch (ksize) {
+        case 3: return &frame_kernels::grayBlur<T, CN, 3>;
+        case 5: return &frame_kernels::grayBlur<T, CN, 5>;
+        case 7: return &frame_kernels::grayBlur<T, CN, 7>;
+        default: return nullptr;
+    }
+}
+
+} // namespace
+
+GrayBlurKernel selectGrayBlurKernel(int type, int ksize) {
+    // 目前實際使用的格式：8 位元 BGR / BGRA / 灰階，以及 16 位元灰階攝像頭
+    switch (type) {
+        case CV_8UC1:  return selectForKernelSize<uint8_t, 1>(ksize);
+        case CV_8UC3:  return selectForKernelSize<uint8_t, 3>(ksize);
+        case CV_8UC4:  return selectForKernelSize<uint8_t, 4>(ksize);
+        case CV_16UC1: return selectForKernelSize<uint16_t, 1>(ksize);
+        default:       return nullptr;
+    }
+}
@@ -0,0 +1,169 @@
+// frame_kernels.h
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <type_traits>
+
+// 編譯期特化的灰階轉換 + 高斯模糊核心
+// 依像素深度、通道數與模糊核大小 (3/5/7) 展開，固定形狀下迴圈可完全展開並向量化
+// 輸出一律為 CV_8UC1 的灰階圖與模糊圖
+
+// 灰階 + 模糊核心的函數指標，每個串流依幀標頭選定一次
+// workspace 為水平模糊的中間緩衝區，由呼叫端保存以重複使用
+using GrayBlurKernel = void (*)(const cv::Mat& src, cv::Mat& gray, cv::Mat& blurred, cv::Mat& workspace);
+
+// 依圖像類型與模糊核大小選擇特化核心；不支援的組合回傳 nullptr，呼叫端改用 OpenCV 通用路徑
+GrayBlurKernel selectGrayBlurKernel(int type, int ksize);
+
+namespace frame_kernels {
+
+// sigma = 0 時 OpenCV 對 3/5/7 使用的高斯係數，以整數表示
+template <int K> struct GaussianTaps;
+template <> struct GaussianTaps<3> {
+    static constexpr int weights[3] = {1, 2, 1};
+    static constexpr int shift = 2;   // 權重總和 4
+};
+template <> struct GaussianTaps<5> {
+    static constexpr int weights[5] = {1, 4, 6, 4, 1};
+    static constexpr int shift = 4;   // 權重總和 16
+};
+template <> struct GaussianTaps<7> {
+    static constexpr int weights[7] = {2, 7, 14, 18, 14, 7, 2};
+    static constexpr int shift = 6;   // 權重總和 64
+};
+
+// BORDER_REFLECT_101 的索引映射
+inline int reflect101(int i, int n) {
+    if (n == 1) return 0;
+    while (i < 0 || i >= n) {
+        i = i < 0 ? -i : 2 * n - 2 - i;
+    }
+    return i;
+}
+
+// 16 位元縮為 8 位元，與通用路徑的 convertTo(CV_8U, 1.0 / 256) 相同：
+// 四捨五入（剛好一半時取偶數，同 cvRound）並飽和到 255
+inline uint8_t scale16To8(uint32_t v) {
+    uint32_t q = v >> 8;
+    const uint32_t rem = v & 0xFF;
+    if (rem > 128 || (rem == 128 && (q & 1))) {
+        q++;
+    }
+    return static_cast<uint8_t>(q > 255 ? 255 : q);
+}
+
+// 單一像素轉灰階，係數與 OpenCV 的 BGR2GRAY 定點實作相同
+template <typename T, int CN>
+inline uint8_t lumaOf(const T* px) {
+    if constexpr (CN == 1) {
+        if constexpr (std::is_same_v<T, uint16_t>) {
+            return scale16To8(px[0]);
+        } else {
+            return px[0];
+        }
+    } else {
+        // B, G, R (BGRA 的 alpha 忽略)
+        uint32_t y = (px[0] * 1868u + px[1] * 9617u + px[2] * 4899u + (1u << 13)) >> 14;
+        if constexpr (std::is_same_v<T, uint16_t>) {
+            return scale16To8(y);
+        } else {
+            return static_cast<uint8_t>(y);
+        }
+    }
+}
+
+// 將一列轉為灰階
+template <typename T, int CN>
+inline void grayRow(const T* src, uint8_t* dst, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = lumaOf<T, CN>(src + x * CN);
+    }
+}
+
+// 水平方向模糊一列，結果為未捨入的加權和 (BORDER_REFLECT_101)
+template <int K>
+inline void blurRowHorizontal(const uint8_t* src, uint16_t* dst, int cols) {
+    constexpr int R = K / 2;
+    constexpr const int* w = GaussianTaps<K>::weights;
+
+    // 邊界像素需要反射
+    for (int x = 0; x < std::min(R, cols); x++) {
+        uint32_t sum = 0;
+        for (int k = 0; k < K; k++) sum += w[k] * src[reflect101(x + k - R, cols)];
+        dst[x] = static_cast<uint16_t>(sum);
+    }
+    // 內部像素：固定長度內迴圈，可完全展開
+    for (int x = R; x < cols - R; x++) {
+        uint32_t sum = 0;
+        for (int k = 0; k < K; k++) sum += w[k] * src[x + k - R];
+        dst[x] = static_cast<uint16_t>(sum);
+    }
+    for (int x = std::max(R, cols - R); x < cols; x++) {
+        uint32_t sum = 0;
+        for (int k = 0; k < K; k++) sum += w[k] * src[reflect101(x + k - R, cols)];
+        dst[x] = static_cast<uint16_t>(sum);
+    }
+}
+
+// 垂直方向合併 K 列水平結果並捨入為一列輸出
+// 內迴圈沿 x 連續存取以利向量化
+template <int K>
+inline void blurRowVertical(const uint16_t* const* taps, uint8_t* dst, int cols) {
+    constexpr const int* w = GaussianTaps<K>::weights;
+    constexpr int total_shift = GaussianTaps<K>::shift * 2;
+    constexpr uint32_t round = 1u << (total_shift - 1);
+
+    for (int x = 0; x < cols; x++) {
+        uint32_t sum = 0;
+        for (int k = 0; k < K; k++) sum += w[k] * taps[k][x];
+        dst[x] = static_cast<uint8_t>((sum + round) >> total_shift);
+    }
+}
+
+// 對灰階圖做 K x K 可分離高斯模糊 (BORDER_REFLECT_101)
+// 水平結果存於 workspace (CV_16UC1)，垂直方向以整數累加後一次捨入
+template <int K>
+void gaussianBlur8u(const cv::Mat& gray, cv::Mat& blurred, cv::Mat& workspace) {
+    constexpr int R = K / 2;
+
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    workspace.create(rows, cols, CV_16UC1);
+    blurred.create(rows, cols, CV_8UC1);
+
+    // 水平方向
+    for (int y = 0; y < rows; y++) {
+        blurRowHorizontal<K>(gray.ptr<uint8_t>(y), workspace.ptr<uint16_t>(y), cols);
+    }
+
+    // 垂直方向
+    const uint16_t* taps[K];
+    for (int y = 0; y < rows; y++) {
+        for (int k = 0; k < K; k++) {
+            taps[k] = workspace.ptr<uint16_t>(reflect101(y + k - R, rows));
+        }
+        blurRowVertical<K>(taps, blurred.ptr<uint8_t>(y), cols);
+    }
+}
+
+// 特化的灰階 + 模糊管線
+template <typename T, int CN, int K>
+void grayBlur(const cv::Mat& src, cv::Mat& gray, cv::Mat& blurred, cv::Mat& workspace) {
+    static_assert(std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t>, "僅支援 8/16 位元像素");
+    static_assert(CN == 1 || CN == 3 || CN == 4, "僅支援 1/3/4 通道");
+
+    if constexpr (CN == 1 && std::is_same_v<T, uint8_t>) {
+        // 已經是 8 位元灰階，不需轉換
+        gray = src;
+    } else {
+        gray.create(src.rows, src.cols, CV_8UC1);
+        for (int y = 0; y < src.rows; y++) {
+            grayRow<T, CN>(src.ptr<T>(y), gray.ptr<uint8_t>(y), src.cols);
+        }
+    }
+
+    gaussianBlur8u<K>(gray, blurred, workspace);
+}
+
+} // namespace frame_kernels
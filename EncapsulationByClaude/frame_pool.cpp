@@ -0,0 +1,192 @@
+// frame_pool.cpp
+#include "frame_pool.h"
+#include <algorithm>
+#include <vector>
+
+PooledMatAllocator::PooledMatAllocator(size_t max_cached_buffers)
+    : max_cached_buffers_(max_cached_buffers) {
+}
+
+PooledMatAllocator::~PooledMatAllocator() {
+    for (auto& entry : free_buffers_) {
+        cv::fastFree(entry.second);
+    }
+}
+
+cv::UMatData* PooledMatAllocator::allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                                           cv::AccessFlag, cv::UMatUsageFlags) const {
+    // 與 OpenCV 預設配置器相同的步長計算
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    uchar* data = static_cast<uchar*>(data0);
+    if (!data) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = free_buffers_.find(total);
+        if (it != free_buffers_.end()) {
+            data = it->second;
+            free_buffers_.erase(it);
+            reuses_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!data) {
+        data = static_cast<uchar*>(cv::fastMalloc(total));
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0) {
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    }
+    return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData* u, cv::AccessFlag, cv::UMatUsageFlags) const {
+    return u != nullptr;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData* u) const {
+    if (!u) {
+        return;
+    }
+
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED) && u->origdata) {
+        // 放回空閒列表；超過上限時釋放最小的緩衝區
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_buffers_.emplace(u->size, u->origdata);
+        if (free_buffers_.size() > max_cached_buffers_) {
+            auto smallest = free_buffers_.begin();
+            cv::fastFree(smallest->second);
+            free_buffers_.erase(smallest);
+        }
+        u->origdata = nullptr;
+    }
+    delete u;
+}
+
+PooledFrame::PooledFrame(PooledFrame&& other) noexcept
+    : pool_(other.pool_), slot_(other.slot_) {
+    other.pool_ = nullptr;
+    other.slot_ = -1;
+}
+
+PooledFrame& PooledFrame::operator=(PooledFrame&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        slot_ = other.slot_;
+        other.pool_ = nullptr;
+        other.slot_ = -1;
+    }
+    return *this;
+}
+
+const cv::Mat& PooledFrame::mat() const {
+    static const cv::Mat empty;
+    return pool_ ? pool_->slots_[slot_].mat : empty;
+}
+
+void PooledFrame::release() {
+    if (pool_) {
+        pool_->releaseSlot(slot_);
+        pool_ = nullptr;
+        slot_ = -1;
+    }
+}
+
+FramePool::FramePool(size_t slot_count, size_t max_slots)
+    : allocator_(slot_count * 2),
+      max_slots_(std::max<size_t>(max_slots, 2)),
+      slot_count_(std::clamp<size_t>(slot_count, 2, max_slots_)),
+      slots_(new Slot[max_slots_]) {
+    for (size_t i = 0; i < max_slots_; i++) {
+        slots_[i].mat.allocator = &allocator_;
+    }
+}
+
+size_t FramePool::setSlotCount(size_t slot_count) {
+    // 縮小時超出的槽位不再被取得，仍被持有的參考照常釋放
+    const size_t count = std::clamp<size_t>(slot_count, 2, max_slots_);
+    slot_count_.store(count, std::memory_order_relaxed);
+    return count;
+}
+
+int FramePool::acquireSlot() {
+    const int published = published_.load(std::memory_order_acquire);
+    const size_t slot_count = slot_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < slot_count; i++) {
+        if (static_cast<int>(i) == published) continue;
+        int expected = 0;
+        if (slots_[i].refs.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void FramePool::reserve(int rows, int cols, int type, size_t spare_buffers) {
+    const int published = published_.load(std::memory_order_acquire);
+    const size_t slot_count = slot_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < slot_count; i++) {
+        // 被讀取者持有或已發佈的槽位不能改動
+        int expected = 0;
+        if (static_cast<int>(i) == published ||
+            !slots_[i].refs.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+            continue;
+        }
+        slots_[i].mat.create(rows, cols, type);
+        slots_[i].mat.setTo(cv::Scalar::all(0));
+        releaseSlot(static_cast<int>(i));
+    }
+
+    // 全部配置完才一起釋放（逐一釋放會重用同一塊），緩衝區回到空閒列表
+    std::vector<cv::Mat> spares(spare_buffers);
+    for (cv::Mat& spare : spares) {
+        spare.allocator = &allocator_;
+        spare.create(rows, cols, type);
+        spare.setTo(cv::Scalar::all(0));
+    }
+}
+
+PooledFrame FramePool::publish(int slot) {
+    // 回傳給呼叫端的參考
+    slots_[slot].refs.fetch_add(1, std::memory_order_relaxed);
+
+    // 寫入者的參考轉為「已發佈」的參考；舊的發佈槽位交還
+    const int previous = published_.exchange(slot, std::memory_order_acq_rel);
+    if (previous >= 0) {
+        releaseSlot(previous);
+    }
+    return PooledFrame(this, slot);
+}
+
+PooledFrame FramePool::acquirePublished() const {
+    while (true) {
+        const int slot = published_.load(std::memory_order_acquire);
+        if (slot < 0) {
+            return PooledFrame();
+        }
+
+        // 先增加參考再確認仍是最新發佈的槽位，否則放棄重試
+        slots_[slot].refs.fetch_add(1, std::memory_order_acq_rel);
+        if (published_.load(std::memory_order_acquire) == slot) {
+            return PooledFrame(this, slot);
+        }
+        releaseSlot(slot);
+    }
+}
+
+void FramePool::releaseSlot(int slot) const {
+    slots_[slot].refs.fetch_sub(1, std::memory_order_acq_rel);
+}
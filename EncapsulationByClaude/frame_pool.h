@@ -0,0 +1,122 @@
+// frame_pool.h
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// 回收緩衝區的 cv::MatAllocator
+// 釋放的緩衝區依大小保留在空閒列表中，下次相同大小的 create() 直接重用，避免穩態下反覆 malloc/free
+class PooledMatAllocator : public cv::MatAllocator {
+public:
+    explicit PooledMatAllocator(size_t max_cached_buffers = 8);
+    ~PooledMatAllocator() override;
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag access_flags, cv::UMatUsageFlags usage_flags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+    // 實際向系統配置的次數
+    size_t allocationCount() const { return allocations_.load(std::memory_order_relaxed); }
+    // 從空閒列表重用的次數
+    size_t reuseCount() const { return reuses_.load(std::memory_order_relaxed); }
+
+private:
+    size_t max_cached_buffers_;
+    mutable std::mutex mutex_;
+    mutable std::multimap<size_t, uchar*> free_buffers_;   // 大小 -> 緩衝區
+    mutable std::atomic<size_t> allocations_{0};
+    mutable std::atomic<size_t> reuses_{0};
+};
+
+class FramePool;
+
+// 已發佈幀的唯讀參考；持有期間該槽位不會被覆寫
+class PooledFrame {
+public:
+    PooledFrame() = default;
+    ~PooledFrame() { release(); }
+
+    PooledFrame(const PooledFrame&) = delete;
+    PooledFrame& operator=(const PooledFrame&) = delete;
+    PooledFrame(PooledFrame&& other) noexcept;
+    PooledFrame& operator=(PooledFrame&& other) noexcept;
+
+    explicit operator bool() const { return pool_ != nullptr; }
+
+    // 幀數據（不可修改）
+    const cv::Mat& mat() const;
+
+    // 提前釋放參考
+    void release();
+
+private:
+    friend class FramePool;
+    PooledFrame(const FramePool* pool, int slot) : pool_(pool), slot_(slot) {}
+
+    const FramePool* pool_ = nullptr;
+    int slot_ = -1;
+};
+
+// 幀緩衝池
+// 單一寫入者取得空閒槽位、寫入後發佈；讀取者無鎖地取得最新發佈的槽位
+// 槽位陣列一次配置到 max_slots，使用中的槽位數可以調整而不搬移槽位（緩衝區在第一次使用時才配置）
+class FramePool {
+public:
+    explicit FramePool(size_t slot_count = 4, size_t max_slots = 64);
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // 寫入者：取得一個空閒槽位，全部被佔用時回傳 -1
+    int acquireSlot();
+
+    // 寫入者：槽位的緩衝區（使用池配置器，尺寸不變時不會重新配置）
+    cv::Mat& slotMat(int slot) { return slots_[slot].mat; }
+
+    // 寫入者：將槽位發佈為最新幀，並回傳該幀的參考
+    PooledFrame publish(int slot);
+
+    // 調整可取得的槽位數（限制在 2 到 max_slots 之間），回傳實際的槽位數；可在使用中呼叫
+    // 例如非同步回調的每個排隊項目都持有一個槽位，槽位數需大於佇列容量
+    size_t setSlotCount(size_t slot_count);
+
+    // 可取得的槽位數與上限
+    size_t slotCount() const { return slot_count_.load(std::memory_order_relaxed); }
+    size_t maxSlots() const { return max_slots_; }
+
+    // 寫入者：放棄已取得但不發佈的槽位
+    void discard(int slot) { releaseSlot(slot); }
+
+    // 寫入者：預先把空閒的槽位配置為指定尺寸並寫入一次，第一幀不必配置緩衝區與觸發分頁錯誤
+    // spare_buffers 個同尺寸的緩衝區留在配置器的空閒列表中，供擷取緩衝區等使用同一配置器的 cv::Mat 重用
+    void reserve(int rows, int cols, int type, size_t spare_buffers = 1);
+
+    // 讀取者：取得最新發佈的幀（尚未發佈時為空）
+    PooledFrame acquirePublished() const;
+
+    // 池使用的配置器，也可指定給擷取用的 cv::Mat
+    cv::MatAllocator* allocator() { return &allocator_; }
+    const PooledMatAllocator& pooledAllocator() const { return allocator_; }
+
+private:
+    friend class PooledFrame;
+
+    struct Slot {
+        cv::Mat mat;
+        mutable std::atomic<int> refs{0};   // 寫入者、發佈本身與每個讀取者各持有一個參考
+    };
+
+    // 配置器必須比槽位中的 cv::Mat 活得久，因此宣告在前
+    PooledMatAllocator allocator_;
+    const size_t max_slots_;
+    std::atomic<size_t> slot_count_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<int> published_{-1};
+
+    void releaseSlot(int slot) const;
+};
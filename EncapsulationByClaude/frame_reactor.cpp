@@ -0,0 +1,249 @@
+// frame_reactor.cpp
+#include "frame_reactor.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <system_error>
+
+SegmentAwaiter::SegmentAwaiter(FrameReactor& reactor, std::function<bool()> ready, int timeout_ms, int event_fd)
+    : reactor_(reactor), ready_(std::move(ready)), has_deadline_(timeout_ms >= 0), event_fd_(event_fd) {
+    if (has_deadline_) {
+        deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    }
+}
+
+void SegmentAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    // 登記後協程可能立即在反應器執行緒上恢復，之後不可再存取 this
+    reactor_.watch(this);
+}
+
+void ReactorTask::promise_type::unhandled_exception() {
+    try {
+        throw;
+    } catch (const std::exception& ex) {
+        std::cerr << "協程中出錯: " << ex.what() << std::endl;
+    } catch (...) {
+        std::cerr << "協程中出現未知錯誤" << std::endl;
+    }
+}
+
+ReactorTask::~ReactorTask() {
+    // 從未交給反應器的協程由這裡銷毀
+    if (handle_) {
+        handle_.destroy();
+    }
+}
+
+std::coroutine_handle<> ReactorTask::release() {
+    std::coroutine_handle<> handle = handle_;
+    handle_ = nullptr;
+    return handle;
+}
+
+FrameReactor::FrameReactor(int poll_interval_us)
+    : poll_interval_us_(poll_interval_us > 0 ? poll_interval_us : 500) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd_ < 0 || event_fd_ < 0 || timer_fd_ < 0) {
+        int err = errno;
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+        if (event_fd_ >= 0) close(event_fd_);
+        if (timer_fd_ >= 0) close(timer_fd_);
+        throw std::system_error(err, std::generic_category(), "無法建立事件循環");
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = event_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev);
+    ev.data.fd = timer_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &ev);
+}
+
+FrameReactor::~FrameReactor() {
+    // 尚未恢復的協程一併銷毀
+    for (SegmentAwaiter* awaiter : waiters_) {
+        awaiter->handle_.destroy();
+    }
+    for (auto handle : posted_) {
+        handle.destroy();
+    }
+    close(timer_fd_);
+    close(event_fd_);
+    close(epoll_fd_);
+}
+
+void FrameReactor::run() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+
+    epoll_event events[16];
+    while (true) {
+        drainPosted();
+        pollWaiters();
+        updateTimer();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) break;
+        }
+
+        int n = epoll_wait(epoll_fd_, events, 16, -1);
+        if (n < 0 && errno != EINTR) {
+            std::cerr << "epoll_wait 失敗: " << errno << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            // 各種 fd 都只需讀空（eventfd/timerfd 的計數，或通知 socket 中累積的多個位元組），條件在下一輪檢查
+            uint64_t value;
+            ssize_t result;
+            do {
+                result = read(events[i].data.fd, &value, sizeof(value));
+            } while (result > 0);
+            if (result < 0 && errno != EAGAIN) {
+                std::cerr << "讀取事件失敗: " << errno << std::endl;
+            }
+        }
+    }
+}
+
+void FrameReactor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wakeup();
+}
+
+void FrameReactor::spawn(ReactorTask task) {
+    post(task.release());
+}
+
+void FrameReactor::post(std::coroutine_handle<> handle) {
+    if (!handle) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(handle);
+    }
+    wakeup();
+}
+
+size_t FrameReactor::waiterCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return waiters_.size();
+}
+
+void FrameReactor::watch(SegmentAwaiter* awaiter) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const int fd = awaiter->event_fd_;
+        if (fd >= 0 && sources_.insert(fd).second) {
+            // 事件 fd 由提供者擁有，反應器只登記一次；提供者必須比反應器活得久
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                std::cerr << "登記事件來源失敗: " << errno << std::endl;
+                sources_.erase(fd);
+                awaiter->event_fd_ = -1;
+            }
+        }
+        waiters_.push_back(awaiter);
+    }
+    wakeup();
+}
+
+void FrameReactor::wakeup() {
+    uint64_t one = 1;
+    if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        std::cerr << "喚醒事件循環失敗: " << errno << std::endl;
+    }
+}
+
+void FrameReactor::pollWaiters() {
+    std::vector<SegmentAwaiter*> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (waiters_.empty()) return;
+
+        const auto now = std::chrono::steady_clock::now();
+        size_t kept = 0;
+        for (SegmentAwaiter* awaiter : waiters_) {
+            if (awaiter->ready_()) {
+                ready.push_back(awaiter);
+            } else if (awaiter->has_deadline_ && now >= awaiter->deadline_) {
+                awaiter->timed_out_ = true;
+                ready.push_back(awaiter);
+            } else {
+                waiters_[kept++] = awaiter;
+            }
+        }
+        waiters_.resize(kept);
+    }
+
+    // 在鎖外恢復，協程可能再次 co_await 而登記新的等待者
+    for (SegmentAwaiter* awaiter : ready) {
+        awaiter->handle_.resume();
+    }
+}
+
+void FrameReactor::drainPosted() {
+    std::vector<std::coroutine_handle<>> posted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted.swap(posted_);
+    }
+    for (auto handle : posted) {
+        handle.resume();
+    }
+}
+
+void FrameReactor::updateTimer() {
+    bool polling = false;
+    std::chrono::steady_clock::time_point deadline{};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const SegmentAwaiter* awaiter : waiters_) {
+            if (awaiter->event_fd_ < 0) {
+                polling = true;
+            } else if (awaiter->has_deadline_ &&
+                       (deadline == std::chrono::steady_clock::time_point{} || awaiter->deadline_ < deadline)) {
+                deadline = awaiter->deadline_;
+            }
+        }
+    }
+    if (polling) {
+        // 定期檢查時逾時也一併在檢查中處理
+        deadline = {};
+    }
+    if (polling == timer_polling_ && deadline == timer_deadline_) return;
+
+    itimerspec spec{};
+    int flags = 0;
+    if (polling) {
+        spec.it_interval.tv_sec = poll_interval_us_ / 1000000;
+        spec.it_interval.tv_nsec = (poll_interval_us_ % 1000000) * 1000;
+        spec.it_value = spec.it_interval;
+    } else if (deadline != std::chrono::steady_clock::time_point{}) {
+        // steady_clock 即 CLOCK_MONOTONIC，以絕對時間設定單次到期
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1;   // 全為 0 表示停用
+        }
+        flags = TFD_TIMER_ABSTIME;
+    }
+    timerfd_settime(timer_fd_, flags, &spec, nullptr);
+    timer_polling_ = polling;
+    timer_deadline_ = deadline;
+}
@@ -0,0 +1,124 @@
+// frame_reactor.h
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <vector>
+
+class FrameReactor;
+
+// 等待共享記憶體狀態改變的 awaitable
+// co_await 的結果：true 表示條件成立，false 表示超時
+// event_fd：條件可能改變時會變為可讀的 fd（例如 SharedMemoryManager::eventFd()），由反應器登記到 epoll；
+// 為 -1 時反應器只能定期檢查條件
+class SegmentAwaiter {
+public:
+    SegmentAwaiter(FrameReactor& reactor, std::function<bool()> ready, int timeout_ms, int event_fd = -1);
+
+    bool await_ready() const { return ready_(); }
+    void await_suspend(std::coroutine_handle<> handle);
+    bool await_resume() const { return !timed_out_; }
+
+private:
+    friend class FrameReactor;
+
+    FrameReactor& reactor_;
+    std::function<bool()> ready_;
+    std::chrono::steady_clock::time_point deadline_;
+    bool has_deadline_;
+    int event_fd_;
+    bool timed_out_ = false;
+    std::coroutine_handle<> handle_;
+};
+
+// 由反應器執行的協程；建立時不會開始執行，交給 FrameReactor::spawn() 後在反應器執行緒上運行
+class ReactorTask {
+public:
+    struct promise_type {
+        ReactorTask get_return_object() {
+            return ReactorTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        // 執行完畢後自行銷毀
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception();
+    };
+
+    ReactorTask(ReactorTask&& other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+    ReactorTask(const ReactorTask&) = delete;
+    ReactorTask& operator=(const ReactorTask&) = delete;
+    ~ReactorTask();
+
+private:
+    friend class FrameReactor;
+    explicit ReactorTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    // 交出協程的所有權
+    std::coroutine_handle<> release();
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// 以 epoll + eventfd + timerfd 驅動的事件循環
+// 共享記憶體的條件變數無法放進 epoll，等待者提供的事件 fd（對方進程直接寫入的通知 socket）可讀時才檢查條件；
+// timerfd 只在最早的逾時到期時觸發，跨執行緒的喚醒與停止透過 eventfd
+// 沒有事件 fd 的等待者存在時，退回以 timerfd 定期檢查
+class FrameReactor {
+public:
+    // poll_interval_us：有沒有事件 fd 的等待者時，定期檢查條件的間隔
+    explicit FrameReactor(int poll_interval_us = 500);
+    ~FrameReactor();
+
+    FrameReactor(const FrameReactor&) = delete;
+    FrameReactor& operator=(const FrameReactor&) = delete;
+
+    // 在當前執行緒執行事件循環，直到 stop()
+    void run();
+
+    // 停止事件循環（可從任何執行緒或信號處理以外的地方呼叫）
+    void stop();
+
+    // 排入一個協程，在反應器執行緒上開始執行
+    void spawn(ReactorTask task);
+
+    // 排入一個協程恢復（可從任何執行緒呼叫）
+    void post(std::coroutine_handle<> handle);
+
+    // 目前等待中的協程數
+    size_t waiterCount() const;
+
+private:
+    friend class SegmentAwaiter;
+
+    int epoll_fd_ = -1;
+    int event_fd_ = -1;   // 跨執行緒喚醒
+    int timer_fd_ = -1;   // 定期檢查等待條件
+    int poll_interval_us_;
+    bool timer_polling_ = false;                          // 計時器目前是否為定期檢查
+    std::chrono::steady_clock::time_point timer_deadline_; // 計時器目前的單次到期時間（未設定時為預設值）
+    bool running_ = false;
+
+    mutable std::mutex mutex_;
+    std::vector<SegmentAwaiter*> waiters_;
+    std::vector<std::coroutine_handle<>> posted_;
+    std::set<int> sources_;                               // 已登記到 epoll 的事件 fd
+
+    // 登記等待者
+    void watch(SegmentAwaiter* awaiter);
+
+    // 喚醒事件循環
+    void wakeup();
+
+    // 檢查所有等待者，恢復條件成立或超時的協程
+    void pollWaiters();
+
+    // 恢復排入的協程
+    void drainPosted();
+
+    // 依等待者設定計時器：有沒有事件 fd 的等待者時定期檢查，否則只在最早的逾時到期
+    void updateTimer();
+};
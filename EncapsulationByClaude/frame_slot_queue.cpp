@@ -0,0 +1,547 @@
+// frame_slot_queue.cpp
+#include "frame_slot_queue.h"
+#include "frame_hash.h"
+#include "robust_sync.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool isProcessAlive(int32_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// 等待中也要定期醒來檢查停滯的槽位
+constexpr int MAX_WAIT_SLICE_MS = 100;
+
+} // namespace
+
+const char* pushResultName(PushResult result) {
+    switch (result) {
+        case PushResult::OK: return "OK";
+        case PushResult::FULL: return "佇列已滿";
+        case PushResult::THROTTLED: return "超過公平配額";
+        case PushResult::TOO_LARGE: return "圖像太大";
+        case PushResult::NOT_REGISTERED: return "未登記生產者";
+    }
+    return "未知";
+}
+
+FrameSlotQueue::FrameSlotQueue(const std::string& name, const SlotQueueConfig& config) : name_(name) {
+    try {
+        for (int attempt = 0;; attempt++) {
+            try {
+                create(config);
+                break;
+            } catch (const bip::interprocess_exception& ex) {
+                if (ex.get_error_code() != bip::already_exists_error) {
+                    throw;
+                }
+            }
+            if (open()) {
+                break;
+            }
+            if (attempt > 0) {
+                throw std::runtime_error("幀佇列尚未初始化: " + name_);
+            }
+            // 創建者在初始化完成前就已終止，移除殘留的佇列後重新建立
+            std::cerr << "移除初始化未完成的殘留幀佇列: " << name_ << std::endl;
+            remove(name_);
+        }
+        mask_ = shared_->layout.slot_count - 1;
+        attach();
+    } catch (const std::exception& ex) {
+        std::cerr << "幀佇列錯誤: " << ex.what() << std::endl;
+        throw;
+    }
+}
+
+FrameSlotQueue::~FrameSlotQueue() {
+    if (producer_id_ != 0) {
+        // 註銷生產者；佇列中剩下的幀仍會被取出
+        shared_->producers[producer_id_ - 1].pid.store(0);
+    }
+
+    if (!detach()) {
+        std::cout << "清理幀佇列: " << name_ << std::endl;
+        remove(name_);
+    }
+}
+
+void FrameSlotQueue::attach() {
+    const int32_t self = getpid();
+    for (uint32_t i = 0; i < MAX_SLOT_QUEUE_ATTACHMENTS; i++) {
+        int32_t current = shared_->attachments[i].load();
+        // 空格，或連接的進程已崩潰而沒有釋放
+        if ((current == 0 || (current != self && !isProcessAlive(current))) &&
+            shared_->attachments[i].compare_exchange_strong(current, self)) {
+            attachment_ = static_cast<int>(i);
+            return;
+        }
+    }
+    throw std::runtime_error("幀佇列的連接數已滿: " + name_);
+}
+
+bool FrameSlotQueue::detach() {
+    if (attachment_ >= 0) {
+        shared_->attachments[attachment_].store(0);
+        attachment_ = -1;
+    }
+    bool others = false;
+    for (std::atomic<int32_t>& attachment : shared_->attachments) {
+        int32_t pid = attachment.load();
+        if (pid == 0) {
+            continue;
+        }
+        if (isProcessAlive(pid)) {
+            others = true;
+        } else {
+            // 崩潰的進程留下的格子
+            attachment.compare_exchange_strong(pid, 0);
+        }
+    }
+    return others;
+}
+
+void FrameSlotQueue::create(const SlotQueueConfig& config) {
+    if (config.slot_count < 2 || (config.slot_count & (config.slot_count - 1)) != 0) {
+        throw std::invalid_argument("槽位數必須是 2 的次方");
+    }
+
+    shm_ = bip::shared_memory_object(bip::create_only, name_.c_str(), bip::read_write);
+
+    // 每個槽位的數據對齊到快取行，槽位之間不共用快取行
+    const size_t slots_offset = alignUp(sizeof(SlotQueueShared), 64);
+    const size_t slot_stride = alignUp(sizeof(SlotHeader) + config.slot_capacity, 64);
+    const size_t shm_size = slots_offset + slot_stride * config.slot_count;
+    shm_.truncate(shm_size);
+    region_ = bip::mapped_region(shm_, bip::read_write);
+
+    shared_ = new (region_.get_address()) SlotQueueShared;
+    // 最先寫入創建者，初始化期間連接的進程據此判斷創建者是否仍存活
+    reinterpret_cast<volatile int32_t&>(shared_->layout.creator_pid) = getpid();
+    shared_->layout.version = SLOT_QUEUE_VERSION;
+    shared_->layout.header_size = sizeof(SlotQueueShared);
+    shared_->layout.slot_count = config.slot_count;
+    shared_->layout.slot_capacity = config.slot_capacity;
+    shared_->layout.slot_stride = slot_stride;
+    shared_->layout.slots_offset = slots_offset;
+    shared_->enqueue_pos = 0;
+    shared_->dequeue_pos = 0;
+    shared_->publish_word = 0;
+    shared_->waiters = 0;
+    for (std::atomic<int32_t>& attachment : shared_->attachments) {
+        attachment = 0;
+    }
+    for (SlotQueueShared::ProducerEntry& entry : shared_->producers) {
+        entry.pid = 0;
+        entry.generation = 0;
+        entry.in_flight = 0;
+        entry.sequence = 0;
+        entry.pushed = 0;
+        entry.throttled = 0;
+        entry.full = 0;
+    }
+
+    mask_ = config.slot_count - 1;
+    for (uint32_t i = 0; i < config.slot_count; i++) {
+        SlotHeader* slot = new (slotAt(i)) SlotHeader;
+        slot->turn = i;
+        slot->owner_pid = 0;
+        slot->producer_id = 0;
+        slot->producer_generation = 0;
+        slot->data_size = 0;
+    }
+
+    // 最後寫入識別碼，其他進程以此判斷初始化完成
+    std::atomic_thread_fence(std::memory_order_release);
+    shared_->layout.magic = SLOT_QUEUE_MAGIC;
+
+    std::cout << "創建幀佇列: " << name_ << " (" << config.slot_count << " 個槽位, " << shm_size << " bytes)" << std::endl;
+}
+
+bool FrameSlotQueue::open() {
+    shm_ = bip::shared_memory_object(bip::open_only, name_.c_str(), bip::read_write);
+
+    // 創建者可能尚未設置大小或寫入標頭；逾時仍未設置大小表示創建者已在設置前終止
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ABANDONED_SLOT_TIMEOUT_MS);
+    bip::offset_t size = 0;
+    while (!shm_.get_size(size) || size < static_cast<bip::offset_t>(sizeof(SlotQueueShared))) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    region_ = bip::mapped_region(shm_, bip::read_write);
+    shared_ = static_cast<SlotQueueShared*>(region_.get_address());
+
+    while (reinterpret_cast<volatile uint32_t&>(shared_->layout.magic) != SLOT_QUEUE_MAGIC) {
+        const int32_t creator = reinterpret_cast<volatile int32_t&>(shared_->layout.creator_pid);
+        if (creator != 0 && !isProcessAlive(creator)) {
+            return false;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            if (creator == 0) {
+                // 創建者在寫入自己的 PID 之前就已終止
+                return false;
+            }
+            throw std::runtime_error("幀佇列尚未初始化或不是本程式建立的: " + name_);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    const SlotQueueShared::Layout& layout = shared_->layout;
+    if (layout.version != SLOT_QUEUE_VERSION || layout.header_size != sizeof(SlotQueueShared)) {
+        throw std::runtime_error("幀佇列版本不符: " + name_);
+    }
+    if (layout.slot_count == 0 || (layout.slot_count & (layout.slot_count - 1)) != 0 ||
+        layout.slots_offset + layout.slot_stride * layout.slot_count > region_.get_size()) {
+        throw std::runtime_error("幀佇列版面不正確: " + name_);
+    }
+
+    std::cout << "連接到幀佇列: " << name_ << " (" << layout.slot_count << " 個槽位)" << std::endl;
+    return true;
+}
+
+SlotHeader* FrameSlotQueue::slotAt(uint64_t pos) const {
+    char* base = reinterpret_cast<char*>(shared_) + shared_->layout.slots_offset;
+    return reinterpret_cast<SlotHeader*>(base + (pos & mask_) * shared_->layout.slot_stride);
+}
+
+uint32_t FrameSlotQueue::registerProducer() {
+    if (producer_id_ != 0) {
+        return producer_id_;
+    }
+
+    const int32_t self = getpid();
+    for (uint32_t i = 0; i < MAX_SLOT_QUEUE_PRODUCERS; i++) {
+        SlotQueueShared::ProducerEntry& entry = shared_->producers[i];
+        int32_t current = entry.pid.load();
+        // 空位，或登記者已終止
+        if ((current == 0 || !isProcessAlive(current)) && entry.pid.compare_exchange_strong(current, self)) {
+            // 先換世代再清零，上一個登記者留在佇列中的幀被取出時不會扣到新的名額
+            producer_generation_ = entry.generation.fetch_add(1) + 1;
+            entry.in_flight = 0;
+            entry.sequence = 0;
+            entry.pushed = 0;
+            entry.throttled = 0;
+            entry.full = 0;
+            producer_id_ = i + 1;
+            producers_checked_ = std::chrono::steady_clock::time_point();
+            std::cout << "登記為幀佇列的生產者 #" << producer_id_ << std::endl;
+            return producer_id_;
+        }
+    }
+    throw std::runtime_error("幀佇列的生產者已滿: " + name_);
+}
+
+uint32_t FrameSlotQueue::activeProducers() const {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - producers_checked_ < std::chrono::milliseconds(MAX_WAIT_SLICE_MS)) {
+        return active_producers_;
+    }
+    producers_checked_ = now;
+
+    uint32_t active = 0;
+    for (SlotQueueShared::ProducerEntry& entry : shared_->producers) {
+        int32_t pid = entry.pid.load();
+        if (pid == 0) {
+            continue;
+        }
+        if (!isProcessAlive(pid)) {
+            // 已終止的生產者不再佔用配額
+            if (entry.pid.compare_exchange_strong(pid, 0)) {
+                entry.in_flight = 0;
+            }
+            continue;
+        }
+        active++;
+    }
+    active_producers_ = std::max<uint32_t>(1, active);
+    return active_producers_;
+}
+
+uint32_t FrameSlotQueue::fairShare() const {
+    return std::max<uint32_t>(1, shared_->layout.slot_count / activeProducers());
+}
+
+PushResult FrameSlotQueue::push(const cv::Mat& image, int64_t capture_ns) {
+    if (producer_id_ == 0) {
+        return PushResult::NOT_REGISTERED;
+    }
+
+    const size_t data_size = image.total() * image.elemSize();
+    if (image.empty() || data_size > shared_->layout.slot_capacity) {
+        return PushResult::TOO_LARGE;
+    }
+
+    // 公平配額：先預留自己的名額，超過時放棄這一幀
+    SlotQueueShared::ProducerEntry& entry = shared_->producers[producer_id_ - 1];
+    if (entry.in_flight.fetch_add(1, std::memory_order_acq_rel) >= fairShare()) {
+        entry.in_flight.fetch_sub(1, std::memory_order_acq_rel);
+        entry.throttled.fetch_add(1, std::memory_order_relaxed);
+        return PushResult::THROTTLED;
+    }
+
+    // 內容雜湊在佔用槽位之前計算，不延長佔用槽位的時間（佇列已滿時這次計算白費）
+    const uint64_t content_hash = content_hash_ ? hashFrame(image) : 0;
+
+    // 以 CAS 佔用下一個可寫入的槽位
+    const uint64_t slot_count = shared_->layout.slot_count;
+    uint64_t pos = shared_->enqueue_pos.load(std::memory_order_relaxed);
+    SlotHeader* slot = nullptr;
+    while (true) {
+        slot = slotAt(pos);
+        const uint64_t turn = slot->turn.load(std::memory_order_acquire);
+        const int64_t diff = static_cast<int64_t>(turn) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (shared_->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 槽位仍被上一輪的讀取佔用；讀取的消費者已崩潰時回收後重試
+            const bool being_read = pos >= slot_count && turn == pos - slot_count + 1 &&
+                                    shared_->dequeue_pos.load(std::memory_order_acquire) > pos - slot_count;
+            if (being_read && recoverAbandoned(pos - slot_count, turn, pos)) {
+                continue;
+            }
+            entry.in_flight.fetch_sub(1, std::memory_order_acq_rel);
+            entry.full.fetch_add(1, std::memory_order_relaxed);
+            return PushResult::FULL;
+        } else {
+            // 其他生產者已佔用此位置
+            pos = shared_->enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // 已獨佔槽位，寫入標頭與數據
+    slot->owner_pid.store(getpid(), std::memory_order_relaxed);
+    slot->producer_id = producer_id_;
+    slot->producer_generation = producer_generation_;
+    slot->frame.sequence = entry.sequence.fetch_add(1, std::memory_order_relaxed) + 1;
+    slot->frame.capture_ns = capture_ns != 0 ? capture_ns : steadyNowNs();
+    slot->frame.source_id = producer_id_;
+    slot->width = image.cols;
+    slot->height = image.rows;
+    slot->type = image.type();
+    slot->data_size = data_size;
+
+    char* dst = slotData(slot);
+    if (image.isContinuous()) {
+        std::memcpy(dst, image.data, data_size);
+    } else {
+        const size_t row_size = image.cols * image.elemSize();
+        for (int y = 0; y < image.rows; y++) {
+            std::memcpy(dst + y * row_size, image.ptr(y), row_size);
+        }
+    }
+    slot->frame.content_hash = content_hash;
+    slot->frame.publish_ns = steadyNowNs();
+
+    // 發佈：turn = pos + 1 表示可讀取；先清除佔用者，下一個佔用者在寫入自己的 PID 之前崩潰時，
+    // 回收者看到的是 0（視為已終止），而不是這一輪仍存活的佔用者
+    slot->owner_pid.store(0, std::memory_order_relaxed);
+    slot->turn.store(pos + 1, std::memory_order_release);
+    entry.pushed.fetch_add(1, std::memory_order_relaxed);
+    wakeConsumer();
+    return PushResult::OK;
+}
+
+bool FrameSlotQueue::pop(cv::Mat& image, FrameInfo* info, int timeout_ms) {
+    const bool has_deadline = timeout_ms >= 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(0, timeout_ms));
+    const uint64_t slot_count = shared_->layout.slot_count;
+
+    while (true) {
+        // 先記下發佈計數，佇列為空時以它等待，避免錯過在檢查之後放入的幀
+        const uint32_t observed = shared_->publish_word.load(std::memory_order_seq_cst);
+
+        uint64_t pos = shared_->dequeue_pos.load(std::memory_order_relaxed);
+        SlotHeader* slot = nullptr;
+        while (true) {
+            slot = slotAt(pos);
+            const uint64_t turn = slot->turn.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(turn) - static_cast<int64_t>(pos + 1);
+            if (diff == 0) {
+                if (shared_->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 空佇列，或生產者仍在寫入；寫入的生產者已崩潰時略過該槽位
+                const bool being_written = turn == pos && shared_->enqueue_pos.load(std::memory_order_acquire) > pos;
+                if (being_written && recoverAbandoned(pos, turn, pos + 1)) {
+                    continue;
+                }
+                slot = nullptr;
+                break;
+            } else {
+                pos = shared_->dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        if (slot) {
+            // 已獨佔槽位，複製出數據後立即釋放給生產者
+            slot->owner_pid.store(getpid(), std::memory_order_relaxed);
+            const uint32_t producer_id = slot->producer_id;
+            const uint32_t producer_generation = slot->producer_generation;
+            const bool valid = slot->data_size != 0;
+            if (valid) {
+                image.create(slot->height, slot->width, slot->type);
+                const size_t row_size = image.cols * image.elemSize();
+                const char* src = slotData(slot);
+                for (int y = 0; y < image.rows; y++) {
+                    std::memcpy(image.ptr(y), src + y * row_size, row_size);
+                }
+                if (info) {
+                    *info = slot->frame;
+                }
+            }
+            // 釋放給生產者前清除佔用者（原因同 push()）
+            slot->owner_pid.store(0, std::memory_order_relaxed);
+            slot->turn.store(pos + slot_count, std::memory_order_release);
+
+            releaseProducerShare(producer_id, producer_generation);
+
+            if (valid) {
+                return true;
+            }
+            continue;
+        }
+
+        // 佇列為空：以 futex 等待下一次發佈（定期醒來檢查停滯的槽位）
+        const auto now = std::chrono::steady_clock::now();
+        if (has_deadline && now >= deadline) {
+            return false;
+        }
+        waitForPublish(observed, deadline, has_deadline);
+    }
+}
+
+bool FrameSlotQueue::recoverAbandoned(uint64_t pos, uint64_t expected_turn, uint64_t released_turn) {
+    SlotHeader* slot = slotAt(pos);
+    const auto now = std::chrono::steady_clock::now();
+
+    // 第一次觀察到停滯時只記錄時間，持續停滯超過逾時才處理
+    if (stalled_pos_ != pos || stalled_turn_ != expected_turn) {
+        stalled_pos_ = pos;
+        stalled_turn_ = expected_turn;
+        stalled_since_ = now;
+        return false;
+    }
+    if (now - stalled_since_ < std::chrono::milliseconds(ABANDONED_SLOT_TIMEOUT_MS) ||
+        isProcessAlive(slot->owner_pid.load(std::memory_order_relaxed))) {
+        return false;
+    }
+
+    const bool writer_crashed = released_turn == pos + 1;
+    const uint32_t producer_id = slot->producer_id;
+    const uint32_t producer_generation = slot->producer_generation;
+    if (writer_crashed) {
+        // 寫入到一半的幀標記為無效，消費者取出時略過；名額隨生產者登記一併清除
+        slot->data_size = 0;
+        slot->producer_id = 0;
+    }
+
+    uint64_t turn = expected_turn;
+    if (!slot->turn.compare_exchange_strong(turn, released_turn, std::memory_order_acq_rel)) {
+        return false;
+    }
+
+    std::cerr << "回收崩潰的" << (writer_crashed ? "生產者" : "消費者") << "留下的槽位 (位置 " << pos
+              << ", PID " << slot->owner_pid.load() << ")" << std::endl;
+    slot->owner_pid.store(0, std::memory_order_relaxed);
+    if (!writer_crashed) {
+        // 讀取到一半的幀不會再被釋放，歸還生產者的名額
+        releaseProducerShare(producer_id, producer_generation);
+    }
+    stalled_pos_ = UINT64_MAX;
+    if (writer_crashed) {
+        wakeConsumer();
+    }
+    return true;
+}
+
+void FrameSlotQueue::releaseProducerShare(uint32_t producer_id, uint32_t generation) {
+    if (producer_id == 0) {
+        return;
+    }
+    SlotQueueShared::ProducerEntry& entry = shared_->producers[producer_id - 1];
+    if (entry.generation.load(std::memory_order_acquire) != generation) {
+        // 放入這一幀的生產者已終止，這一格已由新的生產者登記
+        return;
+    }
+    // 與重新登記同時發生時計數可能已清零，不讓它倒退成極大值
+    uint32_t current = entry.in_flight.load(std::memory_order_relaxed);
+    while (current > 0 && !entry.in_flight.compare_exchange_weak(current, current - 1, std::memory_order_acq_rel)) {
+    }
+}
+
+void FrameSlotQueue::wakeConsumer() {
+    shared_->publish_word.fetch_add(1, std::memory_order_seq_cst);
+    if (shared_->waiters.load(std::memory_order_seq_cst) > 0) {
+        // 每一幀只需要一個消費者
+        futexWake(&shared_->publish_word, 1);
+    }
+}
+
+void FrameSlotQueue::waitForPublish(uint32_t observed, std::chrono::steady_clock::time_point deadline, bool has_deadline) {
+    auto wait = std::chrono::milliseconds(MAX_WAIT_SLICE_MS);
+    if (has_deadline) {
+        wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()) +
+                                  std::chrono::milliseconds(1));
+    }
+    timespec timeout;
+    timeout.tv_sec = wait.count() / 1000;
+    timeout.tv_nsec = (wait.count() % 1000) * 1000000;
+
+    shared_->waiters.fetch_add(1, std::memory_order_seq_cst);
+    futexWait(&shared_->publish_word, observed, &timeout);
+    shared_->waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+size_t FrameSlotQueue::size() const {
+    const uint64_t enqueued = shared_->enqueue_pos.load(std::memory_order_relaxed);
+    const uint64_t dequeued = shared_->dequeue_pos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? static_cast<size_t>(enqueued - dequeued) : 0;
+}
+
+std::vector<SlotQueueProducerStats> FrameSlotQueue::producerStats() const {
+    std::vector<SlotQueueProducerStats> result;
+    for (uint32_t i = 0; i < MAX_SLOT_QUEUE_PRODUCERS; i++) {
+        const SlotQueueShared::ProducerEntry& entry = shared_->producers[i];
+        const int32_t pid = entry.pid.load();
+        if (pid == 0) {
+            continue;
+        }
+        SlotQueueProducerStats stats;
+        stats.producer_id = i + 1;
+        stats.pid = pid;
+        stats.in_flight = entry.in_flight.load(std::memory_order_relaxed);
+        stats.pushed = entry.pushed.load(std::memory_order_relaxed);
+        stats.throttled = entry.throttled.load(std::memory_order_relaxed);
+        stats.full = entry.full.load(std::memory_order_relaxed);
+        result.push_back(stats);
+    }
+    return result;
+}
+
+bool FrameSlotQueue::remove(const std::string& name) {
+    return bip::shared_memory_object::remove(name.c_str());
+}
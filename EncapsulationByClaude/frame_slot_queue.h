@@ -0,0 +1,197 @@
+// frame_slot_queue.h
+#pragma once
+
+#include "frame_info.h"
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bip = boost::interprocess;
+
+// 多生產者佇列的識別碼與版本
+constexpr uint32_t SLOT_QUEUE_MAGIC = 0x51535049;   // "IPSQ"
+constexpr uint32_t SLOT_QUEUE_VERSION = 3;
+// 可同時登記的生產者數
+constexpr uint32_t MAX_SLOT_QUEUE_PRODUCERS = 16;
+// 可同時連接的 FrameSlotQueue 物件數（所有進程合計）
+constexpr uint32_t MAX_SLOT_QUEUE_ATTACHMENTS = 64;
+
+// 佇列參數，只在第一個連接的進程建立佇列時使用
+struct SlotQueueConfig {
+    uint32_t slot_count = 8;                     // 槽位數，必須是 2 的次方
+    size_t slot_capacity = 1920 * 1080 * 3;      // 每個槽位可存放的圖像大小
+};
+
+// push() 的結果
+enum class PushResult {
+    OK,               // 已放入佇列
+    FULL,             // 佇列已滿
+    THROTTLED,        // 此生產者在佇列中的幀已達公平配額
+    TOO_LARGE,        // 圖像超過槽位大小
+    NOT_REGISTERED    // 尚未呼叫 registerProducer()
+};
+
+const char* pushResultName(PushResult result);
+
+// 每個生產者的統計
+struct SlotQueueProducerStats {
+    uint32_t producer_id = 0;    // 生產者編號 (1 起)
+    int32_t pid = 0;             // 生產者進程 ID
+    uint32_t in_flight = 0;      // 目前在佇列中的幀數
+    uint64_t pushed = 0;         // 已放入的幀數
+    uint64_t throttled = 0;      // 因超過公平配額而丟棄的幀數
+    uint64_t full = 0;           // 因佇列已滿而丟棄的幀數
+};
+
+// 共享記憶體中的佇列標頭
+struct SlotQueueShared {
+    // 版面資訊：創建後唯讀
+    struct alignas(64) Layout {
+        uint32_t magic;                 // 識別碼
+        uint32_t version;               // 版本
+        uint32_t header_size;           // 標頭大小
+        uint32_t slot_count;            // 槽位數
+        uint64_t slot_capacity;         // 每個槽位的數據區大小
+        uint64_t slot_stride;           // 相鄰槽位的間距
+        uint64_t slots_offset;          // 第一個槽位相對於標頭起點的位移
+        int32_t creator_pid;            // 創建者進程 ID，映射後最先寫入；創建者在寫入識別碼前終止時據此移除殘留的佇列
+    } layout;
+
+    // 生產者與消費者的位置各自佔用一個快取行，避免互相干擾
+    alignas(64) std::atomic<uint64_t> enqueue_pos;    // 下一個要佔用的位置
+    alignas(64) std::atomic<uint64_t> dequeue_pos;    // 下一個要取出的位置
+    alignas(64) std::atomic<uint32_t> publish_word;   // 每放入一幀遞增，消費者以 futex 在此等待
+    std::atomic<uint32_t> waiters;                    // 等待中的消費者數，為 0 時生產者不必喚醒
+    // 連接表：每個連接的物件佔一格並記下所屬進程，0 為空格
+    // 斷開時若已沒有存活的連接就移除佇列；崩潰的進程留下的格子由之後連接或斷開的進程清除
+    alignas(64) std::atomic<int32_t> attachments[MAX_SLOT_QUEUE_ATTACHMENTS];
+
+    // 生產者登記表，每個生產者獨佔一個快取行
+    struct alignas(64) ProducerEntry {
+        std::atomic<int32_t> pid;           // 0 表示空位
+        std::atomic<uint32_t> generation;   // 每次登記時遞增，區分同一格先後的生產者
+        std::atomic<uint32_t> in_flight;    // 在佇列中尚未被取出的幀數
+        std::atomic<uint64_t> sequence;     // 最後使用的幀序號
+        std::atomic<uint64_t> pushed;       // 已放入的幀數
+        std::atomic<uint64_t> throttled;    // 因公平配額丟棄的幀數
+        std::atomic<uint64_t> full;         // 因佇列已滿丟棄的幀數
+    } producers[MAX_SLOT_QUEUE_PRODUCERS];
+};
+
+// 槽位標頭，數據緊接在後
+// turn 依 Vyukov 有界佇列的作法表示槽位狀態：等於位置時可寫入，等於位置 + 1 時可讀取
+struct alignas(64) SlotHeader {
+    std::atomic<uint64_t> turn;         // 槽位狀態
+    std::atomic<int32_t> owner_pid;     // 目前佔用槽位的進程（寫入中的生產者或讀取中的消費者），釋放時清為 0
+    uint32_t producer_id;               // 放入這一幀的生產者編號
+    uint32_t producer_generation;       // 放入時生產者登記的世代；與目前的登記不同時不歸還名額
+    FrameInfo frame;                    // 序號、時間戳與來源（source_id 為生產者編號）
+    uint32_t width;                     // 圖像寬度
+    uint32_t height;                    // 圖像高度
+    int32_t type;                       // OpenCV 圖像類型
+    uint64_t data_size;                 // 圖像數據大小
+};
+
+// 多生產者、多消費者的幀佇列
+// 佔用槽位只用原子操作 (CAS)，沒有全域鎖；生產者不會阻塞，佇列已滿或超過配額時直接回傳
+// 公平性：每個生產者在佇列中的幀數不超過 槽位數 / 登記的生產者數，頻繁發佈的生產者不會佔滿佇列
+// 佔用槽位的進程崩潰時，其他進程在逾時後回收該槽位，佇列不會卡住
+class FrameSlotQueue {
+public:
+    // 佔用中的槽位停滯超過此時間且佔用者已終止時回收
+    static constexpr int ABANDONED_SLOT_TIMEOUT_MS = 1000;
+
+    // 連接到佇列，不存在時依 config 建立
+    explicit FrameSlotQueue(const std::string& name, const SlotQueueConfig& config = SlotQueueConfig());
+
+    // 解構函數 - 註銷生產者，沒有其他存活的連接時移除佇列
+    ~FrameSlotQueue();
+
+    FrameSlotQueue(const FrameSlotQueue&) = delete;
+    FrameSlotQueue& operator=(const FrameSlotQueue&) = delete;
+
+    // 生產者：登記並取得生產者編號（寫入每一幀的標頭），沒有空位時拋出例外
+    uint32_t registerProducer();
+
+    // 生產者：放入一幀（複製到槽位），不阻塞
+    // capture_ns 為擷取時間 (steady_clock, 奈秒)，0 表示以放入時間為準
+    PushResult push(const cv::Mat& image, int64_t capture_ns = 0);
+
+    // 生產者：放入時是否計算內容雜湊寫入幀標頭（預設關閉），消費者的結果快取據此辨識內容相同的幀
+    void setContentHash(bool enable) { content_hash_ = enable; }
+
+    // 消費者：取出一幀（複製出槽位後立即釋放），超時回傳 false；timeout_ms < 0 表示無限等待
+    bool pop(cv::Mat& image, FrameInfo* info = nullptr, int timeout_ms = -1);
+
+    // 目前在佇列中的幀數（近似值）
+    size_t size() const;
+
+    // 每個生產者的公平配額
+    uint32_t fairShare() const;
+
+    // 已登記的生產者統計
+    std::vector<SlotQueueProducerStats> producerStats() const;
+
+    // 移除佇列（靜態方法）
+    static bool remove(const std::string& name);
+
+private:
+    std::string name_;
+    bip::shared_memory_object shm_;
+    bip::mapped_region region_;
+    SlotQueueShared* shared_;
+    uint32_t mask_;                     // 槽位數 - 1
+    uint32_t producer_id_ = 0;          // 本進程的生產者編號（未登記為 0）
+    uint32_t producer_generation_ = 0;  // 登記時取得的世代
+    int attachment_ = -1;               // 在連接表中佔用的格子
+    bool content_hash_ = false;         // 放入時是否計算內容雜湊
+
+    // 登記的生產者數快取，定期重新計算
+    mutable uint32_t active_producers_ = 1;
+    mutable std::chrono::steady_clock::time_point producers_checked_;
+
+    // 停滯槽位的觀察起點，用於判斷是否逾時
+    uint64_t stalled_pos_ = UINT64_MAX;
+    uint64_t stalled_turn_ = 0;
+    std::chrono::steady_clock::time_point stalled_since_;
+
+    // 建立新的佇列
+    void create(const SlotQueueConfig& config);
+
+    // 打開已存在的佇列；創建者在初始化完成前就已終止（殘留的佇列）時回傳 false
+    bool open();
+    
+    // 在連接表中佔用一格（空格或已終止進程的格子），表已滿時拋出例外
+    void attach();
+    
+    // 釋放連接表中的格子，回傳是否還有其他存活的連接
+    bool detach();
+    
+    // 取出或回收一幀後歸還生產者的名額；生產者已重新登記（世代不同）時不歸還
+    void releaseProducerShare(uint32_t producer_id, uint32_t generation);
+
+    // 第 pos 個位置對應的槽位
+    SlotHeader* slotAt(uint64_t pos) const;
+
+    // 槽位數據起點
+    static char* slotData(SlotHeader* slot) { return reinterpret_cast<char*>(slot) + sizeof(SlotHeader); }
+
+    // 重新計算登記的生產者數（並清除已終止的生產者）
+    uint32_t activeProducers() const;
+
+    // 位置 pos 的槽位停滯且佔用者已終止時回收，回傳是否已回收
+    // expected_turn 為停滯時的 turn，released_turn 為回收後的 turn
+    bool recoverAbandoned(uint64_t pos, uint64_t expected_turn, uint64_t released_turn);
+
+    // 喚醒等待中的消費者
+    void wakeConsumer();
+
+    // 等待 publish_word 改變或超時
+    void waitForPublish(uint32_t observed, std::chrono::steady_clock::time_point deadline, bool has_deadline);
+};
@@ -1,44 +1,199 @@
 // image_processor.cpp
 #include "image_processor.h"
+#include "frame_hash.h"
+#include "rate_controller.h"
+#include <chrono>
 #include <iostream>
 #include <thread>
 
-ImageProcessor::ImageProcessor(const std::string& shm_name) {
+ImageProcessor::ImageProcessor(const std::string& shm_name, SharedMemoryMode mode) {
     try {
         // 連接到共享記憶體
-        shm_manager_ = std::make_unique<SharedMemoryManager>(shm_name, SharedMemoryMode::OPEN);
+        shm_manager_ = std::make_unique<SharedMemoryManager>(shm_name, mode);
     } catch (const std::exception& ex) {
         std::cerr << "無法連接到共享記憶體: " << ex.what() << std::endl;
         throw;
     }
 }
 
+ImageProcessor::ImageProcessor() = default;
+
+bool ImageProcessor::setCallbackDispatch(CallbackDispatchMode mode, size_t queue_capacity, OverflowPolicy policy) {
+    std::shared_ptr<CallbackDispatcher> dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        dispatcher = callback_dispatcher_;
+    }
+    if (dispatcher && dispatcher->onWorkerThread()) {
+        // 在非同步回調中切換會讓背景執行緒解構自己的派送器
+        std::cerr << "不能在非同步回調中切換回調執行方式" << std::endl;
+        return false;
+    }
+    
+    dispatcher.reset();
+    if (mode == CallbackDispatchMode::ASYNC) {
+        // 每個回調完成時回報剩餘的排隊數，生產者不必等到下一次送出才知道佇列已消化
+        dispatcher = std::make_shared<CallbackDispatcher>(queue_capacity, policy, 1, [this](size_t depth) {
+            if (shm_manager_) shm_manager_->reportQueueDepth(static_cast<uint32_t>(depth));
+        });
+    }
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        callback_dispatcher_.swap(dispatcher);
+    }
+    // 舊的佇列在鎖外解構，先執行完剩餘的回調；處理執行緒仍持有時由它在送出後解構
+    dispatcher.reset();
+    if (mode != CallbackDispatchMode::ASYNC && shm_manager_) {
+        // 同步模式沒有排隊中的回調，清除之前回報的深度，否則生產者一直以舊值放慢
+        shm_manager_->reportQueueDepth(0);
+    }
+    return true;
+}
+
+void ImageProcessor::setIntraFrameThreads(size_t threads) {
+    tiled_filter_.reset();
+    intra_frame_pool_.reset();
+    if (threads > 1) {
+        // 呼叫端執行緒也參與執行，因此背景執行緒少一個
+        intra_frame_pool_ = std::make_unique<WorkStealingPool>(threads - 1);
+        tiled_filter_ = std::make_unique<TiledBlurThreshold>(*intra_frame_pool_);
+    }
+}
+
+CallbackDispatchStats ImageProcessor::callbackStats() const {
+    std::shared_ptr<CallbackDispatcher> dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        dispatcher = callback_dispatcher_;
+    }
+    return dispatcher ? dispatcher->stats() : CallbackDispatchStats();
+}
+
+void ImageProcessor::setResultCallback(ProcessResultCallback callback) {
+    if (!callback) {
+        result_callback_ = nullptr;
+        return;
+    }
+    result_callback_ = [callback](const cv::Mat& result, const std::vector<ProcessedObject>& objects, const FrameInfo&) {
+        callback(result, objects);
+    };
+}
+
+void ImageProcessor::dispatchResult(cv::Mat& result, std::vector<ProcessedObject>& objects, const FrameInfo& frame) {
+    // 每個物體都帶回所屬幀的資訊
+    for (ProcessedObject& obj : objects) {
+        obj.frame = frame;
+    }
+    
+    if (!result_callback_) {
+        return;
+    }
+    
+    // 只在鎖內取得派送器；BLOCK 策略下 post() 可能等待，不能持有 dispatch_mutex_
+    std::shared_ptr<CallbackDispatcher> dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        dispatcher = callback_dispatcher_;
+    }
+    
+    if (dispatcher) {
+        // 結果移交給共享的唯讀參考，背景執行緒使用時不需要複製
+        auto shared_result = std::make_shared<const cv::Mat>(std::move(result));
+        auto shared_objects = std::make_shared<const std::vector<ProcessedObject>>(std::move(objects));
+        FrameResultCallback callback = result_callback_;
+        dispatcher->post([callback, shared_result, shared_objects, frame] {
+            callback(*shared_result, *shared_objects, frame);
+        });
+        
+        // 回報排隊中的回調數，生產者據此放慢發佈速度；剛送出的這一個不計入，
+        // 否則佇列消化得再快，生產者的間隔也至少被放大一倍
+        if (shm_manager_) {
+            const size_t depth = dispatcher->stats().queue_depth;
+            shm_manager_->reportQueueDepth(static_cast<uint32_t>(depth > 0 ? depth - 1 : 0));
+        }
+        return;
+    }
+    
+    // 同步回調
+    result_callback_(result, objects, frame);
+}
+
+void ImageProcessor::warmUp(const WarmUpConfig& config) {
+    auto start = std::chrono::steady_clock::now();
+    
+    // 共享記憶體的分頁（消費者只讀取）
+    if (shm_manager_) shm_manager_->prefault();
+    
+    // OpenCV 的執行緒池；HighGUI 在第一次建立視窗時初始化
+    warmOpenCvThreads();
+    if (show_windows_) {
+        cv::namedWindow("原始圖片", cv::WINDOW_AUTOSIZE);
+        cv::namedWindow("二值化", cv::WINDOW_AUTOSIZE);
+        cv::namedWindow("物體檢測結果", cv::WINDOW_AUTOSIZE);
+        cv::waitKey(1);
+    }
+    
+    // 合成幀走一次偵測：選定核心、配置工作區與標記緩衝區、喚醒單幀平行的執行緒池
+    // 速率控制降低解析度後的尺寸也各走一次，由最小的層級開始，最後留下原始解析度的工作區給第一幀
+    // 生產者發佈灰階平面時，第一幀會走灰階輸入的路徑（跳過轉換，管線經由 LUMA 輸入），兩條路徑都預熱
+    // 不顯示合成幀，也不經過結果快取
+    const bool show_windows = show_windows_;
+    show_windows_ = false;
+    const bool warm_gray = shm_manager_ && shm_manager_->producerPublishesLuma();
+    cv::Mat sample = makeWarmUpFrame(config.max_size, config.type);
+    cv::Mat result;
+    for (int tier = std::max(0, config.max_resolution_tier); tier >= 0; tier--) {
+        cv::Mat scaled;
+        RateController::applyTier(sample, scaled, tier);
+        frame_tier_ = tier;
+        detectObjects(scaled, result, cv::Mat());
+        if (warm_gray && scaled.channels() != 1) {
+            cv::Mat gray;
+            cv::cvtColor(scaled, gray, scaled.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+            detectObjects(scaled, result, gray);
+        }
+    }
+    show_windows_ = show_windows;
+    
+    if (shm_manager_) shm_manager_->setReady(true);
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "處理者預熱完成 (" << config.max_size.width << "x" << config.max_size.height << ", 解析度層級 0~"
+              << std::max(0, config.max_resolution_tier) << (warm_gray ? ", 含灰階輸入" : "") << ", " << elapsed_ms
+              << " ms)" << std::endl;
+}
+
 void ImageProcessor::processOnce() {
+    if (!shm_manager_) {
+        std::cerr << "未連接共享記憶體" << std::endl;
+        return;
+    }
+    
     try {
-        // 等待新圖像
-        if (!shm_manager_->waitForNewImage()) {
-            std::cerr << "等待新圖像超時" << std::endl;
-            return;
+        // 以逾時等待新圖像，生產者重啟時重新連接後繼續等待
+        while (!shm_manager_->waitForNewImage(100)) {
+            if (shm_manager_->reattachIfStale()) {
+                std::cout << "已重新連接到重啟後的生產者" << std::endl;
+            }
         }
         
-        // 從共享記憶體讀取圖像
-        cv::Mat image = shm_manager_->readImage();
+        // 從共享記憶體讀取圖像（以及生產者預先算好的灰階圖）
+        cv::Mat gray;
+        cv::Mat image = shm_manager_->readImage(&gray);
         if (image.empty()) {
             std::cerr << "讀取到空圖像" << std::endl;
             return;
         }
         
-        std::cout << "接收到新圖像: " << image.cols << "x" << image.rows 
+        if (verbose_) std::cout << "接收到新圖像: " << image.cols << "x" << image.rows 
                  << " (" << image.total() * image.elemSize() << " bytes)" << std::endl;
         
         // 處理圖像
         cv::Mat result;
-        std::vector<ProcessedObject> objects = processImage(image, result);
+        std::vector<ProcessedObject> objects = processImage(image, result, gray, shm_manager_->frameInfo().content_hash,
+                                                              shm_manager_->frameResolutionTier());
         
         // 如果有回調，執行回調
-        if (result_callback_) {
-            result_callback_(result, objects);
-        }
+        dispatchResult(result, objects, shm_manager_->frameInfo());
         
         // 通知處理完成
         shm_manager_->notifyProcessingDone();
@@ -54,7 +209,51 @@ void ImageProcessor::processOnce() {
     }
 }
 
-std::vector<ProcessedObject> ImageProcessor::processImage(const cv::Mat& image, cv::Mat& result) {
+std::vector<ProcessedObject> ImageProcessor::processImage(const cv::Mat& image, cv::Mat& result, const cv::Mat& gray,
+                                                          uint64_t content_hash, int resolution_tier) {
+    // 偵測與快取都在縮小後的座標上進行，交出前才換算回原始解析度
+    frame_tier_ = std::max(0, resolution_tier);
+    std::vector<ProcessedObject> objects = detectOrLookup(image, result, gray, content_hash);
+    scaleObjectsToFullResolution(objects, frame_tier_);
+    return objects;
+}
+
+std::vector<ProcessedObject> ImageProcessor::detectOrLookup(const cv::Mat& image, cv::Mat& result, const cv::Mat& gray,
+                                                            uint64_t content_hash) {
+    // 偵測管線的結果圖不一定只是框線，無法由快取的物體重繪
+    if (!result_cache_.enabled() || pipeline_ || image.empty()) {
+        return detectObjects(image, result, gray);
+    }
+    
+    if (content_hash == 0) {
+        content_hash = hashFrame(image);
+    }
+    
+    const size_t frame_bytes = image.total() * image.elemSize();
+    std::vector<ProcessedObject> objects;
+    if (result_cache_.lookup(content_hash, objects, frame_bytes)) {
+        // 內容與先前的幀相同：不執行偵測，只在這一幀上重繪結果
+        result = image.clone();
+        drawDetectedObjects(result, objects);
+        if (shm_manager_) shm_manager_->reportCacheHit(frame_bytes);
+        
+        if (show_windows_) {
+            cv::namedWindow("物體檢測結果", cv::WINDOW_AUTOSIZE);
+            cv::imshow("物體檢測結果", result);
+        }
+        
+        if (verbose_) std::cout << "內容與先前的幀相同，使用快取的結果，有效物體數量: " << objects.size() << std::endl;
+        return objects;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    objects = detectObjects(image, result, gray);
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result_cache_.insert(content_hash, objects, elapsed_ms);
+    return objects;
+}
+
+std::vector<ProcessedObject> ImageProcessor::detectObjects(const cv::Mat& image, cv::Mat& result, const cv::Mat& precomputed_gray) {
     std::vector<ProcessedObject> detected_objects;
     
     // 顯示原始圖片
@@ -63,17 +262,27 @@ std::vector<ProcessedObject> ImageProcessor::processImage(const cv::Mat& image,
         cv::imshow("原始圖片", image);
     }
     
-    // 轉換為灰階
-    cv::Mat gray;
-    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
-    
-    // 套用高斯模糊以減少噪點
-    cv::Mat blurred;
-    cv::GaussianBlur(gray, blurred, cv::Size(blur_size_, blur_size_), 0);
+    // 已設置管線時依管線的節點執行
+    if (pipeline_) {
+        return runPipeline(image, result, precomputed_gray);
+    }
     
-    // 套用二值化以分離前景和背景
-    cv::Mat binary;
-    cv::threshold(blurred, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+    // 轉換為灰階並套用高斯模糊以減少噪點；已有灰階圖時只做模糊
+    // 再套用二值化以分離前景和背景
+    const cv::Mat& input = precomputed_gray.empty() ? image : precomputed_gray;
+    cv::Mat& blurred = blurred_workspace_;
+    cv::Mat& binary = binary_workspace_;
+    if (tiled_filter_ && use_specialized_kernels_ && TiledBlurThreshold::supports(input.type(), blur_size_)) {
+        // 條帶平行（使用特化核心），結果與下方的序列路徑相同
+        tiled_filter_->apply(input, blur_size_, blurred, binary);
+    } else {
+        grayAndBlur(input, gray_workspace_, blurred);
+        // 單通道 8 位元的輸入直接作為灰階圖，不保留參考，避免下一幀的轉換寫入這一幀的緩衝區
+        if (gray_workspace_.data == input.data) {
+            gray_workspace_.release();
+        }
+        cv::threshold(blurred, binary, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+    }
     
     // 顯示二值化結果
     if (show_windows_) {
@@ -81,44 +290,58 @@ std::vector<ProcessedObject> ImageProcessor::processImage(const cv::Mat& image,
         cv::imshow("二值化", binary);
     }
     
-    // 尋找輪廓
-    std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
-    cv::findContours(binary, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-    
-    std::cout << "偵測到 " << contours.size() << " 個輪廓" << std::endl;
+    // 擷取物體
+    if (object_extraction_ == ObjectExtraction::LABELING) {
+        extractByLabeling(binary, detected_objects);
+    } else {
+        extractByContours(binary, detected_objects);
+    }
     
-    // 繪製輪廓
+    // 繪製輪廓、邊界框與編號
     result = image.clone();
-    int valid_object_count = 0;
+    const int valid_object_count = static_cast<int>(detected_objects.size());
+    drawDetectedObjects(result, detected_objects);
     
-    for (size_t i = 0; i < contours.size(); i++) {
-        // 過濾掉太小的輪廓（可能是噪點）
-        double area = cv::contourArea(contours[i]);
-        if (area < min_object_area_) continue;
-        
-        // 為每個物體建立結構
-        ProcessedObject obj;
-        obj.id = valid_object_count++;
-        obj.area = area;
-        obj.contour = contours[i];
-        obj.boundingBox = cv::boundingRect(contours[i]);
-        
-        // 為每個物體畫輪廓
-        cv::Scalar color = cv::Scalar(0, 255, 0); // 綠色
-        cv::drawContours(result, contours, i, color, 2);
-        
-        // 計算並繪製每個物體的邊界框
-        cv::rectangle(result, obj.boundingBox, cv::Scalar(0, 0, 255), 2); // 紅色
-        
-        // 在物體上標記編號
-        cv::Point center(obj.boundingBox.x + obj.boundingBox.width/2, obj.boundingBox.y + obj.boundingBox.height/2);
-        cv::putText(result, "Object " + std::to_string(obj.id), 
-                    cv::Point(obj.boundingBox.x, obj.boundingBox.y - 10),
-                    cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 0, 0), 1);
-        
-        // 添加到結果集
-        detected_objects.push_back(obj);
+    // 顯示結果
+    if (show_windows_) {
+        cv::namedWindow("物體檢測結果", cv::WINDOW_AUTOSIZE);
+        cv::imshow("物體檢測結果", result);
+    }
+    
+    if (verbose_) std::cout << "物件檢測完成，有效物體數量: " << valid_object_count << std::endl;
+    
+    return detected_objects;
+}
+
+void ImageProcessor::setResultCacheCapacity(size_t entries) {
+    result_cache_.setCapacity(entries);
+    if (shm_manager_) shm_manager_->requestContentHash(entries > 0);
+}
+
+void ImageProcessor::setPipeline(std::unique_ptr<DetectionPipeline> pipeline) {
+    if (pipeline && (!pipeline->built() || !pipeline->has("objects"))) {
+        std::cerr << "偵測管線未建立或沒有輸出 objects，維持原本的處理流程" << std::endl;
+        return;
+    }
+    pipeline_ = std::move(pipeline);
+    result_cache_.clear();
+    if (pipeline_) {
+        std::cout << "使用偵測管線:\n" << pipeline_->describe() << std::endl;
+    }
+}
+
+std::vector<ProcessedObject> ImageProcessor::runPipeline(const cv::Mat& image, cv::Mat& result, const cv::Mat& gray) {
+    // 面積門檻依這一幀的解析度層級縮小，與內建流程一致
+    pipeline_->setResolutionTier(frame_tier_);
+    pipeline_->run(image, gray);
+    
+    // 管線的緩衝區會在下一幀重用，交出去的結果需要複製
+    std::vector<ProcessedObject> detected_objects = pipeline_->objects("objects");
+    if (pipeline_->has("result")) {
+        pipeline_->mat("result").copyTo(result);
+    } else {
+        // 不能與輸入共用數據：輸入可能是共享記憶體的視圖或呼叫端之後會改寫的緩衝區
+        image.copyTo(result);
     }
     
     // 顯示結果
@@ -127,13 +350,68 @@ std::vector<ProcessedObject> ImageProcessor::processImage(const cv::Mat& image,
         cv::imshow("物體檢測結果", result);
     }
     
-    std::cout << "物件檢測完成，有效物體數量: " << valid_object_count << std::endl;
+    if (verbose_) std::cout << "物件檢測完成，有效物體數量: " << detected_objects.size() << std::endl;
     
     return detected_objects;
 }
 
+void ImageProcessor::grayAndBlur(const cv::Mat& image, cv::Mat& gray, cv::Mat& blurred) {
+    // 圖像格式或模糊參數改變時才重新選擇核心
+    if (image.type() != kernel_type_ || blur_size_ != kernel_blur_size_) {
+        kernel_type_ = image.type();
+        kernel_blur_size_ = blur_size_;
+        gray_blur_kernel_ = use_specialized_kernels_ ? selectGrayBlurKernel(kernel_type_, kernel_blur_size_) : nullptr;
+        std::cout << "灰階/模糊核心: " << (gray_blur_kernel_ ? "特化" : "OpenCV 通用") << std::endl;
+    }
+    
+    if (gray_blur_kernel_) {
+        gray_blur_kernel_(image, gray, blurred, kernel_workspace_);
+        return;
+    }
+    
+    // 通用路徑：依通道數轉灰階
+    if (image.channels() == 1) {
+        gray = image;
+    } else if (image.channels() == 4) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    } else {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    }
+    
+    // 二值化的 Otsu 只接受 8 位元
+    if (gray.depth() != CV_8U) {
+        gray.convertTo(gray, CV_8U, 1.0 / 256);
+    }
+    
+    cv::GaussianBlur(gray, blurred, cv::Size(blur_size_, blur_size_), 0);
+}
+
+void ImageProcessor::extractByContours(const cv::Mat& binary, std::vector<ProcessedObject>& objects) {
+    // 尋找輪廓
+    std::vector<std::vector<cv::Point>> contours;
+    std::vector<cv::Vec4i> hierarchy;
+    cv::findContours(binary, contours, hierarchy, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    
+    if (verbose_) std::cout << "偵測到 " << contours.size() << " 個輪廓" << std::endl;
+    
+    objectsFromContours(contours, tierMinArea(), objects);
+}
+
+void ImageProcessor::extractByLabeling(const cv::Mat& binary, std::vector<ProcessedObject>& objects) {
+    // 一次平行標記同時得到邊界框、面積與重心
+    const std::vector<LabeledComponent>& components = labeler_.label(binary);
+    
+    if (verbose_) std::cout << "標記到 " << components.size() << " 個連通元件" << std::endl;
+    
+    objectsFromComponents(labeler_, components, tierMinArea(), extract_contours_, objects);
+}
+
 void ImageProcessor::startProcessingLoop() {
     if (running_) return;
+    if (!shm_manager_) {
+        std::cerr << "未連接共享記憶體，無法啟動處理循環" << std::endl;
+        return;
+    }
     
     running_ = true;
     processing_thread_ = std::thread(&ImageProcessor::processingLoop, this);
@@ -151,31 +429,84 @@ void ImageProcessor::processingLoop() {
         try {
             // 使用非阻塞方式等待，以便可以檢查running_標誌
             if (shm_manager_->waitForNewImage(100)) {
-                // 從共享記憶體讀取圖像
-                cv::Mat image = shm_manager_->readImage();
-                if (!image.empty()) {
-                    std::cout << "處理循環中接收到新圖像" << std::endl;
-                    
-                    // 處理圖像
-                    cv::Mat result;
-                    std::vector<ProcessedObject> objects = processImage(image, result);
-                    
-                    // 如果有回調，執行回調
-                    if (result_callback_) {
-                        result_callback_(result, objects);
-                    }
-                    
-                    // 通知處理完成
-                    shm_manager_->notifyProcessingDone();
-                    
-                    // 顯示結果（非阻塞）
-                    if (show_windows_) {
-                        cv::waitKey(1);
-                    }
-                }
+                handleReadyFrame();
+            } else if (shm_manager_->reattachIfStale()) {
+                // 生產者已重啟，已切換到新的共享記憶體
+                std::cout << "已重新連接到重啟後的生產者" << std::endl;
             }
         } catch (const std::exception& ex) {
             std::cerr << "處理循環中出錯: " << ex.what() << std::endl;
         }
     }
 }
+
+void ImageProcessor::handleReadyFrame() {
+    // 從共享記憶體讀取圖像（以及生產者預先算好的灰階圖）
+    cv::Mat gray;
+    cv::Mat image = shm_manager_->readImage(&gray);
+    if (image.empty()) {
+        return;
+    }
+    
+    if (verbose_) std::cout << "處理循環中接收到新圖像" << std::endl;
+    
+    // 處理圖像
+    cv::Mat result;
+    std::vector<ProcessedObject> objects = processImage(image, result, gray, shm_manager_->frameInfo().content_hash,
+                                                              shm_manager_->frameResolutionTier());
+    
+    // 如果有回調，執行回調
+    dispatchResult(result, objects, shm_manager_->frameInfo());
+    
+    // 通知處理完成
+    shm_manager_->notifyProcessingDone();
+    
+    // 顯示結果（非阻塞）
+    if (show_windows_) {
+        cv::waitKey(1);
+    }
+}
+
+void ImageProcessor::processSlotQueue(FrameSlotQueue& queue, const std::atomic<bool>& keep_running) {
+    cv::Mat image;
+    while (keep_running) {
+        try {
+            // 以逾時等待，以便檢查 keep_running
+            FrameInfo frame;
+            if (!queue.pop(image, &frame, 100)) {
+                continue;
+            }
+            
+            if (verbose_) std::cout << "從佇列取出來源 #" << frame.source_id << " 的第 " << frame.sequence << " 幀" << std::endl;
+            
+            cv::Mat result;
+            std::vector<ProcessedObject> objects = processImage(image, result, cv::Mat(), frame.content_hash);
+            dispatchResult(result, objects, frame);
+            
+            if (show_windows_) {
+                cv::waitKey(1);
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << "處理佇列時出錯: " << ex.what() << std::endl;
+        }
+    }
+}
+
+ReactorTask ImageProcessor::processingTask(FrameReactor& reactor, const std::atomic<bool>& keep_running) {
+    if (!shm_manager_) {
+        std::cerr << "未連接共享記憶體" << std::endl;
+        co_return;
+    }
+    while (keep_running) {
+        try {
+            // 等待期間不佔用執行緒，由反應器在有新圖像時恢復
+            if (co_await shm_manager_->nextFrame(reactor, 100)) {
+                handleReadyFrame();
+            } else if (shm_manager_->reattachIfStale()) {
+                std::cout << "已重新連接到重啟後的生產者" << std::endl;
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << "協程處理中出錯: " << ex.what() << std::endl;
+        }
+    }
+}
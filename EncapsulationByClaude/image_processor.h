@@ -2,36 +2,104 @@
 #pragma once
 
 #include "shared_memory_manager.h"
+#include "frame_kernels.h"
+#include "callback_dispatcher.h"
+#include "object_labeling.h"
+#include "processed_object.h"
+#include "tiled_filter.h"
+#include "detection_pipeline.h"
+#include "frame_slot_queue.h"
+#include "result_cache.h"
 #include <opencv2/opencv.hpp>
+#include <cmath>
 #include <string>
 #include <vector>
 #include <functional>
-
-// 定義處理結果的結構
-struct ProcessedObject {
-    int id;
-    cv::Rect boundingBox;
-    double area;
-    std::vector<cv::Point> contour;
-};
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 // 回調函數定義，用於通知處理結果
 using ProcessResultCallback = std::function<void(const cv::Mat&, const std::vector<ProcessedObject>&)>;
 
+// 帶有幀資訊的回調，沒有偵測到物體時也能取得序號與時間戳
+using FrameResultCallback =
+    std::function<void(const cv::Mat&, const std::vector<ProcessedObject>&, const FrameInfo&)>;
+
 class ImageProcessor {
 public:
-    // 建構函數
-    ImageProcessor(const std::string& shm_name);
+    // 建構函數；mode 為 WORKER 時與其他工作進程共同消費同一個共享記憶體
+    ImageProcessor(const std::string& shm_name, SharedMemoryMode mode = SharedMemoryMode::OPEN);
     
-    // 設置處理參數
-    void setMinObjectArea(double area) { min_object_area_ = area; }
-    void setBlurSize(int size) { blur_size_ = size; }
+    // 不連接共享記憶體，只用於 processSlotQueue() 或直接呼叫 processImage()
+    ImageProcessor();
+    
+    // 設置處理參數（會清除結果快取）
+    void setMinObjectArea(double area) { min_object_area_ = area; result_cache_.clear(); }
+    void setBlurSize(int size) { blur_size_ = size; result_cache_.clear(); }
     void setShowWindows(bool show) { show_windows_ = show; }
     
-    // 設置結果回調
-    void setResultCallback(ProcessResultCallback callback) { result_callback_ = callback; }
+    // 是否輸出每幀的訊息（接收、偵測結果、快取命中），同時套用到共享記憶體的寫入/通知訊息；預設關閉
+    void setVerbose(bool verbose) {
+        verbose_ = verbose;
+        if (shm_manager_) shm_manager_->setVerbose(verbose);
+    }
+    
+    // 是否使用編譯期特化的灰階/模糊核心（關閉時一律走 OpenCV 通用路徑，單幀內的條帶平行也一併停用）
+    void setUseSpecializedKernels(bool use) { use_specialized_kernels_ = use; kernel_type_ = -1; result_cache_.clear(); }
+    
+    // 單幀內的平行度：模糊與二值化切成條帶在執行緒池上執行；0 或 1 表示單執行緒
+    // 條帶路徑使用特化核心，setUseSpecializedKernels(false) 時不使用
+    void setIntraFrameThreads(size_t threads);
+    
+    // 改用可設定的偵測管線取代內建的處理順序（傳入空指針恢復內建流程）
+    // 管線須已 build()，並輸出 "objects"；有 "result" 時作為結果圖，否則結果圖為原圖的複製
+    // 生產者的灰階平面經由 DetectionPipeline::LUMA 輸入，面積門檻隨解析度層級縮小（經由 setResolutionTier）
+    // 使用管線時不查詢結果快取：管線的結果圖不一定只是框線，無法由快取的物體重繪
+    void setPipeline(std::unique_ptr<DetectionPipeline> pipeline);
+    
+    // 物體擷取方式；LABELING 的面積為像素數，與輪廓面積略有不同
+    void setObjectExtraction(ObjectExtraction mode) { object_extraction_ = mode; result_cache_.clear(); }
+    
+    // LABELING 模式下是否為每個物體產生輪廓（CONTOURS 模式一律有輪廓）
+    void setExtractContours(bool extract) { extract_contours_ = extract; result_cache_.clear(); }
+    
+    // 結果快取的項目數：內容雜湊相同的幀直接使用先前的偵測結果；0 表示停用（預設）
+    // 啟用時經由共享記憶體標頭要求生產者計算內容雜湊，不必在這裡重新計算
+    // 使用偵測管線時不使用快取（管線的結果圖無法由物體重繪）
+    void setResultCacheCapacity(size_t entries);
+    
+    // 結果快取的命中率與省下的數據量
+    ResultCacheStats resultCacheStats() const { return result_cache_.stats(); }
+    
+    // 設置結果回調；物體座標一律為原始解析度，結果圖則是生產者發佈的（可能已縮小的）尺寸
+    void setResultCallback(ProcessResultCallback callback);
+    void setResultCallback(FrameResultCallback callback) { result_callback_ = callback; }
+    
+    // 設置回調執行方式；ASYNC 模式下回調在背景佇列執行，不延遲 notifyProcessingDone
+    // 不能在非同步回調中呼叫（回傳 false）
+    bool setCallbackDispatch(CallbackDispatchMode mode, size_t queue_capacity = 16,
+                             OverflowPolicy policy = OverflowPolicy::DROP_OLDEST);
+    
+    // 回調佇列統計（SYNC 模式下為空）
+    CallbackDispatchStats callbackStats() const;
+    
+    // 端到端延遲超過此值 (毫秒) 的幀計為遲到
+    void setLateThreshold(double threshold_ms) { if (shm_manager_) shm_manager_->setLateThreshold(threshold_ms); }
+    
+    // 依幀序號與時間戳計算的漏接、重複、亂序與遲到統計
+    FrameTransportStats transportStats() const {
+        return shm_manager_ ? shm_manager_->transportStats() : FrameTransportStats();
+    }
+    
+    // 預熱：預先觸碰共享記憶體、啟動 OpenCV 與單幀平行的執行緒池、建立顯示視窗，
+    // 並以合成幀在每個解析度層級各走一次偵測（生產者發佈灰階平面時也走灰階輸入的路徑），
+    // 最後停在原始解析度，讓各階段的工作區配置到位；完成後在共享記憶體標頭中標示消費者就緒
+    // 在設置完處理參數之後、開始處理之前呼叫；合成幀不經過結果快取，也不交付給回調
+    void warmUp(const WarmUpConfig& config = WarmUpConfig());
     
-    // 啟動處理（阻塞式）
+    // 啟動處理（阻塞式）；等待期間生產者重啟時自動重新連接
     void processOnce();
     
     // 啟動處理循環（非阻塞式）
@@ -40,19 +108,85 @@ public:
     // 停止處理循環
     void stopProcessingLoop();
     
-    // 處理單張圖像
-    std::vector<ProcessedObject> processImage(const cv::Mat& image, cv::Mat& result);
+    // 從多生產者佇列取出並處理（阻塞式），直到 keep_running 變為 false
+    // 多個處理者（執行緒或進程）可以同時處理同一個佇列，每幀只會被其中一個取出
+    void processSlotQueue(FrameSlotQueue& queue, const std::atomic<bool>& keep_running);
+    
+    // 協程式處理循環：交給 FrameReactor::spawn() 後，多個處理者可共用同一個事件循環執行緒
+    // keep_running 變為 false 後，在下一次等待超時時結束
+    ReactorTask processingTask(FrameReactor& reactor, const std::atomic<bool>& keep_running);
+    
+    // 處理單張圖像；gray 為生產者預先算好的灰階圖時，跳過灰階轉換
+    // content_hash 為幀標頭中的內容雜湊，0 時在啟用快取的情況下自行計算
+    // resolution_tier：圖像已由速率控制縮小 2^tier 倍；面積門檻隨之縮小 4^tier 倍，
+    // 回傳的物體換算回原始解析度（結果圖維持縮小後的尺寸）
+    std::vector<ProcessedObject> processImage(const cv::Mat& image, cv::Mat& result, const cv::Mat& gray = cv::Mat(),
+                                              uint64_t content_hash = 0, int resolution_tier = 0);
 
 private:
     std::unique_ptr<SharedMemoryManager> shm_manager_;
-    double min_object_area_ = 500.0;
+    double min_object_area_ = 500.0;             // 原始解析度下的面積門檻
+    int frame_tier_ = 0;                         // 目前這一幀的解析度層級，擷取物體時據此縮小面積門檻
     int blur_size_ = 5;
     bool show_windows_ = true;
+    bool verbose_ = false;
     bool running_ = false;
     std::thread processing_thread_;
-    ProcessResultCallback result_callback_;
+    FrameResultCallback result_callback_;
+    std::shared_ptr<CallbackDispatcher> callback_dispatcher_;  // ASYNC 模式的回調佇列，使用端在鎖內複製後於鎖外送出
+    mutable std::mutex dispatch_mutex_;            // 保護 callback_dispatcher_：處理中也可以切換執行方式
+    
+    // 特化核心的選擇結果，依圖像類型與模糊核大小快取，每個串流只選一次
+    bool use_specialized_kernels_ = true;
+    int kernel_type_ = -1;
+    int kernel_blur_size_ = -1;
+    GrayBlurKernel gray_blur_kernel_ = nullptr;
+    cv::Mat kernel_workspace_;
+    
+    // 灰階、模糊與二值化的工作區，尺寸不變時每幀重用（預熱時依最大解析度配置）
+    cv::Mat gray_workspace_;
+    cv::Mat blurred_workspace_;
+    cv::Mat binary_workspace_;
+    
+    // 單幀平行的模糊 + 二值化（未啟用時為空）
+    std::unique_ptr<WorkStealingPool> intra_frame_pool_;
+    std::unique_ptr<TiledBlurThreshold> tiled_filter_;
+    
+    std::unique_ptr<DetectionPipeline> pipeline_;  // 可設定的偵測管線（未設置時為空）
+    
+    ObjectExtraction object_extraction_ = ObjectExtraction::CONTOURS;
+    bool extract_contours_ = false;
+    ParallelLabeler labeler_;
+    
+    ResultCache result_cache_;                     // 內容雜湊 -> 偵測結果
     
     // 內部處理循環
     void processingLoop();
+    
+    // 處理一張已就緒的圖像：讀取、處理、交付結果並通知完成
+    void handleReadyFrame();
+    
+    // 依回調執行方式交付處理結果
+    void dispatchResult(cv::Mat& result, std::vector<ProcessedObject>& objects, const FrameInfo& frame);
+    
+    // 轉灰階並模糊：優先使用特化核心，否則使用 OpenCV
+    void grayAndBlur(const cv::Mat& image, cv::Mat& gray, cv::Mat& blurred);
+    
+    // 查詢結果快取，未命中時執行偵測；物體座標為這一幀的解析度
+    std::vector<ProcessedObject> detectOrLookup(const cv::Mat& image, cv::Mat& result, const cv::Mat& gray,
+                                                uint64_t content_hash);
+    
+    // 這一幀解析度下的面積門檻
+    double tierMinArea() const { return std::ldexp(min_object_area_, -2 * frame_tier_); }
+    
+    // 執行偵測（不經過快取）
+    std::vector<ProcessedObject> detectObjects(const cv::Mat& image, cv::Mat& result, const cv::Mat& gray);
+    
+    // 以偵測管線處理一張圖像；gray 非空時經由 LUMA 輸入交給管線
+    std::vector<ProcessedObject> runPipeline(const cv::Mat& image, cv::Mat& result, const cv::Mat& gray);
+    
+    // 從二值圖擷取面積足夠的物體
+    void extractByContours(const cv::Mat& binary, std::vector<ProcessedObject>& objects);
+    void extractByLabeling(const cv::Mat& binary, std::vector<ProcessedObject>& objects);
 };
 
@@ -1,9 +1,11 @@
 // image_reader.cpp
 #include "image_reader.h"
+#include <algorithm>
 #include <iostream>
 #include <thread>
+#include <chrono>
 
-ImageReader::ImageReader(const std::string& shm_name, size_t max_image_size) {
+ImageReader::ImageReader(const std::string& shm_name, size_t max_image_size) : max_image_size_(max_image_size) {
     try {
         // 創建共享記憶體
         shm_manager_ = std::make_unique<SharedMemoryManager>(
@@ -19,6 +21,7 @@ ImageReader::ImageReader(const std::string& shm_name, size_t max_image_size) {
 
 ImageReader::~ImageReader() {
     stopCamera();
+    stopRecording();
 }
 
 bool ImageReader::readImageFile(const std::string& image_path) {
@@ -33,20 +36,20 @@ bool ImageReader::readImageFile(const std::string& image_path) {
         std::cout << "成功讀取圖像: " << image_path << std::endl;
         std::cout << "圖像尺寸: " << frame.cols << "x" << frame.rows << std::endl;
         
-        // 保存最後讀取的圖像
-        last_image_ = frame.clone();
+        const int64_t timestamp_ns = captureTimestampNow();
         
-        // 如果有回調，執行回調
-        if (image_ready_callback_) {
-            image_ready_callback_(last_image_);
-        }
+        // 保存最後讀取的圖像並執行回調
+        publishLastImage(frame);
         
         // 寫入圖像到共享記憶體
-        if (!shm_manager_->writeImage(frame)) {
+        if (!shm_manager_->writeImage(frame, timestamp_ns)) {
             std::cerr << "寫入圖像到共享記憶體失敗" << std::endl;
             return false;
         }
         
+        // 錄製當前幀
+        recordCurrentFrame(timestamp_ns);
+        
         // 通知處理進程
         shm_manager_->notifyNewImage();
         
@@ -79,6 +82,32 @@ bool ImageReader::waitForProcessing(int timeout_ms) {
     return shm_manager_->waitForProcessingDone(timeout_ms);
 }
 
+void ImageReader::warmUp(const WarmUpConfig& config) {
+    auto start = std::chrono::steady_clock::now();
+    
+    // 共享記憶體的分頁
+    shm_manager_->prefault();
+    
+    // 最後圖像的槽位與擷取緩衝區
+    frame_pool_.reserve(config.max_size.height, config.max_size.width, config.type);
+    
+    // OpenCV 的執行緒池與縮小解析度的路徑
+    warmOpenCvThreads();
+    cv::Mat sample = makeWarmUpFrame(config.max_size, config.type);
+    if (rate_controller_) {
+        cv::Mat scaled;
+        RateController::applyTier(sample, scaled, 1);
+    }
+    
+    // 內容雜湊、編碼與灰階平面
+    shm_manager_->warmUpWriter(sample);
+    
+    shm_manager_->setReady(true);
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "生產者預熱完成 (" << config.max_size.width << "x" << config.max_size.height
+              << ", " << elapsed_ms << " ms)" << std::endl;
+}
+
 void ImageReader::cameraLoop(int camera_id, bool continuous) {
     try {
         // 打開攝像頭
@@ -91,7 +120,10 @@ void ImageReader::cameraLoop(int camera_id, bool continuous) {
         
         std::cout << "成功打開攝像頭" << std::endl;
         
+        // 擷取緩衝區也使用池配置器，解析度不變時不會重新配置
         cv::Mat frame;
+        frame.allocator = frame_pool_.allocator();
+        cv::Mat scaled;   // 速率控制降低解析度時的縮小結果
         while (camera_running_) {
             // 讀取一幀
             cap >> frame;
@@ -99,28 +131,49 @@ void ImageReader::cameraLoop(int camera_id, bool continuous) {
                 std::cerr << "讀取攝像頭幀失敗" << std::endl;
                 break;
             }
+            const int64_t timestamp_ns = captureTimestampNow();
             
-            // 保存最後讀取的圖像
-            last_image_ = frame.clone();
-            
-            // 如果有回調，執行回調
-            if (image_ready_callback_) {
-                image_ready_callback_(last_image_);
+            // 速率控制：處理者忙碌或未到發佈間隔時略過此幀，不阻塞擷取
+            const cv::Mat* output = &frame;
+            if (continuous && rate_controller_) {
+                RateDecision decision = rate_controller_->onFrame(shm_manager_->consumerFeedback());
+                if (!decision.publish) {
+                    continue;
+                }
+                RateController::applyTier(frame, scaled, decision.resolution_tier);
+                shm_manager_->setResolutionTier(decision.resolution_tier);
+                output = &scaled;
             }
             
+            // 保存最後讀取的圖像並執行回調
+            publishLastImage(frame);
+            
             // 寫入圖像到共享記憶體
-            if (!shm_manager_->writeImage(frame)) {
+            if (!shm_manager_->writeImage(*output, timestamp_ns)) {
                 std::cerr << "寫入攝像頭幀到共享記憶體失敗" << std::endl;
                 continue;
             }
             
+            // 錄製當前幀
+            recordCurrentFrame(timestamp_ns);
+            
             // 通知處理進程
             shm_manager_->notifyNewImage();
             
+            if (continuous && rate_controller_) {
+                // 節奏由速率控制決定，不等待也不延遲
+                continue;
+            }
+            
             // 等待處理完成，如果是連續模式
             if (continuous) {
                 if (!shm_manager_->waitForProcessingDone(1000)) {
-                    std::cerr << "等待處理完成超時" << std::endl;
+                    // 處理進程崩潰時不需重啟生產者，新的處理進程連接後會接手
+                    if (!shm_manager_->isConsumerAlive()) {
+                        std::cerr << "處理進程無回應，等待新的處理進程連接" << std::endl;
+                    } else {
+                        std::cerr << "等待處理完成超時" << std::endl;
+                    }
                 }
             } else {
                 // 非連續模式只處理一幀
@@ -136,9 +189,245 @@ void ImageReader::cameraLoop(int camera_id, bool continuous) {
         cap.release();
         std::cout << "攝像頭已關閉" << std::endl;
         
+        if (rate_controller_) {
+            RateControlStats stats = rate_controller_->stats();
+            std::cout << "速率控制: 發佈 " << stats.published << " 幀，略過 " << stats.skipped
+                      << " 幀，解析度層級 " << stats.resolution_tier << std::endl;
+        }
+        
     } catch (const std::exception& ex) {
         std::cerr << "攝像頭捕獲時出錯: " << ex.what() << std::endl;
     }
     
     camera_running_ = false;
 }
+
+void ImageReader::enableRateControl(const RateControlConfig& config) {
+    rate_controller_ = std::make_unique<RateController>(config);
+}
+
+RateControlStats ImageReader::rateControlStats() const {
+    return rate_controller_ ? rate_controller_->stats() : RateControlStats();
+}
+
+cv::Mat ImageReader::getLastProcessedImage() const {
+    PooledFrame last = frame_pool_.acquirePublished();
+    return last ? last.mat().clone() : cv::Mat();
+}
+
+void ImageReader::publishLastImage(const cv::Mat& frame) {
+    int slot = frame_pool_.acquireSlot();
+    if (slot < 0) {
+        // 所有緩衝區都被讀取者或排隊中的回調持有，只執行回調
+        std::cerr << "緩衝池已滿，略過保存最後圖像" << std::endl;
+        if (image_ready_callback_) {
+            dispatchImageReady(std::make_shared<const cv::Mat>(frame.clone()));
+        }
+        return;
+    }
+    
+    // 尺寸相同時 copyTo 直接重用槽位的緩衝區
+    frame.copyTo(frame_pool_.slotMat(slot));
+    PooledFrame published = frame_pool_.publish(slot);
+    
+    if (!image_ready_callback_) {
+        return;
+    }
+    
+    // 回調（或它保留的 shared_ptr）釋放之前保持該槽位不被覆寫
+    auto holder = std::make_shared<PooledFrame>(std::move(published));
+    dispatchImageReady(std::shared_ptr<const cv::Mat>(holder, &holder->mat()));
+}
+
+void ImageReader::setImageReadyCallback(ImageReadyCallback callback) {
+    if (!callback) {
+        image_ready_callback_ = nullptr;
+        return;
+    }
+    // 這個介面收到的 cv::Mat 可能被保留，交給它獨立的複製
+    image_ready_callback_ = [callback](std::shared_ptr<const cv::Mat> image) {
+        callback(image->clone());
+    };
+}
+
+bool ImageReader::setCallbackDispatch(CallbackDispatchMode mode, size_t queue_capacity, OverflowPolicy policy) {
+    std::shared_ptr<CallbackDispatcher> dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        dispatcher = callback_dispatcher_;
+    }
+    if (dispatcher && dispatcher->onWorkerThread()) {
+        // 在非同步回調中切換會讓背景執行緒解構自己的派送器
+        std::cerr << "不能在非同步回調中切換回調執行方式" << std::endl;
+        return false;
+    }
+    
+    dispatcher.reset();
+    if (mode == CallbackDispatchMode::ASYNC) {
+        // 排隊中與執行中的回調各持有一個槽位，緩衝池不足時每幀都會退回複製且無法保存最後圖像
+        // 槽位數同時受位元組預算限制（以最大圖像計），高解析度時不會佔住大量記憶體
+        const size_t wanted = queue_capacity + 1 + RESERVED_FRAME_SLOTS;
+        const size_t byte_limit = std::max<size_t>(SYNC_FRAME_SLOTS, FRAME_POOL_BYTE_BUDGET / std::max<size_t>(1, max_image_size_));
+        const size_t slots = frame_pool_.setSlotCount(std::min(wanted, byte_limit));
+        if (slots < wanted) {
+            queue_capacity = std::max<size_t>(1, slots - 1 - RESERVED_FRAME_SLOTS);
+            std::cerr << "回調佇列容量超過緩衝池上限 (" << slots << " 個槽位)，縮小為 " << queue_capacity << std::endl;
+        }
+        dispatcher = std::make_shared<CallbackDispatcher>(queue_capacity, policy);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        callback_dispatcher_.swap(dispatcher);
+    }
+    
+    // 舊的佇列在鎖外解構，先執行完剩餘的回調，再縮小緩衝池
+    // 擷取執行緒仍持有時由它在送出後解構，仍在使用的槽位由持有者釋放
+    dispatcher.reset();
+    if (mode != CallbackDispatchMode::ASYNC) {
+        frame_pool_.setSlotCount(SYNC_FRAME_SLOTS);
+    }
+    return true;
+}
+
+CallbackDispatchStats ImageReader::callbackStats() const {
+    std::shared_ptr<CallbackDispatcher> dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        dispatcher = callback_dispatcher_;
+    }
+    return dispatcher ? dispatcher->stats() : CallbackDispatchStats();
+}
+
+void ImageReader::dispatchImageReady(std::shared_ptr<const cv::Mat> image) {
+    if (!image_ready_callback_) {
+        return;
+    }
+    
+    // 只在鎖內取得派送器；BLOCK 策略下 post() 可能等待，不能持有 dispatch_mutex_
+    std::shared_ptr<CallbackDispatcher> dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(dispatch_mutex_);
+        dispatcher = callback_dispatcher_;
+    }
+    if (dispatcher) {
+        SharedImageReadyCallback callback = image_ready_callback_;
+        dispatcher->post([callback, image] { callback(image); });
+        return;
+    }
+    
+    // 同步回調在鎖外執行，回調中也可以切換執行方式
+    image_ready_callback_(std::move(image));
+}
+
+bool ImageReader::startReplay(const std::string& capture_path, ReplayMode mode, double fps, bool loop) {
+    if (camera_running_) {
+        std::cerr << "攝像頭或回放已經在運行中" << std::endl;
+        return false;
+    }
+    
+    if (mode == ReplayMode::FIXED_RATE && fps <= 0) {
+        std::cerr << "固定幀率回放需要正的幀率" << std::endl;
+        return false;
+    }
+    
+    std::shared_ptr<FrameReplaySource> source;
+    try {
+        source = std::make_shared<FrameReplaySource>(capture_path);
+    } catch (const std::exception& ex) {
+        std::cerr << "無法開始回放: " << ex.what() << std::endl;
+        return false;
+    }
+    
+    if (source->frameCount() == 0) {
+        std::cerr << "錄製檔案沒有任何幀: " << capture_path << std::endl;
+        return false;
+    }
+    
+    camera_running_ = true;
+    camera_thread_ = std::thread(&ImageReader::replayLoop, this, source, mode, fps, loop);
+    return true;
+}
+
+bool ImageReader::startRecording(const std::string& capture_path, size_t max_frames) {
+    std::lock_guard<std::mutex> lock(recorder_mutex_);
+    if (recorder_) {
+        std::cerr << "已經在錄製中" << std::endl;
+        return false;
+    }
+    
+    try {
+        recorder_ = std::make_unique<FrameRecorder>(capture_path, max_frames);
+    } catch (const std::exception& ex) {
+        std::cerr << "無法開始錄製: " << ex.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ImageReader::stopRecording() {
+    std::lock_guard<std::mutex> lock(recorder_mutex_);
+    if (recorder_) {
+        recorder_->close();
+        recorder_.reset();
+    }
+}
+
+void ImageReader::recordCurrentFrame(int64_t timestamp_ns) {
+    std::lock_guard<std::mutex> lock(recorder_mutex_);
+    if (recorder_ && !recorder_->appendFromSharedMemory(*shm_manager_, timestamp_ns)) {
+        std::cerr << "錄製幀失敗" << std::endl;
+    }
+}
+
+void ImageReader::replayLoop(std::shared_ptr<FrameReplaySource> source, ReplayMode mode, double fps, bool loop) {
+    try {
+        std::cout << "開始回放 " << source->frameCount() << " 幀" << std::endl;
+        
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(fps > 0 ? 1.0 / fps : 0.0));
+        
+        do {
+            const auto start = std::chrono::steady_clock::now();
+            const int64_t first_timestamp = source->timestamp(0);
+            
+            for (size_t i = 0; i < source->frameCount() && camera_running_; i++) {
+                // 依照回放模式決定發佈時間
+                if (mode == ReplayMode::ORIGINAL_TIMING) {
+                    std::this_thread::sleep_until(start + std::chrono::nanoseconds(source->timestamp(i) - first_timestamp));
+                } else if (mode == ReplayMode::FIXED_RATE) {
+                    std::this_thread::sleep_until(start + period * static_cast<int64_t>(i));
+                }
+                
+                // 幀數據直接來自映射檔案，不經額外複製
+                cv::Mat frame = source->frame(i);
+                
+                if (image_ready_callback_) {
+                    // 回調持有錄製檔案的映射，回放結束後幀數據仍然有效
+                    auto holder = std::make_shared<std::pair<std::shared_ptr<FrameReplaySource>, cv::Mat>>(source, frame);
+                    dispatchImageReady(std::shared_ptr<const cv::Mat>(holder, &holder->second));
+                }
+                
+                // 錄製時的時間戳屬於過去的時鐘，擷取時間以回放發佈的時間為準
+                if (!shm_manager_->writeImage(frame)) {
+                    std::cerr << "寫入回放幀到共享記憶體失敗" << std::endl;
+                    continue;
+                }
+                
+                shm_manager_->notifyNewImage();
+                
+                // 只有逐幀同步的模式等待處理者；其他模式像真正的攝像頭一樣不受處理速度限制
+                if (mode == ReplayMode::LOCKSTEP && !shm_manager_->waitForProcessingDone(1000)) {
+                    std::cerr << "等待處理完成超時" << std::endl;
+                }
+            }
+        } while (loop && camera_running_);
+        
+        std::cout << "回放結束" << std::endl;
+        
+    } catch (const std::exception& ex) {
+        std::cerr << "回放時出錯: " << ex.what() << std::endl;
+    }
+    
+    camera_running_ = false;
+}
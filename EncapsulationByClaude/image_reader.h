@@ -2,13 +2,25 @@
 #pragma once
 
 #include "shared_memory_manager.h"
+#include "frame_capture.h"
+#include "frame_pool.h"
+#include "callback_dispatcher.h"
+#include "rate_controller.h"
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-// 定義結果回調函數類型
+// 定義結果回調函數類型；收到的是獨立的複製，可以任意保留
 using ImageReadyCallback = std::function<void(const cv::Mat&)>;
 
+// 零複製的回調：圖像直接來自緩衝池（或回放檔案的映射），持有 shared_ptr 期間該緩衝區不會被覆寫
+// 需要保留圖像時保留 shared_ptr 本身，只複製 cv::Mat 標頭不會延長緩衝區的壽命；不可在 ImageReader 解構後繼續持有
+using SharedImageReadyCallback = std::function<void(std::shared_ptr<const cv::Mat>)>;
+
 class ImageReader {
 public:
     // 建構函數
@@ -26,23 +38,101 @@ public:
     // 停止攝像頭
     void stopCamera();
     
+    // 回放錄製檔案並送到共享記憶體 (fps 僅用於 FIXED_RATE)
+    bool startReplay(const std::string& capture_path, ReplayMode mode = ReplayMode::ORIGINAL_TIMING,
+                     double fps = 30.0, bool loop = false);
+    
+    // 停止回放
+    void stopReplay() { stopCamera(); }
+    
+    // 開始錄製：每幀寫入共享記憶體後，同時追加到錄製檔案
+    bool startRecording(const std::string& capture_path, size_t max_frames = 10000);
+    
+    // 停止錄製
+    void stopRecording();
+    
     // 等待處理完成
     bool waitForProcessing(int timeout_ms = -1);
     
+    // 預熱：預先觸碰共享記憶體、依最大解析度配置緩衝池、啟動 OpenCV 執行緒池，
+    // 並以合成幀走一次寫入路徑（不發佈），完成後在共享記憶體標頭中標示生產者就緒
+    // 需在發佈第一幀之前呼叫
+    void warmUp(const WarmUpConfig& config = WarmUpConfig());
+    
+    // 等待處理者完成預熱（標頭中的消費者就緒旗標），逾時回傳 false
+    bool waitForProcessorReady(int timeout_ms = -1) { return shm_manager_->waitForConsumerReady(timeout_ms); }
+    
+    // 連續模式改用自適應速率控制：依處理者回報的處理時間決定發佈、略過或降低解析度，
+    // 取代固定的 10 ms 延遲與 1000 ms 等待（需在 startCamera() 前設置）
+    void enableRateControl(const RateControlConfig& config = RateControlConfig());
+    
+    // 速率控制統計（未啟用時為空）
+    RateControlStats rateControlStats() const;
+    
     // 設置回調函數，當讀取到新圖像時呼叫
-    void setImageReadyCallback(ImageReadyCallback callback) { image_ready_callback_ = callback; }
+    void setImageReadyCallback(ImageReadyCallback callback);
+    void setImageReadyCallback(SharedImageReadyCallback callback) { image_ready_callback_ = callback; }
+    
+    // 設置回調執行方式；ASYNC 模式下回調在背景佇列執行，不延遲寫入共享記憶體
+    // 每個排隊中的回調各持有緩衝池的一個槽位，緩衝池依佇列容量擴大；超過緩衝池上限時縮小佇列容量
+    // 可在擷取進行中呼叫，舊佇列中剩餘的回調會先執行完；不能在非同步回調中呼叫（回傳 false）
+    bool setCallbackDispatch(CallbackDispatchMode mode, size_t queue_capacity = 16,
+                             OverflowPolicy policy = OverflowPolicy::DROP_OLDEST);
+    
+    // 寫入時一併計算灰階平面，讓每個處理者省去各自的灰階轉換
+    void setPublishLuma(bool enable) { shm_manager_->setPublishLuma(enable); }
     
-    // 獲取最後一次處理的圖像
-    cv::Mat getLastProcessedImage() const { return last_image_; }
+    // 寫入幀標頭的來源編號，多個來源共用處理結果時用於區分
+    void setSourceId(uint32_t source_id) { shm_manager_->setSourceId(source_id); }
+    
+    // 是否輸出每幀的寫入與通知訊息；預設關閉
+    void setVerbose(bool verbose) { shm_manager_->setVerbose(verbose); }
+    
+    // 回調佇列統計（SYNC 模式下為空）
+    CallbackDispatchStats callbackStats() const;
+    
+    // 獲取最後一次處理的圖像（複製一份，可跨執行緒安全使用）
+    cv::Mat getLastProcessedImage() const;
+    
+    // 取得最後一次讀取的圖像參考，不複製；持有期間該緩衝區不會被覆寫
+    PooledFrame acquireLastImage() const { return frame_pool_.acquirePublished(); }
+    
+    // 緩衝池配置器（用於觀察配置次數）
+    const PooledMatAllocator& frameAllocator() const { return frame_pool_.pooledAllocator(); }
 
 private:
     std::unique_ptr<SharedMemoryManager> shm_manager_;
-    cv::Mat last_image_;
-    bool camera_running_ = false;
-    std::thread camera_thread_;
-    ImageReadyCallback image_ready_callback_ = nullptr;
+    FramePool frame_pool_;                      // 最後讀取圖像的緩衝池，取代每幀 clone()
+    std::atomic<bool> camera_running_{false};  // 擷取執行緒讀取，stopCamera() 從其他執行緒寫入
+    size_t max_image_size_;                     // 共享記憶體可存放的最大圖像，用於估計緩衝池的記憶體用量
+    std::thread camera_thread_;                 // 攝像頭或回放執行緒
+    SharedImageReadyCallback image_ready_callback_ = nullptr;
+    std::unique_ptr<FrameRecorder> recorder_;   // 錄製器（未錄製時為空）
+    std::mutex recorder_mutex_;                 // 保護 recorder_：擷取執行緒寫入時，呼叫端可能同時停止錄製
+    std::unique_ptr<RateController> rate_controller_;  // 速率控制（未啟用時為空）
+    // ASYNC 模式的回調佇列；回調可能持有緩衝池的幀，必須在 frame_pool_ 之前解構
+    std::shared_ptr<CallbackDispatcher> callback_dispatcher_;  // 使用端在鎖內複製後於鎖外送出
+    mutable std::mutex dispatch_mutex_;         // 保護 callback_dispatcher_：擷取執行緒使用時呼叫端可能切換執行方式
+    
+    // 緩衝池在同步模式下的槽位數，以及非同步模式下佇列以外另需保留的槽位（寫入中、已發佈、讀取者）
+    static constexpr size_t SYNC_FRAME_SLOTS = 4;
+    static constexpr size_t RESERVED_FRAME_SLOTS = 4;
+    // 非同步模式下緩衝池最多佔用的記憶體
+    static constexpr size_t FRAME_POOL_BYTE_BUDGET = size_t(512) << 20;
     
     // 攝像頭捕獲循環
     void cameraLoop(int camera_id, bool continuous);
+    
+    // 回放循環
+    void replayLoop(std::shared_ptr<FrameReplaySource> source, ReplayMode mode, double fps, bool loop);
+    
+    // 錄製共享記憶體中的當前幀
+    void recordCurrentFrame(int64_t timestamp_ns);
+    
+    // 將幀複製到緩衝池並發佈為最後讀取的圖像，再執行回調
+    void publishLastImage(const cv::Mat& frame);
+    
+    // 以共享的唯讀參考交付圖像給回調
+    void dispatchImageReady(std::shared_ptr<const cv::Mat> image);
 };
 
@@ -0,0 +1,346 @@
+// memfd_segment.cpp
+#include "memfd_segment.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// hugetlbfs 的預設大分頁大小
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// 隨檔案描述符一起傳送的識別碼
+constexpr uint32_t BROKER_MAGIC = 0x44464d49;   // "IMFD"
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// 路徑以 / 或 . 開頭時為 socket 檔案，否則使用抽象命名空間（socket 關閉即消失，不留檔案）
+bool isFilesystemSocket(const std::string& socket_name) {
+    return !socket_name.empty() && (socket_name[0] == '/' || socket_name[0] == '.');
+}
+
+socklen_t socketAddress(const std::string& socket_name, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (socket_name.empty() || socket_name.size() >= sizeof(addr.sun_path) - 1) {
+        throw std::invalid_argument("socket 名稱長度不符: " + socket_name);
+    }
+
+    if (isFilesystemSocket(socket_name)) {
+        std::memcpy(addr.sun_path, socket_name.c_str(), socket_name.size() + 1);
+        return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + socket_name.size() + 1);
+    }
+    // 抽象命名空間：第一個位元組為 0
+    std::memcpy(addr.sun_path + 1, socket_name.data(), socket_name.size());
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + socket_name.size());
+}
+
+// 連接代理的 socket，失敗時回傳 -1 並保留 errno
+int connectSocket(const std::string& socket_name, int timeout_ms) {
+    sockaddr_un addr;
+    socklen_t len = socketAddress(socket_name, addr);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (timeout_ms > 0) {
+        timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+bool isMemfdName(const std::string& name) {
+    return name.rfind(MEMFD_NAME_PREFIX, 0) == 0;
+}
+
+std::string memfdSocketName(const std::string& name) {
+    return isMemfdName(name) ? name.substr(std::strlen(MEMFD_NAME_PREFIX)) : name;
+}
+
+MemfdSegment::~MemfdSegment() {
+    if (address_) {
+        munmap(address_, size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+MemfdSegment& MemfdSegment::operator=(MemfdSegment&& other) noexcept {
+    MemfdSegment moved(std::move(other));
+    swap(moved);
+    return *this;
+}
+
+void MemfdSegment::swap(MemfdSegment& other) noexcept {
+    std::swap(fd_, other.fd_);
+    std::swap(address_, other.address_);
+    std::swap(size_, other.size_);
+    std::swap(huge_pages_, other.huge_pages_);
+}
+
+MemfdSegment MemfdSegment::create(const std::string& debug_name, size_t size, const MemfdOptions& options) {
+    MemfdSegment segment;
+    const unsigned int flags = MFD_CLOEXEC | (options.seal ? MFD_ALLOW_SEALING : 0);
+
+    // 先嘗試 hugetlbfs；系統沒有預留大分頁時 ftruncate 或 mmap 會失敗，退回一般分頁
+    if (options.huge_pages) {
+        segment.fd_ = memfd_create(debug_name.c_str(), flags | MFD_HUGETLB);
+        if (segment.fd_ >= 0) {
+            segment.size_ = alignUp(size, HUGE_PAGE_SIZE);
+            segment.huge_pages_ = true;
+            try {
+                if (ftruncate(segment.fd_, static_cast<off_t>(segment.size_)) != 0) {
+                    throw std::system_error(errno, std::generic_category(), "ftruncate");
+                }
+                segment.map();
+            } catch (const std::exception& ex) {
+                std::cerr << "無法使用 hugetlbfs 大分頁 (" << ex.what() << ")，改用透明大分頁" << std::endl;
+                segment = MemfdSegment();
+            }
+        }
+    }
+
+    if (segment.fd_ < 0) {
+        segment.fd_ = memfd_create(debug_name.c_str(), flags);
+        if (segment.fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "memfd_create 失敗");
+        }
+        segment.size_ = size;
+        if (ftruncate(segment.fd_, static_cast<off_t>(size)) != 0) {
+            throw std::system_error(errno, std::generic_category(), "設置 memfd 大小失敗");
+        }
+        segment.map();
+        if (options.huge_pages && madvise(segment.address_, segment.size_, MADV_HUGEPAGE) != 0) {
+            std::cerr << "無法啟用透明大分頁: " << strerror(errno) << std::endl;
+        }
+    }
+
+    // 封存大小；不封存寫入，映射仍可讀寫
+    if (options.seal && fcntl(segment.fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        std::cerr << "無法封存 memfd: " << strerror(errno) << std::endl;
+    }
+    return segment;
+}
+
+MemfdSegment MemfdSegment::adopt(int fd) {
+    MemfdSegment segment;
+    segment.fd_ = fd;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "無法取得 memfd 大小");
+    }
+    segment.size_ = static_cast<size_t>(st.st_size);
+    if (segment.size_ == 0) {
+        throw std::runtime_error("收到的 memfd 大小為 0");
+    }
+    segment.map();
+    return segment;
+}
+
+void MemfdSegment::map() {
+    void* address = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (address == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "映射 memfd 失敗");
+    }
+    address_ = address;
+}
+
+bool MemfdSegment::sealed() const {
+    int seals = fd_ >= 0 ? fcntl(fd_, F_GET_SEALS) : -1;
+    return seals >= 0 && (seals & F_SEAL_SHRINK);
+}
+
+SegmentBroker::SegmentBroker(const std::string& socket_name, int fd) : socket_name_(socket_name), fd_(fd) {
+    sockaddr_un addr;
+    socklen_t len = socketAddress(socket_name_, addr);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "無法建立 socket");
+    }
+
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+        int err = errno;
+        // socket 檔案已存在：仍能連上表示另一個生產者在服務，否則是崩潰留下的檔案
+        bool stale = err == EADDRINUSE && isFilesystemSocket(socket_name_);
+        if (stale) {
+            int probe = connectSocket(socket_name_, 100);
+            if (probe >= 0) {
+                close(probe);
+                stale = false;
+            }
+        }
+        if (!stale || unlink(socket_name_.c_str()) != 0 ||
+            bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0) {
+            close(listen_fd_);
+            if (err == EADDRINUSE) {
+                throw std::runtime_error("共享記憶體代理 " + socket_name_ + " 仍由其他生產者使用中");
+            }
+            throw std::system_error(err, std::generic_category(), "無法綁定 socket " + socket_name_);
+        }
+        std::cout << "取代失效的 socket 檔案: " << socket_name_ << std::endl;
+    }
+
+    if (isFilesystemSocket(socket_name_)) {
+        struct stat st;
+        if (stat(socket_name_.c_str(), &st) == 0) {
+            socket_inode_ = st.st_ino;
+        }
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0 || listen(listen_fd_, 16) != 0) {
+        int err = errno;
+        if (wake_fd_ >= 0) close(wake_fd_);
+        close(listen_fd_);
+        throw std::system_error(err, std::generic_category(), "無法啟動共享記憶體代理");
+    }
+
+    thread_ = std::thread(&SegmentBroker::serveLoop, this);
+    std::cout << "共享記憶體代理已啟動: " << socket_name_ << std::endl;
+}
+
+SegmentBroker::~SegmentBroker() {
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0) {
+        std::cerr << "喚醒共享記憶體代理失敗: " << errno << std::endl;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    close(wake_fd_);
+    close(listen_fd_);
+
+    // 只移除自己綁定的 socket 檔案
+    if (socket_inode_ != 0) {
+        struct stat st;
+        if (stat(socket_name_.c_str(), &st) == 0 && st.st_ino == socket_inode_) {
+            unlink(socket_name_.c_str());
+        }
+    }
+}
+
+void SegmentBroker::serveLoop() {
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    while (true) {
+        int n = poll(fds, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "共享記憶體代理 poll 失敗: " << errno << std::endl;
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                continue;
+            }
+            serve(client);
+            close(client);
+        }
+    }
+}
+
+void SegmentBroker::serve(int client_fd) {
+    // 記錄連接者；不同 PID 命名空間的進程在此顯示為 0
+    ucred cred{};
+    socklen_t cred_len = sizeof(cred);
+    getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len);
+
+    uint32_t magic = BROKER_MAGIC;
+    iovec iov{&magic, sizeof(magic)};
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd_, sizeof(int));
+
+    if (sendmsg(client_fd, &msg, MSG_NOSIGNAL) < 0) {
+        std::cerr << "傳送 memfd 給進程 " << cred.pid << " 失敗: " << strerror(errno) << std::endl;
+        return;
+    }
+    served_++;
+    std::cout << "已將共享記憶體交給進程 " << cred.pid << " (UID " << cred.uid << ")" << std::endl;
+}
+
+int SegmentBroker::receive(const std::string& socket_name, int timeout_ms) {
+    int sock = connectSocket(socket_name, timeout_ms);
+    if (sock < 0) {
+        throw std::system_error(errno, std::generic_category(), "無法連接共享記憶體代理 " + socket_name);
+    }
+
+    uint32_t magic = 0;
+    iovec iov{&magic, sizeof(magic)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    int err = errno;
+    close(sock);
+
+    int fd = -1;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
+    if (n < 0) {
+        throw std::system_error(err, std::generic_category(), "接收 memfd 失敗");
+    }
+    if (n != sizeof(magic) || magic != BROKER_MAGIC || fd < 0 || (msg.msg_flags & MSG_CTRUNC)) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("共享記憶體代理回應不正確: " + socket_name);
+    }
+    return fd;
+}
+
+bool SegmentBroker::removeSocket(const std::string& socket_name) {
+    if (!isFilesystemSocket(socket_name)) {
+        return false;
+    }
+    return unlink(socket_name.c_str()) == 0;
+}
@@ -0,0 +1,102 @@
+// memfd_segment.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// 共享記憶體名稱以此前綴開頭時改用 memfd 後端，其餘部分為代理的 Unix socket 名稱
+// 例如 "memfd:image_processing"（抽象命名空間）或 "memfd:/run/ipc/camera0.sock"（檔案路徑，可掛載到容器中）
+constexpr const char* MEMFD_NAME_PREFIX = "memfd:";
+
+// 是否為 memfd 後端的名稱
+bool isMemfdName(const std::string& name);
+
+// 去掉前綴後的 socket 名稱
+std::string memfdSocketName(const std::string& name);
+
+// memfd 後端的選項，只在建立時使用
+struct MemfdOptions {
+    bool seal = true;           // 封存大小 (F_SEAL_SHRINK | F_SEAL_GROW)，接收端不必擔心被截斷而觸發 SIGBUS
+    bool huge_pages = false;    // 使用大分頁；hugetlbfs 沒有可用分頁時退回透明大分頁
+};
+
+// 以 memfd_create 建立的匿名共享記憶體及其映射
+// 沒有 /dev/shm 中的具名物件，不會與其他容器衝突；最後一個檔案描述符與映射關閉後自動釋放，崩潰也不會殘留
+class MemfdSegment {
+public:
+    MemfdSegment() = default;
+    ~MemfdSegment();
+
+    MemfdSegment(MemfdSegment&& other) noexcept { swap(other); }
+    MemfdSegment& operator=(MemfdSegment&& other) noexcept;
+    MemfdSegment(const MemfdSegment&) = delete;
+    MemfdSegment& operator=(const MemfdSegment&) = delete;
+
+    // 建立並映射，size 在使用大分頁時向上取整到大分頁大小
+    static MemfdSegment create(const std::string& debug_name, size_t size, const MemfdOptions& options);
+
+    // 映射收到的檔案描述符並接管其所有權
+    static MemfdSegment adopt(int fd);
+
+    void* address() const { return address_; }
+    size_t size() const { return size_; }
+    int fd() const { return fd_; }
+
+    // 大小是否已封存
+    bool sealed() const;
+
+    // 是否由 hugetlbfs 提供
+    bool hugePages() const { return huge_pages_; }
+
+    void swap(MemfdSegment& other) noexcept;
+
+private:
+    int fd_ = -1;
+    void* address_ = nullptr;
+    size_t size_ = 0;
+    bool huge_pages_ = false;
+
+    // 映射整個 memfd
+    void map();
+};
+
+// 本機的共享記憶體代理：在 Unix socket 上等待連接，以 SCM_RIGHTS 把 memfd 交給每個連接者
+// 連接者只需接收檔案描述符並映射，不需要共用 IPC 命名空間
+class SegmentBroker {
+public:
+    // 綁定 socket 並開始服務；同名的 socket 仍有代理在服務時拋出例外，已失效的 socket 檔案直接取代
+    SegmentBroker(const std::string& socket_name, int fd);
+
+    // 解構函數 - 停止服務並移除自己的 socket 檔案
+    ~SegmentBroker();
+
+    SegmentBroker(const SegmentBroker&) = delete;
+    SegmentBroker& operator=(const SegmentBroker&) = delete;
+
+    // 連接代理並接收檔案描述符（呼叫端負責關閉），沒有代理時拋出例外
+    static int receive(const std::string& socket_name, int timeout_ms);
+
+    // 移除 socket 檔案（抽象命名空間不需移除）
+    static bool removeSocket(const std::string& socket_name);
+
+    // 已交出檔案描述符的次數
+    uint64_t served() const { return served_.load(); }
+
+private:
+    std::string socket_name_;
+    int fd_;                        // 要交出的 memfd（不擁有）
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;              // 停止時喚醒服務執行緒
+    uint64_t socket_inode_ = 0;     // 綁定的 socket 檔案，只移除自己建立的檔案
+    std::atomic<uint64_t> served_{0};
+    std::thread thread_;
+
+    // 服務循環
+    void serveLoop();
+
+    // 把檔案描述符交給一個連接者
+    void serve(int client_fd);
+};
@@ -0,0 +1,211 @@
+// object_labeling.cpp
+#include "object_labeling.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// 條帶至少的列數，太薄的條帶合併成本會超過平行帶來的好處
+constexpr int MIN_STRIP_ROWS = 32;
+
+// 找出根標記，同時做路徑減半
+inline int32_t findRoot(int32_t* parent, int32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// 合併兩個等價類，較小的標記當根，因此任何標記的 parent 都不大於自己
+inline int32_t unite(int32_t* parent, int32_t a, int32_t b) {
+    int32_t ra = findRoot(parent, a);
+    int32_t rb = findRoot(parent, b);
+    if (ra < rb) {
+        parent[rb] = ra;
+        return ra;
+    }
+    parent[ra] = rb;
+    return rb;
+}
+
+} // namespace
+
+ParallelLabeler::ParallelLabeler(int strip_count) : strip_count_(strip_count) {}
+
+const std::vector<LabeledComponent>& ParallelLabeler::label(const cv::Mat& binary) {
+    CV_Assert(binary.type() == CV_8UC1);
+
+    const int rows = binary.rows;
+    const int cols = binary.cols;
+    components_.clear();
+    labels_.create(rows, cols, CV_32SC1);
+    if (rows == 0 || cols == 0) {
+        return components_;
+    }
+
+    // 8 連通下每列最多產生 ceil(cols / 2) 個新標記，依起始列分配各條帶的標記範圍
+    const int64_t labels_per_row = (cols + 1) / 2;
+    const size_t parent_size = static_cast<size_t>(rows * labels_per_row + 1);
+    if (parent_.size() < parent_size) {
+        parent_.resize(parent_size);
+    }
+
+    int strips = strip_count_ > 0 ? strip_count_ : std::max(1, cv::getNumThreads());
+    strips = std::max(1, std::min(strips, rows / MIN_STRIP_ROWS));
+    strip_label_count_.assign(strips, 0);
+    strip_stats_.resize(strips);
+
+    auto stripBegin = [rows, strips](int s) { return static_cast<int>(static_cast<int64_t>(rows) * s / strips); };
+    auto labelBase = [labels_per_row](int y) { return static_cast<int32_t>(y * labels_per_row + 1); };
+    int32_t* parent = parent_.data();
+
+    // 第一階段：各條帶獨立掃描，只看條帶內的上一列
+    cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            const int y0 = stripBegin(s);
+            const int y1 = stripBegin(s + 1);
+            const int32_t base = labelBase(y0);
+            int32_t next = base;
+
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* src = binary.ptr<uint8_t>(y);
+                int32_t* cur = labels_.ptr<int32_t>(y);
+                const int32_t* up = y > y0 ? labels_.ptr<int32_t>(y - 1) : nullptr;
+
+                for (int x = 0; x < cols; x++) {
+                    if (!src[x]) {
+                        cur[x] = 0;
+                        continue;
+                    }
+
+                    // 與左、左上、上、右上相連
+                    int32_t l = 0;
+                    auto merge = [&](int32_t n) {
+                        if (n == 0) return;
+                        l = (l == 0 || l == n) ? n : unite(parent, l, n);
+                    };
+                    if (x > 0) merge(cur[x - 1]);
+                    if (up) {
+                        if (x > 0) merge(up[x - 1]);
+                        merge(up[x]);
+                        if (x + 1 < cols) merge(up[x + 1]);
+                    }
+
+                    if (l == 0) {
+                        l = next;
+                        parent[next] = next;
+                        next++;
+                    }
+                    cur[x] = l;
+                }
+            }
+            strip_label_count_[s] = next - base;
+        }
+    }, strips);
+
+    // 第二階段：沿條帶邊界合併（邊界數很少，依序處理）
+    for (int s = 1; s < strips; s++) {
+        const int y = stripBegin(s);
+        const int32_t* cur = labels_.ptr<int32_t>(y);
+        const int32_t* up = labels_.ptr<int32_t>(y - 1);
+        for (int x = 0; x < cols; x++) {
+            if (!cur[x]) continue;
+            for (int dx = -1; dx <= 1; dx++) {
+                const int nx = x + dx;
+                if (nx >= 0 && nx < cols && up[nx]) {
+                    unite(parent, cur[x], up[nx]);
+                }
+            }
+        }
+    }
+
+    // 第三階段：壓平為連續的最終標記
+    // 任何標記的 parent 都比自己小，依遞增順序處理時 parent 已經換成最終標記
+    int32_t component_count = 0;
+    for (int s = 0; s < strips; s++) {
+        const int32_t base = labelBase(stripBegin(s));
+        const int32_t end = base + strip_label_count_[s];
+        for (int32_t i = base; i < end; i++) {
+            parent[i] = parent[i] == i ? ++component_count : parent[parent[i]];
+        }
+    }
+
+    // 第四階段：平行重新標記，並依條帶內的暫時標記累加部分統計
+    // 每個條帶的統計只有自己用到的暫時標記數那麼大，總量與元件數無關
+    const PartialStats empty_stats = {0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), -1, -1, 0, 0};
+    cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; s++) {
+            const int32_t base = labelBase(stripBegin(s));
+            std::vector<PartialStats>& stats = strip_stats_[s];
+            stats.assign(strip_label_count_[s], empty_stats);
+
+            for (int y = stripBegin(s); y < stripBegin(s + 1); y++) {
+                int32_t* cur = labels_.ptr<int32_t>(y);
+                for (int x = 0; x < cols; x++) {
+                    if (!cur[x]) continue;
+                    PartialStats& st = stats[cur[x] - base];
+                    cur[x] = parent[cur[x]];
+
+                    st.area++;
+                    st.min_x = std::min(st.min_x, x);
+                    st.max_x = std::max(st.max_x, x);
+                    st.min_y = std::min(st.min_y, y);
+                    st.max_y = std::max(st.max_y, y);
+                    st.sum_x += x;
+                    st.sum_y += y;
+                }
+            }
+        }
+    }, strips);
+
+    // 經由等價對應（parent 已是最終標記）把各條帶的暫時標記統計合併到最終元件
+    totals_.assign(component_count + 1, empty_stats);
+    for (int s = 0; s < strips; s++) {
+        const int32_t base = labelBase(stripBegin(s));
+        const std::vector<PartialStats>& stats = strip_stats_[s];
+        for (int32_t i = 0; i < strip_label_count_[s]; i++) {
+            const PartialStats& st = stats[i];
+            if (st.area == 0) continue;
+            PartialStats& total = totals_[parent[base + i]];
+            total.area += st.area;
+            total.min_x = std::min(total.min_x, st.min_x);
+            total.max_x = std::max(total.max_x, st.max_x);
+            total.min_y = std::min(total.min_y, st.min_y);
+            total.max_y = std::max(total.max_y, st.max_y);
+            total.sum_x += st.sum_x;
+            total.sum_y += st.sum_y;
+        }
+    }
+
+    components_.reserve(component_count);
+    for (int32_t l = 1; l <= component_count; l++) {
+        const PartialStats& total = totals_[l];
+
+        LabeledComponent component;
+        component.label = l;
+        component.bbox = cv::Rect(total.min_x, total.min_y, total.max_x - total.min_x + 1, total.max_y - total.min_y + 1);
+        component.area = total.area;
+        component.centroid = cv::Point2d(static_cast<double>(total.sum_x) / total.area,
+                                         static_cast<double>(total.sum_y) / total.area);
+        components_.push_back(component);
+    }
+
+    return components_;
+}
+
+std::vector<cv::Point> ParallelLabeler::contourOf(const LabeledComponent& component) const {
+    // 只在邊界框內取出該元件的遮罩
+    cv::Mat mask = labels_(component.bbox) == component.label;
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, component.bbox.tl());
+    if (contours.empty()) {
+        return {};
+    }
+
+    // 8 連通的元件只會有一個外輪廓；保險起見取點數最多的
+    auto largest = std::max_element(contours.begin(), contours.end(),
+                                    [](const auto& a, const auto& b) { return a.size() < b.size(); });
+    return std::move(*largest);
+}
@@ -0,0 +1,302 @@
+// process_supervisor.cpp
+#include "process_supervisor.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+ProcessSupervisor::ProcessSupervisor(const SupervisorConfig& config) : config_(config) {
+    if (config_.max_workers <= 0) {
+        config_.max_workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    config_.min_workers = std::clamp(config_.min_workers, 1, config_.max_workers);
+    target_workers_ = config_.min_workers;
+
+    if (config_.worker_command.empty()) {
+        throw std::invalid_argument("未指定工作進程的命令列");
+    }
+
+    stats_.target_workers = target_workers_;
+}
+
+ProcessSupervisor::~ProcessSupervisor() {
+    stopAll();
+}
+
+void ProcessSupervisor::run(const std::atomic<bool>& keep_running) {
+    std::cout << "監督程式啟動，工作進程數 " << config_.min_workers << " ~ " << config_.max_workers << std::endl;
+
+    while (keep_running) {
+        const Clock::time_point now = Clock::now();
+        reapWorkers(now);
+
+        // 共享記憶體建立後才啟動工作進程，避免工作進程連接失敗後反覆重啟
+        if (ensureMonitor()) {
+            evaluateScaling(now);
+            adjustWorkers(now);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(config_.poll_interval_ms));
+    }
+
+    stopAll();
+
+    SupervisorStats final_stats = stats();
+    std::cout << "監督程式結束: 啟動 " << final_stats.started << " 個工作進程，異常結束 " << final_stats.crashes
+              << " 次，擴充 " << final_stats.scale_ups << " 次，縮減 " << final_stats.scale_downs << " 次" << std::endl;
+}
+
+SupervisorStats ProcessSupervisor::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+bool ProcessSupervisor::ensureMonitor() {
+    if (monitor_) {
+        // 生產者重啟後切換到新的世代
+        monitor_->reattachIfStale();
+        return true;
+    }
+
+    // 生產者尚未建立共享記憶體時，每秒重試一次
+    const Clock::time_point now = Clock::now();
+    if (now - last_monitor_attempt_ < std::chrono::seconds(1)) {
+        return false;
+    }
+    last_monitor_attempt_ = now;
+
+    try {
+        monitor_ = std::make_unique<SharedMemoryManager>(config_.shm_name, SharedMemoryMode::MONITOR);
+        last_late_frames_ = monitor_->segmentMetrics().late_frames;
+        return true;
+    } catch (const std::exception&) {
+        std::cout << "等待生產者建立共享記憶體: " << config_.shm_name << std::endl;
+        return false;
+    }
+}
+
+void ProcessSupervisor::reapWorkers(Clock::time_point now) {
+    for (auto it = workers_.begin(); it != workers_.end();) {
+        int status = 0;
+        pid_t result = waitpid(it->pid, &status, WNOHANG);
+        if (result == 0) {
+            // 仍在運行；要求停止後逾時則強制終止
+            if (it->stopping && now > it->stop_deadline) {
+                std::cerr << "工作進程 " << it->pid << " 未在時限內結束，強制終止" << std::endl;
+                kill(it->pid, SIGKILL);
+            }
+            ++it;
+            continue;
+        }
+
+        if (it->stopping) {
+            std::cout << "工作進程 " << it->pid << " 已停止" << std::endl;
+        } else {
+            // 非預期的結束：記錄原因，之後由 adjustWorkers() 補上
+            if (WIFSIGNALED(status)) {
+                std::cerr << "工作進程 " << it->pid << " 因信號 " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status))
+                          << ") 結束" << std::endl;
+            } else {
+                std::cerr << "工作進程 " << it->pid << " 結束，結束碼 " << WEXITSTATUS(status) << std::endl;
+            }
+
+            // 連續在短時間內結束時加長重啟延遲，避免崩潰循環佔滿 CPU
+            if (now - it->started < std::chrono::milliseconds(config_.stable_run_ms)) {
+                consecutive_failures_++;
+            } else {
+                consecutive_failures_ = 0;
+            }
+            int backoff_ms = config_.restart_backoff_ms;
+            for (int i = 1; i < consecutive_failures_ && backoff_ms < config_.max_restart_backoff_ms; i++) {
+                backoff_ms *= 2;
+            }
+            backoff_ms = std::min(backoff_ms, config_.max_restart_backoff_ms);
+            next_spawn_ = std::max(next_spawn_, now + std::chrono::milliseconds(backoff_ms));
+
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.crashes++;
+        }
+        it = workers_.erase(it);
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.workers = activeWorkerCount();
+}
+
+void ProcessSupervisor::evaluateScaling(Clock::time_point now) {
+    const SegmentMetrics metrics = monitor_->segmentMetrics();
+    const int active = activeWorkerCount();
+
+    // 遲到幀數只增不減，比較兩次檢查之間的增量
+    const uint64_t new_late_frames = metrics.late_frames >= last_late_frames_ ? metrics.late_frames - last_late_frames_ : 0;
+    last_late_frames_ = metrics.late_frames;
+
+    // 彙總各工作進程的指標：處理時間取平均與最大值，排隊的工作數相加
+    double service_sum_ms = 0;
+    double max_service_ms = 0;
+    int measured = 0;
+    uint32_t queue_depth = 0;
+    for (const WorkerMetrics& worker : metrics.worker_metrics) {
+        if (worker.service_time_ms > 0) {
+            service_sum_ms += worker.service_time_ms;
+            max_service_ms = std::max(max_service_ms, worker.service_time_ms);
+            measured++;
+        }
+        queue_depth += worker.queue_depth;
+    }
+    const double service_time_ms = measured > 0 ? service_sum_ms / measured : 0;
+
+    // 使用率：每幀處理時間相對於所有工作進程能消化的發佈間隔
+    double utilization = 0;
+    if (metrics.publish_interval_ms > 0 && active > 0) {
+        utilization = service_time_ms / (metrics.publish_interval_ms * active);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.utilization = utilization;
+        stats_.latency_ms = metrics.latency_ms;
+    }
+
+    // 沒有生產者或工作進程尚未補齊時不調整，指標還不能反映目前的工作進程數
+    if (!metrics.producer_alive || active != target_workers_ ||
+        now - last_scale_ < std::chrono::milliseconds(config_.scale_cooldown_ms)) {
+        return;
+    }
+
+    const bool over_budget = metrics.latency_ms > config_.latency_budget_ms;
+    const bool backlog = queue_depth > config_.max_queue_depth;
+    const bool overloaded = utilization > config_.scale_up_utilization || over_budget || backlog || new_late_frames > 0;
+
+    if (overloaded && target_workers_ < config_.max_workers) {
+        target_workers_++;
+        last_scale_ = now;
+        std::cout << "增加工作進程到 " << target_workers_ << " (使用率 " << utilization * 100 << "%，延遲 "
+                  << metrics.latency_ms << " ms，最慢的工作進程 " << max_service_ms << " ms/幀，遲到 " << new_late_frames
+                  << " 幀，佇列 " << queue_depth << ")"
+                  << std::endl;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.scale_ups++;
+        stats_.target_workers = target_workers_;
+        return;
+    }
+
+    // 少一個工作進程後的預估使用率仍有餘裕時才縮減，避免來回調整
+    if (!overloaded && target_workers_ > config_.min_workers && queue_depth == 0) {
+        const double utilization_after = utilization * active / (active - 1);
+        if (utilization_after < config_.scale_down_utilization) {
+            target_workers_--;
+            last_scale_ = now;
+            std::cout << "減少工作進程到 " << target_workers_ << " (使用率 " << utilization * 100 << "%，縮減後約 "
+                      << utilization_after * 100 << "%)" << std::endl;
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.scale_downs++;
+            stats_.target_workers = target_workers_;
+        }
+    }
+}
+
+void ProcessSupervisor::adjustWorkers(Clock::time_point now) {
+    int active = activeWorkerCount();
+
+    // 不足時啟動（異常結束後須等重啟延遲過去）
+    while (active < target_workers_ && now >= next_spawn_) {
+        pid_t pid = spawnWorker();
+        if (pid < 0) {
+            next_spawn_ = now + std::chrono::milliseconds(config_.max_restart_backoff_ms);
+            break;
+        }
+        Worker worker;
+        worker.pid = pid;
+        worker.started = now;
+        workers_.push_back(worker);
+        active++;
+    }
+
+    // 過多時停止最新的工作進程
+    for (auto it = workers_.rbegin(); it != workers_.rend() && active > target_workers_; ++it) {
+        if (!it->stopping) {
+            requestStop(*it, now);
+            active--;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.workers = active;
+}
+
+pid_t ProcessSupervisor::spawnWorker() {
+    // fork() 之後子進程只能呼叫 async-signal-safe 的函數，參數與訊息先準備好
+    std::vector<char*> argv;
+    for (const std::string& arg : config_.worker_command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    const std::string exec_error = "執行工作進程失敗: " + config_.worker_command[0] + "\n";
+    const pid_t parent = getpid();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "啟動工作進程失敗: " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    if (pid == 0) {
+        // 子進程：監督程式結束時一併收到 SIGTERM，不留下孤兒工作進程
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != parent) {
+            // 監督程式在 fork() 與 prctl() 之間就已結束，不會再收到信號
+            _exit(1);
+        }
+        execvp(argv[0], argv.data());
+
+        // exec 失敗，不能回到父進程的程式碼
+        ssize_t ignored = write(STDERR_FILENO, exec_error.data(), exec_error.size());
+        (void)ignored;
+        _exit(127);
+    }
+
+    std::cout << "啟動工作進程 " << pid << std::endl;
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.started++;
+    return pid;
+}
+
+void ProcessSupervisor::requestStop(Worker& worker, Clock::time_point now) {
+    std::cout << "停止工作進程 " << worker.pid << std::endl;
+    worker.stopping = true;
+    worker.stop_deadline = now + std::chrono::milliseconds(config_.stop_timeout_ms);
+    kill(worker.pid, SIGTERM);
+}
+
+void ProcessSupervisor::stopAll() {
+    if (workers_.empty()) {
+        return;
+    }
+
+    const Clock::time_point now = Clock::now();
+    for (Worker& worker : workers_) {
+        if (!worker.stopping) {
+            requestStop(worker, now);
+        }
+    }
+
+    // 等待全部結束，逾時的由 reapWorkers() 強制終止
+    while (!workers_.empty()) {
+        reapWorkers(Clock::now());
+        if (!workers_.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+}
+
+int ProcessSupervisor::activeWorkerCount() const {
+    return static_cast<int>(std::count_if(workers_.begin(), workers_.end(),
+                                          [](const Worker& worker) { return !worker.stopping; }));
+}
@@ -0,0 +1,110 @@
+// process_supervisor.h
+#pragma once
+
+#include "shared_memory_manager.h"
+#include <sys/types.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 監督程式的參數
+struct SupervisorConfig {
+    std::string shm_name;                       // 工作進程連接的共享記憶體
+    std::vector<std::string> worker_command;    // 工作進程的命令列（第一個為執行檔路徑）
+    int min_workers = 1;                        // 最少工作進程數
+    int max_workers = 0;                        // 最多工作進程數，0 表示 CPU 核心數
+    double latency_budget_ms = 100.0;           // 端到端延遲上限，超過時增加工作進程
+    uint32_t max_queue_depth = 2;               // 消費者端排隊的工作超過此數時增加工作進程
+    double scale_up_utilization = 0.9;          // 使用率超過此值時增加工作進程
+    double scale_down_utilization = 0.6;        // 減少一個工作進程後的預估使用率仍低於此值時縮減
+    int scale_cooldown_ms = 3000;               // 兩次調整工作進程數之間的最短間隔
+    int poll_interval_ms = 200;                 // 檢查工作進程與指標的間隔
+    int restart_backoff_ms = 200;               // 工作進程異常結束後重啟的初始延遲，連續失敗時加倍
+    int max_restart_backoff_ms = 5000;          // 重啟延遲的上限
+    int stable_run_ms = 5000;                   // 運行超過此時間後結束不算連續失敗
+    int stop_timeout_ms = 2000;                 // 停止工作進程時等待的時間，逾時強制終止
+};
+
+// 監督程式的統計
+struct SupervisorStats {
+    int workers = 0;                // 運行中的工作進程數
+    int target_workers = 0;         // 目標工作進程數
+    uint64_t started = 0;           // 啟動過的工作進程數
+    uint64_t crashes = 0;           // 異常結束的次數（之後會重啟）
+    uint64_t scale_ups = 0;         // 增加工作進程的次數
+    uint64_t scale_downs = 0;       // 減少工作進程的次數
+    double utilization = 0;         // 最近一次估計的使用率（處理時間 / (發佈間隔 x 工作進程數)）
+    double latency_ms = 0;          // 最近一次讀到的端到端延遲
+};
+
+// 處理者工作進程的監督程式
+// 啟動多個以 SharedMemoryMode::WORKER 連接同一個共享記憶體的工作進程，
+// 異常結束時自動重啟，並依共享記憶體中的處理時間、發佈間隔、延遲與佇列深度增減工作進程數
+// 工作進程與監督程式分屬不同進程，OpenCV 崩潰不會影響擷取端
+class ProcessSupervisor {
+public:
+    explicit ProcessSupervisor(const SupervisorConfig& config);
+
+    // 解構函數 - 停止所有工作進程
+    ~ProcessSupervisor();
+
+    ProcessSupervisor(const ProcessSupervisor&) = delete;
+    ProcessSupervisor& operator=(const ProcessSupervisor&) = delete;
+
+    // 運行監督循環（阻塞式），keep_running 變為 false 後停止所有工作進程並返回
+    void run(const std::atomic<bool>& keep_running);
+
+    // 取得統計數據（可跨執行緒呼叫）
+    SupervisorStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Worker {
+        pid_t pid;
+        Clock::time_point started;
+        bool stopping = false;             // 已要求停止（縮減或結束時）
+        Clock::time_point stop_deadline;   // 逾時後強制終止
+    };
+
+    SupervisorConfig config_;
+    std::vector<Worker> workers_;
+    int target_workers_;
+    std::unique_ptr<SharedMemoryManager> monitor_;   // 以 MONITOR 模式讀取指標
+    Clock::time_point last_monitor_attempt_;
+    Clock::time_point last_scale_;
+    Clock::time_point next_spawn_;                   // 重啟延遲期間不啟動新的工作進程
+    int consecutive_failures_ = 0;
+    uint64_t last_late_frames_ = 0;
+
+    mutable std::mutex stats_mutex_;
+    SupervisorStats stats_;
+
+    // 連接共享記憶體以讀取指標，生產者尚未建立時回傳 false
+    bool ensureMonitor();
+
+    // 回收已結束的工作進程，異常結束時安排重啟
+    void reapWorkers(Clock::time_point now);
+
+    // 依指標調整目標工作進程數
+    void evaluateScaling(Clock::time_point now);
+
+    // 啟動或停止工作進程以符合目標數
+    void adjustWorkers(Clock::time_point now);
+
+    // 啟動一個工作進程，失敗時回傳 -1
+    pid_t spawnWorker();
+
+    // 要求工作進程結束
+    void requestStop(Worker& worker, Clock::time_point now);
+
+    // 停止所有工作進程並等待結束
+    void stopAll();
+
+    // 未要求停止的工作進程數
+    int activeWorkerCount() const;
+};
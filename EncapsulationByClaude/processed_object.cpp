@@ -0,0 +1,81 @@
+// processed_object.cpp
+#include "processed_object.h"
+#include <string>
+
+void objectsFromContours(const std::vector<std::vector<cv::Point>>& contours, double min_area,
+                         std::vector<ProcessedObject>& objects) {
+    for (size_t i = 0; i < contours.size(); i++) {
+        // 過濾掉太小的輪廓（可能是噪點）
+        double area = cv::contourArea(contours[i]);
+        if (area < min_area) continue;
+
+        // 為每個物體建立結構
+        ProcessedObject obj;
+        obj.id = static_cast<int>(objects.size());
+        obj.area = area;
+        obj.boundingBox = cv::boundingRect(contours[i]);
+        cv::Moments m = cv::moments(contours[i]);
+        obj.centroid = m.m00 != 0 ? cv::Point2d(m.m10 / m.m00, m.m01 / m.m00)
+                                  : cv::Point2d(obj.boundingBox.x + obj.boundingBox.width / 2.0,
+                                                obj.boundingBox.y + obj.boundingBox.height / 2.0);
+        obj.contour = contours[i];
+
+        objects.push_back(std::move(obj));
+    }
+}
+
+void objectsFromComponents(const ParallelLabeler& labeler, const std::vector<LabeledComponent>& components,
+                           double min_area, bool with_contours, std::vector<ProcessedObject>& objects) {
+    for (const LabeledComponent& component : components) {
+        // 過濾掉太小的元件（可能是噪點）
+        if (component.area < min_area) continue;
+
+        ProcessedObject obj;
+        obj.id = static_cast<int>(objects.size());
+        obj.area = static_cast<double>(component.area);
+        obj.boundingBox = component.bbox;
+        obj.centroid = component.centroid;
+        if (with_contours) {
+            obj.contour = labeler.contourOf(component);
+        }
+
+        objects.push_back(std::move(obj));
+    }
+}
+
+void scaleObjectsToFullResolution(std::vector<ProcessedObject>& objects, int tier) {
+    if (tier <= 0) return;
+
+    const int scale = 1 << tier;
+    // 縮小後的一個像素對應原始解析度的 scale x scale 區塊，重心落在區塊中央
+    const double offset = (scale - 1) / 2.0;
+    for (ProcessedObject& obj : objects) {
+        obj.boundingBox = cv::Rect(obj.boundingBox.x * scale, obj.boundingBox.y * scale,
+                                   obj.boundingBox.width * scale, obj.boundingBox.height * scale);
+        obj.area *= static_cast<double>(scale) * scale;
+        obj.centroid = cv::Point2d(obj.centroid.x * scale + offset, obj.centroid.y * scale + offset);
+        for (cv::Point& point : obj.contour) {
+            point = cv::Point(point.x * scale, point.y * scale);
+        }
+    }
+}
+
+void drawDetectedObjects(cv::Mat& canvas, const std::vector<ProcessedObject>& objects) {
+    for (const ProcessedObject& obj : objects) {
+        // 為每個物體畫輪廓；沒有輪廓時標出重心
+        cv::Scalar color = cv::Scalar(0, 255, 0); // 綠色
+        if (!obj.contour.empty()) {
+            cv::polylines(canvas, obj.contour, true, color, 2);
+        } else {
+            cv::circle(canvas, cv::Point(cvRound(obj.centroid.x), cvRound(obj.centroid.y)), 3, color, -1);
+        }
+
+        // 計算並繪製每個物體的邊界框
+        cv::rectangle(canvas, obj.boundingBox, cv::Scalar(0, 0, 255), 2); // 紅色
+
+        // 在物體上標記編號
+        cv::putText(canvas, "Object " + std::to_string(obj.id),
+                    cv::Point(obj.boundingBox.x, obj.boundingBox.y - 10),
+                    cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 0, 0), 1);
+    }
+}
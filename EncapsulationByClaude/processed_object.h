@@ -0,0 +1,31 @@
+// processed_object.h
+#pragma once
+
+#include "object_labeling.h"
+#include "frame_info.h"
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// 定義處理結果的結構
+struct ProcessedObject {
+    int id;
+    cv::Rect boundingBox;
+    double area;
+    cv::Point2d centroid;
+    std::vector<cv::Point> contour;     // LABELING 模式下只在需要輪廓時填入
+    FrameInfo frame;                    // 所屬幀的序號、時間戳與來源（從共享記憶體讀取時填入）
+};
+
+// 從外輪廓建立物體，面積小於 min_area 的視為噪點略過
+void objectsFromContours(const std::vector<std::vector<cv::Point>>& contours, double min_area,
+                         std::vector<ProcessedObject>& objects);
+
+// 從連通元件建立物體；with_contours 為 true 時才追蹤輪廓
+void objectsFromComponents(const ParallelLabeler& labeler, const std::vector<LabeledComponent>& components,
+                           double min_area, bool with_contours, std::vector<ProcessedObject>& objects);
+
+// 把在縮小 2^tier 倍的圖像上偵測到的物體換算回原始解析度：邊界框、輪廓與重心乘上 2^tier，面積乘上 4^tier
+void scaleObjectsToFullResolution(std::vector<ProcessedObject>& objects, int tier);
+
+// 在 canvas 上繪製物體的輪廓（沒有輪廓時標出重心）、邊界框與編號
+void drawDetectedObjects(cv::Mat& canvas, const std::vector<ProcessedObject>& objects);
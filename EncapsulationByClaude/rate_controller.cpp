@@ -0,0 +1,81 @@
+// rate_controller.cpp
+#include "rate_controller.h"
+#include <algorithm>
+#include <iostream>
+
+RateController::RateController(const RateControlConfig& config) : config_(config) {}
+
+RateDecision RateController::onFrame(const ConsumerFeedback& feedback, std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RateDecision decision;
+    decision.resolution_tier = tier_;
+    service_time_ms_ = feedback.service_time_ms;
+
+    if (feedback.alive) {
+        // 消費者仍在處理上一幀：略過，避免覆寫處理中的數據或阻塞擷取
+        if (feedback.busy) {
+            skipped_++;
+            return decision;
+        }
+
+        // 發佈間隔跟隨處理時間，消費者端有積壓時按比例拉長，有多個工作進程並行處理時按比例縮短
+        publish_interval_ms_ = service_time_ms_ * config_.headroom * (1 + feedback.queue_depth) /
+                               std::max<uint32_t>(1, feedback.workers);
+        const double since_last_ms = std::chrono::duration<double, std::milli>(now - last_publish_).count();
+        if (has_published_ && since_last_ms < publish_interval_ms_) {
+            skipped_++;
+            return decision;
+        }
+
+        updateTier();
+    }
+
+    // 沒有消費者時照常發佈，新的消費者連接後直接拿到最新的幀
+    decision.publish = true;
+    decision.resolution_tier = tier_;
+    last_publish_ = now;
+    has_published_ = true;
+    published_++;
+    frames_since_tier_change_++;
+    return decision;
+}
+
+void RateController::updateTier() {
+    if (service_time_ms_ <= 0 || frames_since_tier_change_ < config_.tier_cooldown_frames) {
+        return;
+    }
+
+    if (service_time_ms_ > config_.latency_budget_ms && tier_ < config_.max_resolution_tier) {
+        // 全速略過仍超出預算：降低解析度
+        tier_++;
+        frames_since_tier_change_ = 0;
+        std::cout << "處理時間 " << service_time_ms_ << " ms 超出預算，解析度降到 1/" << (1 << tier_) << std::endl;
+    } else if (tier_ > 0 && service_time_ms_ * 4 < config_.latency_budget_ms * 0.8) {
+        // 像素數變為 4 倍後仍在預算內（保留 20% 餘裕以免來回切換）：提高解析度
+        tier_--;
+        frames_since_tier_change_ = 0;
+        std::cout << "處理時間 " << service_time_ms_ << " ms 有餘裕，解析度回升到 1/" << (1 << tier_) << std::endl;
+    }
+}
+
+void RateController::applyTier(const cv::Mat& src, cv::Mat& dst, int tier) {
+    if (tier <= 0) {
+        dst = src;
+        return;
+    }
+    cv::Size size(std::max(1, src.cols >> tier), std::max(1, src.rows >> tier));
+    cv::resize(src, dst, size, 0, 0, cv::INTER_AREA);
+}
+
+RateControlStats RateController::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RateControlStats result;
+    result.published = published_;
+    result.skipped = skipped_;
+    const uint64_t total = published_ + skipped_;
+    result.skip_ratio = total > 0 ? static_cast<double>(skipped_) / total : 0.0;
+    result.publish_interval_ms = publish_interval_ms_;
+    result.service_time_ms = service_time_ms_;
+    result.resolution_tier = tier_;
+    return result;
+}
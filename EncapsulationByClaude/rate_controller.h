@@ -0,0 +1,65 @@
+// rate_controller.h
+#pragma once
+
+#include "shared_memory_manager.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// 速率控制參數
+struct RateControlConfig {
+    double latency_budget_ms = 100.0;   // 每幀從發佈到處理完成的延遲上限
+    double headroom = 1.1;              // 發佈間隔相對於消費者處理時間的餘裕
+    int max_resolution_tier = 2;        // 最多縮小到 1/2^tier
+    int tier_cooldown_frames = 15;      // 兩次切換解析度之間至少發佈的幀數
+};
+
+// 單幀的決定
+struct RateDecision {
+    bool publish = false;      // 是否發佈這一幀；false 表示略過
+    int resolution_tier = 0;   // 發佈前應縮小到的解析度層級
+};
+
+// 速率控制統計
+struct RateControlStats {
+    uint64_t published = 0;            // 已發佈的幀數
+    uint64_t skipped = 0;              // 略過的幀數
+    double skip_ratio = 0;             // 略過比例
+    double publish_interval_ms = 0;    // 目前的最小發佈間隔
+    double service_time_ms = 0;        // 最近一次讀到的消費者處理時間
+    int resolution_tier = 0;           // 目前的解析度層級
+};
+
+// 依消費者回報的處理時間與佇列深度調節生產者
+// - 消費者仍在處理上一幀時略過新幀，不覆寫也不阻塞擷取
+// - 發佈間隔跟隨消費者的處理時間，佇列有積壓時按比例拉長
+// - 即使全速略過仍超出延遲預算時降低解析度；處理時間足夠寬裕時再回升
+class RateController {
+public:
+    explicit RateController(const RateControlConfig& config = RateControlConfig());
+
+    // 每擷取一幀呼叫一次，決定是否發佈以及發佈的解析度
+    RateDecision onFrame(const ConsumerFeedback& feedback,
+                         std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    // 依解析度層級縮小圖像（層級 0 時直接參考原圖）
+    static void applyTier(const cv::Mat& src, cv::Mat& dst, int tier);
+
+    // 統計（可從任何執行緒呼叫）
+    RateControlStats stats() const;
+
+private:
+    RateControlConfig config_;
+    mutable std::mutex mutex_;   // stats() 可能在擷取執行緒以外呼叫
+    std::chrono::steady_clock::time_point last_publish_;
+    bool has_published_ = false;
+    double publish_interval_ms_ = 0;
+    double service_time_ms_ = 0;
+    int tier_ = 0;
+    int frames_since_tier_change_ = 0;
+    uint64_t published_ = 0;
+    uint64_t skipped_ = 0;
+
+    // 依處理時間調整解析度層級
+    void updateTier();
+};
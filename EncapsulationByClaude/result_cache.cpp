@@ -0,0 +1,72 @@
+// result_cache.cpp
+#include "result_cache.h"
+
+void ResultCache::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+    evictTo(capacity_);
+}
+
+bool ResultCache::lookup(uint64_t content_hash, std::vector<ProcessedObject>& objects, size_t frame_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0 || content_hash == 0) {
+        return false;
+    }
+
+    stats_.lookups++;
+    auto it = index_.find(content_hash);
+    if (it == index_.end()) {
+        return false;
+    }
+
+    // 移到最前面，不重新配置節點
+    entries_.splice(entries_.begin(), entries_, it->second);
+    objects = it->second->objects;
+
+    stats_.hits++;
+    stats_.bytes_saved += frame_bytes;
+    stats_.saved_ms += avg_process_ms_;
+    return true;
+}
+
+void ResultCache::insert(uint64_t content_hash, const std::vector<ProcessedObject>& objects, double process_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0 || content_hash == 0) {
+        return;
+    }
+
+    avg_process_ms_ = avg_process_ms_ == 0 ? process_ms : avg_process_ms_ * 0.9 + process_ms * 0.1;
+
+    auto it = index_.find(content_hash);
+    if (it != index_.end()) {
+        it->second->objects = objects;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+
+    evictTo(capacity_ - 1);
+    entries_.push_front(Entry{content_hash, objects});
+    index_[content_hash] = entries_.begin();
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+}
+
+ResultCacheStats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ResultCacheStats stats = stats_;
+    stats.entries = entries_.size();
+    stats.capacity = capacity_;
+    return stats;
+}
+
+void ResultCache::evictTo(size_t limit) {
+    while (entries_.size() > limit) {
+        index_.erase(entries_.back().content_hash);
+        entries_.pop_back();
+        stats_.evictions++;
+    }
+}
@@ -0,0 +1,65 @@
+// result_cache.h
+#pragma once
+
+#include "processed_object.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// 結果快取的統計
+struct ResultCacheStats {
+    uint64_t lookups = 0;       // 查詢次數
+    uint64_t hits = 0;          // 命中次數（跳過偵測）
+    uint64_t evictions = 0;     // 因容量不足而淘汰的項目數
+    uint64_t bytes_saved = 0;   // 命中的幀的圖像位元組數，即省下處理的數據量
+    double saved_ms = 0;        // 估計省下的處理時間（命中時以未命中幀的平均處理時間計）
+    size_t entries = 0;         // 目前的項目數
+    size_t capacity = 0;        // 容量（0 表示停用）
+
+    double hitRate() const { return lookups ? static_cast<double>(hits) / lookups : 0.0; }
+};
+
+// 內容雜湊 -> 偵測結果的 LRU 快取
+// 內容相同的幀（重複的圖像檔、夜間靜止的畫面）直接取回先前的物體，不再執行偵測
+// 快取的結果只對應當時的處理參數，參數改變時須呼叫 clear()
+class ResultCache {
+public:
+    // 預設停用：每幀都要計算雜湊，只有內容常重複的來源才值得啟用
+    explicit ResultCache(size_t capacity = 0) : capacity_(capacity) {}
+
+    // 設置容量，0 表示停用；縮小時淘汰最久未使用的項目
+    void setCapacity(size_t capacity);
+
+    bool enabled() const { return capacity_ > 0; }
+
+    // 查詢，命中時複製結果並標為最近使用；frame_bytes 計入省下的數據量
+    bool lookup(uint64_t content_hash, std::vector<ProcessedObject>& objects, size_t frame_bytes);
+
+    // 存入未命中時的處理結果，process_ms 用於估計命中時省下的時間
+    void insert(uint64_t content_hash, const std::vector<ProcessedObject>& objects, double process_ms);
+
+    // 清除所有項目（統計保留）
+    void clear();
+
+    // 取得統計數據（可跨執行緒呼叫）
+    ResultCacheStats stats() const;
+
+private:
+    struct Entry {
+        uint64_t content_hash;
+        std::vector<ProcessedObject> objects;
+    };
+
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    std::list<Entry> entries_;                                        // 最近使用的在前
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+    ResultCacheStats stats_;
+    double avg_process_ms_ = 0;                                       // 未命中幀處理時間的移動平均
+
+    // 淘汰到不超過 limit 個項目（需持有鎖）
+    void evictTo(size_t limit);
+};
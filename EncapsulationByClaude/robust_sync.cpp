@@ -0,0 +1,110 @@
+// robust_sync.cpp
+#include "robust_sync.h"
+#include <cerrno>
+#include <ctime>
+#include <iostream>
+#include <system_error>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+RobustMutex::RobustMutex() : recoveries_(0) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int rc = pthread_mutex_init(&mutex_, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rc != 0) {
+        throw std::system_error(rc, std::generic_category(), "pthread_mutex_init");
+    }
+}
+
+RobustMutex::~RobustMutex() {
+    pthread_mutex_destroy(&mutex_);
+}
+
+void RobustMutex::handleLockResult(int rc) {
+    if (rc == 0) {
+        return;
+    }
+    if (rc == EOWNERDEAD) {
+        // 上一個持有者已崩潰，恢復鎖的一致性
+        pthread_mutex_consistent(&mutex_);
+        recoveries_.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "偵測到持有鎖的進程已終止，已恢復互斥鎖" << std::endl;
+        return;
+    }
+    throw std::system_error(rc, std::generic_category(), "pthread_mutex_lock");
+}
+
+void RobustMutex::lock() {
+    handleLockResult(pthread_mutex_lock(&mutex_));
+}
+
+bool RobustMutex::try_lock() {
+    int rc = pthread_mutex_trylock(&mutex_);
+    if (rc == EBUSY) {
+        return false;
+    }
+    handleLockResult(rc);
+    return true;
+}
+
+void RobustMutex::unlock() {
+    pthread_mutex_unlock(&mutex_);
+}
+
+RobustCondition::RobustCondition() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int rc = pthread_cond_init(&cond_, &attr);
+    pthread_condattr_destroy(&attr);
+    if (rc != 0) {
+        throw std::system_error(rc, std::generic_category(), "pthread_cond_init");
+    }
+}
+
+RobustCondition::~RobustCondition() {
+    pthread_cond_destroy(&cond_);
+}
+
+void RobustCondition::wait(std::unique_lock<RobustMutex>& lock) {
+    RobustMutex* mutex = lock.mutex();
+    mutex->handleLockResult(pthread_cond_wait(&cond_, mutex->native_handle()));
+}
+
+bool RobustCondition::wait_until(std::unique_lock<RobustMutex>& lock, std::chrono::steady_clock::time_point deadline) {
+    // steady_clock 在 Linux 上即 CLOCK_MONOTONIC，可直接轉換
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    if (ns < 0) ns = 0;
+    timespec ts;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+
+    RobustMutex* mutex = lock.mutex();
+    int rc = pthread_cond_timedwait(&cond_, mutex->native_handle(), &ts);
+    if (rc == ETIMEDOUT) {
+        return false;
+    }
+    mutex->handleLockResult(rc);
+    return true;
+}
+
+void RobustCondition::notify_one() {
+    pthread_cond_signal(&cond_);
+}
+
+void RobustCondition::notify_all() {
+    pthread_cond_broadcast(&cond_);
+}
+
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* timeout) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>* word, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
@@ -0,0 +1,65 @@
+// robust_sync.h
+#pragma once
+
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+// 進程間的健壯互斥鎖
+// 持有鎖的進程崩潰後，下一個獲取鎖的進程會收到 EOWNERDEAD，
+// 此時將鎖標記為一致並繼續使用，而不是永遠死鎖
+class RobustMutex {
+public:
+    RobustMutex();
+    ~RobustMutex();
+
+    RobustMutex(const RobustMutex&) = delete;
+    RobustMutex& operator=(const RobustMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    // 從崩潰的持有者接手鎖的次數
+    uint32_t recoveries() const { return recoveries_.load(std::memory_order_relaxed); }
+
+    pthread_mutex_t* native_handle() { return &mutex_; }
+
+    // 處理 pthread 回傳值，接手已崩潰持有者的鎖
+    void handleLockResult(int rc);
+
+private:
+    pthread_mutex_t mutex_;
+    std::atomic<uint32_t> recoveries_;
+};
+
+// 進程間的條件變數，使用 CLOCK_MONOTONIC 計時
+class RobustCondition {
+public:
+    RobustCondition();
+    ~RobustCondition();
+
+    RobustCondition(const RobustCondition&) = delete;
+    RobustCondition& operator=(const RobustCondition&) = delete;
+
+    void wait(std::unique_lock<RobustMutex>& lock);
+
+    // 等待到指定時間點，超時回傳 false
+    bool wait_until(std::unique_lock<RobustMutex>& lock, std::chrono::steady_clock::time_point deadline);
+
+    void notify_one();
+    void notify_all();
+
+private:
+    pthread_cond_t cond_;
+};
+
+// 進程間的 futex（不使用 FUTEX_PRIVATE_FLAG），word 必須位於共享記憶體中
+// 等待到 word 不等於 expected、被喚醒或超時 (timeout 為相對時間，nullptr 表示無限等待)
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* timeout);
+
+// 喚醒最多 count 個在 word 上等待的執行緒或進程
+void futexWake(std::atomic<uint32_t>* word, int count);
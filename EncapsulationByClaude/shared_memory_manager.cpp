@@ -1,64 +1,689 @@
 // shared_memory_manager.cpp
 #include "shared_memory_manager.h"
+#include "frame_kernels.h"
+#include "frame_hash.h"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
-SharedMemoryManager::SharedMemoryManager(const std::string& name, SharedMemoryMode mode, size_t max_image_size)
-    : name_(name), max_image_size_(max_image_size), is_creator_(mode == SharedMemoryMode::CREATE) {
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 事件訂閱者的通知 socket 位址：抽象命名空間，進程結束時自動消失，不留下檔案
+// 共享記憶體名稱可能很長，以雜湊值區分
+socklen_t eventAddress(const std::string& name, uint64_t token, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    const int length = std::snprintf(address.sun_path + 1, sizeof(address.sun_path) - 1, "ipcf-event/%zx/%llx",
+                                     std::hash<std::string>()(name), static_cast<unsigned long long>(token));
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + length);
+}
+
+// 送出通知用的未綁定 socket，整個進程共用
+int notifySocket() {
+    static const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    return fd;
+}
+
+// 標頭無法辨識（其他版本）時無從讀取生產者 PID，改由 /proc/<pid>/maps 判斷是否有其他進程映射著該共享記憶體
+// 只檢查與共享記憶體擁有者相同使用者的進程（其他使用者無法以讀寫方式打開）
+// 回傳 1 表示有、0 表示沒有、-1 表示無法判斷（有同使用者的進程無權讀取）
+int mappedByOtherProcess(const std::string& name) {
+    const std::string shm_path = "/dev/shm/" + (name.empty() || name[0] != '/' ? name : name.substr(1));
+    struct stat shm_stat;
+    if (stat(shm_path.c_str(), &shm_stat) != 0) {
+        return -1;
+    }
+    
+    const std::string self = std::to_string(getpid());
+    bool unknown = false;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc", ec)) {
+        const std::string pid = entry.path().filename().string();
+        if (pid.empty() || pid == self || pid.find_first_not_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        struct stat proc_stat;
+        if (stat(entry.path().c_str(), &proc_stat) != 0 || proc_stat.st_uid != shm_stat.st_uid) {
+            continue;
+        }
+        
+        std::ifstream maps(entry.path() / "maps");
+        if (!maps) {
+            // 進程剛結束時也會打不開，只有目錄仍在時才視為無法判斷
+            if (std::filesystem::exists(entry.path(), ec)) {
+                unknown = true;
+            }
+            continue;
+        }
+        std::string line;
+        while (std::getline(maps, line)) {
+            const size_t pos = line.find(shm_path);
+            if (pos != std::string::npos &&
+                (pos + shm_path.size() == line.size() || line[pos + shm_path.size()] == ' ')) {
+                return 1;
+            }
+        }
+    }
+    return ec || unknown ? -1 : 0;
+}
+
+} // namespace
+
+SharedMemoryManager::SharedMemoryManager(const std::string& name, SharedMemoryMode mode, size_t max_image_size,
+                                         const MemfdOptions& memfd_options)
+    : name_(name), use_memfd_(isMemfdName(name)), memfd_options_(memfd_options), max_image_size_(max_image_size),
+      is_creator_(mode == SharedMemoryMode::CREATE), mode_(mode) {
     
     try {
         if (mode == SharedMemoryMode::CREATE) {
+            create();
+        } else {
+            open();
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << "共享記憶體錯誤: " << ex.what() << std::endl;
+        throw;
+    }
+    
+    // 啟動心跳執行緒
+    heartbeat_running_ = true;
+    heartbeat_thread_ = std::thread(&SharedMemoryManager::heartbeatLoop, this);
+}
+
+SharedMemoryManager::~SharedMemoryManager() {
+    // 停止心跳執行緒
+    {
+        std::lock_guard<std::mutex> lock(heartbeat_mutex_);
+        heartbeat_running_ = false;
+    }
+    heartbeat_cond_.notify_all();
+    if (heartbeat_thread_.joinable()) {
+        heartbeat_thread_.join();
+    }
+    
+    // 取消事件訂閱
+    {
+        std::lock_guard<std::mutex> lock(event_mutex_);
+        unsubscribeEvents(shared_data_);
+        if (event_fd_ >= 0) {
+            close(event_fd_);
+            event_fd_ = -1;
+        }
+    }
+    
+    if (is_creator_ && use_memfd_) {
+        shared_data_->producer.pid = 0;
+        
+        // 停止代理並移除 socket；memfd 在最後一個映射關閉後自動釋放
+        std::cout << "清理共享記憶體: " << name_ << " (已交給 " << broker_->served() << " 個連接者)" << std::endl;
+        broker_.reset();
+    } else if (is_creator_) {
+        shared_data_->producer.pid = 0;
+        
+        // 只移除自己這一世代的共享記憶體，避免誤刪已被其他生產者回收重建的段
+        bool same_generation = true;
+        try {
+            bip::shared_memory_object current(bip::open_only, name_.c_str(), bip::read_only);
+            bip::mapped_region current_region(current, bip::read_only);
+            const SharedImageData* current_data = static_cast<const SharedImageData*>(current_region.get_address());
+            same_generation = !validateHeader(current_data, current_region.get_size()) ||
+                              current_data->layout.generation == generation_;
+        } catch (const std::exception&) {
+            same_generation = false;
+        }
+        
+        if (same_generation) {
+            std::cout << "清理共享記憶體: " << name_ << std::endl;
+            remove(name_);
+        }
+    } else {
+        if (mode_ == SharedMemoryMode::WORKER) {
+            shared_data_->consumer.worker_count.fetch_sub(1);
+        }
+        if (shared_data_->consumer.pid.load() == getpid()) {
+            shared_data_->consumer.pid = 0;
+        }
+        releaseWorkerSlot();
+    }
+}
+
+void SharedMemoryManager::create() {
+    uint64_t previous_generation = 0;
+    
+    // memfd 後端沒有具名物件，不會與其他進程的共享記憶體同名衝突
+    if (!use_memfd_) {
+        try {
             // 創建新的共享記憶體
             shm_ = bip::shared_memory_object(
                 bip::create_only,       // 創建
-                name.c_str(),           // 名稱
+                name_.c_str(),          // 名稱
                 bip::read_write         // 讀寫權限
             );
+        } catch (const bip::interprocess_exception& ex) {
+            if (ex.get_error_code() != bip::already_exists_error) {
+                throw;
+            }
             
-            // 設置共享記憶體大小 (結構體大小 + 最大圖像大小)
-            const size_t shm_size = sizeof(SharedImageData) + max_image_size_;
-            shm_.truncate(shm_size);
-            
-            // 映射整個共享記憶體區域
-            region_ = bip::mapped_region(shm_, bip::read_write);
-            
-            // 獲取指向共享記憶體的指針並初始化
-            void* addr = region_.get_address();
-            shared_data_ = new (addr) SharedImageData;
-            shared_data_->new_image_ready = false;
-            shared_data_->processing_done = true;
-            
-            std::cout << "創建共享記憶體: " << name << " (" << shm_size << " bytes)" << std::endl;
+            // 同名共享記憶體已存在：若原生產者已終止則回收，否則拋出例外
+            previous_generation = reclaimStale();
+            shm_ = bip::shared_memory_object(bip::create_only, name_.c_str(), bip::read_write);
+        }
+    }
+    
+    // 設置共享記憶體大小 (標頭 + 對齊填充 + 最大圖像大小)
+    // 圖像數據對齊到分頁，方便 SIMD 存取與零複製映射
+    const size_t alignment = std::max(FRAME_ALIGNMENT, static_cast<size_t>(bip::mapped_region::get_page_size()));
+    const size_t frame_offset = alignUp(sizeof(SharedImageData), alignment);
+    // 灰階平面放在彩色數據之後，大小為 3 通道圖像的三分之一
+    const size_t luma_offset = alignUp(frame_offset + max_image_size_, alignment);
+    const size_t luma_capacity = alignUp(max_image_size_ / 3, FRAME_ALIGNMENT);
+    const size_t shm_size = luma_offset + luma_capacity;
+    if (use_memfd_) {
+        memfd_ = MemfdSegment::create(name_, shm_size, memfd_options_);
+        // 沒有具名的舊共享記憶體可以讀取上一世代，改以建立時間作為世代，重啟後的生產者必定較大
+        previous_generation = static_cast<uint64_t>(steadyNowNs()) - 1;
+    } else {
+        shm_.truncate(shm_size);
+        
+        // 映射整個共享記憶體區域
+        region_ = bip::mapped_region(shm_, bip::read_write);
+    }
+    
+    // 獲取指向共享記憶體的指針並初始化
+    void* addr = segmentAddress();
+    shared_data_ = new (addr) SharedImageData;
+    generation_ = previous_generation + 1;
+    
+    shared_data_->layout.version = SHM_VERSION;
+    shared_data_->layout.header_size = sizeof(SharedImageData);
+    shared_data_->layout.abi_tag = SHM_ABI_TAG;
+    shared_data_->layout.frame_offset = frame_offset;
+    shared_data_->layout.frame_capacity = max_image_size_;
+    shared_data_->layout.luma_offset = luma_offset;
+    shared_data_->layout.luma_capacity = luma_capacity;
+    shared_data_->layout.generation = generation_;
+    
+    shared_data_->producer.published_count = 0;
+    shared_data_->producer.width = 0;
+    shared_data_->producer.height = 0;
+    shared_data_->producer.channels = 0;
+    shared_data_->producer.type = 0;
+    shared_data_->producer.data_size = 0;
+    shared_data_->producer.encoding = static_cast<uint32_t>(FrameEncoding::RAW);
+    shared_data_->producer.payload_size = 0;
+    shared_data_->producer.luma_valid = 0;
+    shared_data_->producer.resolution_tier = 0;
+    shared_data_->producer.frame = FrameInfo();
+    shared_data_->producer.publish_interval_us = 0;
+    shared_data_->producer.heartbeat_ns = steadyNowNs();
+    shared_data_->producer.ready = 0;
+    shared_data_->producer.publishes_luma = publish_luma_ ? 1 : 0;
+    
+    shared_data_->consumer.consumed_count = 0;
+    shared_data_->consumer.claimed_count = 0;
+    shared_data_->consumer.worker_count = 0;
+    shared_data_->consumer.pid = 0;
+    shared_data_->consumer.heartbeat_ns = 0;
+    shared_data_->consumer.attach_count = 0;
+    shared_data_->consumer.latency_us = 0;
+    shared_data_->consumer.last_sequence = 0;
+    shared_data_->consumer.missed_frames = 0;
+    shared_data_->consumer.late_frames = 0;
+    shared_data_->consumer.cache_hits = 0;
+    shared_data_->consumer.cache_bytes_saved = 0;
+    shared_data_->consumer.ready = 0;
+    shared_data_->consumer.hash_requested = 0;
+    for (auto& slot : shared_data_->worker_slots) {
+        slot.pid = 0;
+        slot.heartbeat_ns = 0;
+        slot.service_time_us = 0;
+        slot.queue_depth = 0;
+    }
+    for (auto& subscriber : shared_data_->event_subscribers) {
+        subscriber = 0;
+    }
+    
+    shared_data_->producer.pid = getpid();
+    // 最後寫入識別碼，消費者以此判斷初始化完成
+    std::atomic_thread_fence(std::memory_order_release);
+    shared_data_->layout.magic = SHM_MAGIC;
+    
+    if (use_memfd_) {
+        // 初始化完成後才開始交出 memfd；同名代理仍在服務時拋出例外
+        broker_ = std::make_unique<SegmentBroker>(memfdSocketName(name_), memfd_.fd());
+        std::cout << "創建共享記憶體: " << name_ << " (memfd, " << memfd_.size() << " bytes"
+                  << (memfd_.sealed() ? ", 已封存" : "") << (memfd_.hugePages() ? ", 大分頁" : "") << ")" << std::endl;
+        return;
+    }
+    
+    std::cout << "創建共享記憶體: " << name_ << " (" << shm_size << " bytes, 世代 " << generation_ << ")" << std::endl;
+}
+
+void SharedMemoryManager::open() {
+    if (use_memfd_) {
+        // 向生產者的代理索取 memfd 並映射
+        memfd_ = MemfdSegment::adopt(SegmentBroker::receive(memfdSocketName(name_), HEARTBEAT_TIMEOUT_MS));
+        if (!memfd_.sealed()) {
+            std::cerr << "警告: 收到的 memfd 未封存大小，其他進程截斷時讀取會觸發 SIGBUS" << std::endl;
+        }
+    } else {
+        // 打開已存在的共享記憶體
+        shm_ = bip::shared_memory_object(
+            bip::open_only,         // 打開現有
+            name_.c_str(),          // 名稱
+            bip::read_write         // 讀寫權限
+        );
+        
+        // 映射共享記憶體區域
+        region_ = bip::mapped_region(shm_, bip::read_write);
+    }
+    if (segmentSize() < sizeof(SharedImageData)) {
+        throw std::runtime_error("共享記憶體大小不符: " + name_);
+    }
+    
+    // 獲取指向共享數據的指針
+    shared_data_ = static_cast<SharedImageData*>(segmentAddress());
+    
+    // 等待生產者完成初始化
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(HEARTBEAT_TIMEOUT_MS);
+    while (reinterpret_cast<volatile uint32_t&>(shared_data_->layout.magic) != SHM_MAGIC) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            throw std::runtime_error("共享記憶體尚未初始化或不是本程式建立的: " + name_);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    
+    // 檢查版本與 ABI，避免不同版本的程式誤用同一塊共享記憶體
+    std::string reason;
+    if (!validateHeader(shared_data_, segmentSize(), &reason)) {
+        throw std::runtime_error("共享記憶體標頭不相容: " + reason);
+    }
+    
+    generation_ = shared_data_->layout.generation;
+    max_image_size_ = shared_data_->layout.frame_capacity;
+    
+    if (mode_ == SharedMemoryMode::MONITOR) {
+        std::cout << "監看共享記憶體: " << name_ << " (世代 " << generation_ << ")" << std::endl;
+        return;
+    }
+    
+    if (mode_ == SharedMemoryMode::WORKER) {
+        // 工作進程共用消費者身份，不取代仍存活的消費者
+        uint32_t workers = shared_data_->consumer.worker_count.fetch_add(1) + 1;
+        adoptConsumerIdentity();
+        claimWorkerSlot();
+        std::cout << "以工作進程連接到共享記憶體: " << name_ << " (世代 " << generation_
+                  << ", 共 " << workers << " 個工作進程)" << std::endl;
+        return;
+    }
+    
+    // 登記為消費者；若上一個消費者已崩潰，直接接手未完成的幀
+    int32_t previous_consumer = shared_data_->consumer.pid.exchange(getpid());
+    shared_data_->consumer.heartbeat_ns = steadyNowNs();
+    // 取代先前的消費者，完成預熱前不標示就緒
+    shared_data_->consumer.ready = 0;
+    uint32_t attach_count = ++shared_data_->consumer.attach_count;
+    claimWorkerSlot();
+    
+    std::cout << "連接到共享記憶體: " << name_ << " (世代 " << generation_ << ", 第 " << attach_count << " 次連接)" << std::endl;
+    if (previous_consumer != 0 && previous_consumer != getpid()) {
+        std::cout << "接手先前的消費者 (PID " << previous_consumer << ")" << std::endl;
+    }
+}
+
+uint64_t SharedMemoryManager::reclaimStale() {
+    uint64_t old_generation = 0;
+    
+    {
+        bip::shared_memory_object old_shm(bip::open_only, name_.c_str(), bip::read_write);
+        bip::mapped_region old_region(old_shm, bip::read_write);
+        
+        const SharedImageData* old_data = static_cast<const SharedImageData*>(old_region.get_address());
+        std::string reason;
+        if (validateHeader(old_data, old_region.get_size(), &reason)) {
+            int32_t old_producer = old_data->producer.pid.load();
+            if (isAlive(old_producer, old_data->producer.heartbeat_ns.load())) {
+                throw std::runtime_error("共享記憶體 " + name_ + " 仍由進程 " +
+                                         std::to_string(old_producer) + " 使用中");
+            }
+            old_generation = old_data->layout.generation;
         } else {
-            // 打開已存在的共享記憶體
-            shm_ = bip::shared_memory_object(
-                bip::open_only,         // 打開現有
-                name.c_str(),           // 名稱
-                bip::read_write         // 讀寫權限
-            );
-            
-            // 映射共享記憶體區域
-            region_ = bip::mapped_region(shm_, bip::read_write);
-            
-            // 獲取指向共享數據的指針
-            shared_data_ = static_cast<SharedImageData*>(region_.get_address());
-            
-            std::cout << "連接到共享記憶體: " << name << std::endl;
+            // 其他版本或損毀的共享記憶體：標頭中的 PID 位置不可靠，只有確定沒有其他進程映射時才回收
+            std::cerr << "舊共享記憶體標頭無法辨識 (" << reason << ")" << std::endl;
+            const int mapped = mappedByOtherProcess(name_);
+            if (mapped != 0) {
+                throw std::runtime_error("共享記憶體 " + name_ + (mapped > 0 ? " 仍由其他版本的進程使用中"
+                                                                             : " 無法判斷是否仍在使用中") +
+                                         "，確認無人使用後請先以 SharedMemoryManager::remove() 移除");
+            }
         }
-    } catch (const std::exception& ex) {
-        std::cerr << "共享記憶體錯誤: " << ex.what() << std::endl;
-        throw;
     }
+    
+    std::cout << "回收失效的共享記憶體: " << name_ << " (世代 " << old_generation << ")" << std::endl;
+    remove(name_);
+    return old_generation;
 }
 
-SharedMemoryManager::~SharedMemoryManager() {
+bool SharedMemoryManager::validateHeader(const SharedImageData* data, size_t region_size, std::string* reason) {
+    auto fail = [reason](const std::string& message) {
+        if (reason) *reason = message;
+        return false;
+    };
+    
+    if (region_size < sizeof(SharedImageData)) {
+        return fail("大小不足");
+    }
+    if (data->layout.magic != SHM_MAGIC) {
+        return fail("識別碼不符");
+    }
+    if (data->layout.version != SHM_VERSION) {
+        return fail("版本不符 (" + std::to_string(data->layout.version) + " != " + std::to_string(SHM_VERSION) + ")");
+    }
+    if (data->layout.header_size != sizeof(SharedImageData) || data->layout.abi_tag != SHM_ABI_TAG) {
+        return fail("ABI 不符");
+    }
+    if (data->layout.frame_offset < sizeof(SharedImageData) ||
+        data->layout.frame_offset % FRAME_ALIGNMENT != 0 ||
+        data->layout.frame_offset + data->layout.frame_capacity > region_size) {
+        return fail("圖像數據區超出範圍");
+    }
+    if (data->layout.luma_offset % FRAME_ALIGNMENT != 0 ||
+        data->layout.luma_offset < data->layout.frame_offset + data->layout.frame_capacity ||
+        data->layout.luma_offset + data->layout.luma_capacity > region_size) {
+        return fail("灰階平面超出範圍");
+    }
+    return true;
+}
+
+bool SharedMemoryManager::isAlive(int32_t pid, int64_t heartbeat_ns) const {
+    if (pid <= 0) {
+        return false;
+    }
+    
+    // 進程已不存在；memfd 後端的對方可能在另一個 PID 命名空間，PID 無從查詢，只看心跳
+    if (!use_memfd_ && kill(pid, 0) != 0 && errno != EPERM) {
+        return false;
+    }
+    
+    // 進程存在但心跳已逾時（例如卡死）
+    return steadyNowNs() - heartbeat_ns < static_cast<int64_t>(HEARTBEAT_TIMEOUT_MS) * 1000000;
+}
+
+bool SharedMemoryManager::isProducerAlive() const {
+    return isAlive(shared_data_->producer.pid.load(), shared_data_->producer.heartbeat_ns.load());
+}
+
+bool SharedMemoryManager::isConsumerAlive() const {
+    return isAlive(shared_data_->consumer.pid.load(), shared_data_->consumer.heartbeat_ns.load());
+}
+
+bool SharedMemoryManager::reattachIfStale() {
+    if (is_creator_ || isProducerAlive()) {
+        return false;
+    }
+    
+    try {
+        // 嘗試打開同名的新共享記憶體（memfd 後端向新生產者的代理索取）
+        bip::shared_memory_object shm;
+        bip::mapped_region region;
+        MemfdSegment segment;
+        if (use_memfd_) {
+            segment = MemfdSegment::adopt(SegmentBroker::receive(memfdSocketName(name_), HEARTBEAT_INTERVAL_MS));
+        } else {
+            shm = bip::shared_memory_object(bip::open_only, name_.c_str(), bip::read_write);
+            region = bip::mapped_region(shm, bip::read_write);
+        }
+        void* address = use_memfd_ ? segment.address() : region.get_address();
+        size_t size = use_memfd_ ? segment.size() : region.get_size();
+        if (size < sizeof(SharedImageData)) {
+            return false;
+        }
+        
+        SharedImageData* data = static_cast<SharedImageData*>(address);
+        if (!validateHeader(data, size) || data->layout.generation == generation_) {
+            // 生產者尚未重建
+            return false;
+        }
+        
+        std::lock_guard<std::mutex> lock(heartbeat_mutex_);
+        std::lock_guard<std::mutex> event_lock(event_mutex_);
+        if (mode_ == SharedMemoryMode::WORKER) {
+            shared_data_->consumer.worker_count.fetch_sub(1);
+        }
+        // 訂閱改登記到新世代的標頭
+        unsubscribeEvents(shared_data_);
+        if (shared_data_->consumer.pid.load() == getpid()) {
+            shared_data_->consumer.pid = 0;
+        }
+        releaseWorkerSlot();
+        shm_.swap(shm);
+        region_.swap(region);
+        memfd_.swap(segment);
+        shared_data_ = data;
+        generation_ = data->layout.generation;
+        max_image_size_ = data->layout.frame_capacity;
+        claimed_count_ = 0;
+        // 新世代的生產者從 1 重新編號
+        last_sequence_ = 0;
+        current_frame_ = FrameInfo();
+        current_tier_ = 0;
+        
+        if (mode_ == SharedMemoryMode::WORKER) {
+            shared_data_->consumer.worker_count.fetch_add(1);
+            adoptConsumerIdentity();
+        } else if (mode_ == SharedMemoryMode::OPEN) {
+            shared_data_->consumer.pid = getpid();
+            shared_data_->consumer.heartbeat_ns = steadyNowNs();
+            ++shared_data_->consumer.attach_count;
+        }
+        if (mode_ == SharedMemoryMode::WORKER || mode_ == SharedMemoryMode::OPEN) {
+            claimWorkerSlot();
+        }
+        if (ready_) {
+            // 已完成預熱，在新世代的標頭中重新標示
+            shared_data_->consumer.ready.store(1, std::memory_order_release);
+        }
+        if (hash_requested_) {
+            shared_data_->consumer.hash_requested.store(1, std::memory_order_relaxed);
+        }
+        if (event_fd_ >= 0) {
+            // 在新世代的標頭中重新訂閱，並喚醒自己的等待者重新檢查條件
+            subscribeEvents(shared_data_);
+            sockaddr_un address;
+            const socklen_t length = eventAddress(name_, event_token_, address);
+            const char byte = 0;
+            sendto(notifySocket(), &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL, reinterpret_cast<const sockaddr*>(&address), length);
+        }
+        
+        std::cout << "重新連接到共享記憶體: " << name_ << " (世代 " << generation_ << ")" << std::endl;
+        return true;
+    } catch (const std::exception&) {
+        // 新的共享記憶體尚不存在
+        return false;
+    }
+}
+
+void SharedMemoryManager::reportQueueDepth(uint32_t depth) {
+    if (worker_slot_ >= 0) {
+        shared_data_->worker_slots[worker_slot_].queue_depth.store(depth, std::memory_order_relaxed);
+    }
+}
+
+bool SharedMemoryManager::workerSlotLive(const SharedImageData::WorkerSlot& slot, int64_t now_ns) {
+    // 只看心跳：讀取端在每一幀都會彙總，不為每一格查詢進程是否存在
+    return slot.pid.load(std::memory_order_acquire) != 0 &&
+           now_ns - slot.heartbeat_ns.load(std::memory_order_relaxed) < static_cast<int64_t>(HEARTBEAT_TIMEOUT_MS) * 1000000;
+}
+
+void SharedMemoryManager::claimWorkerSlot() {
+    const int32_t self = getpid();
+    const int64_t now_ns = steadyNowNs();
+    for (size_t i = 0; i < MAX_WORKER_SLOTS; i++) {
+        SharedImageData::WorkerSlot& slot = shared_data_->worker_slots[i];
+        int32_t current = slot.pid.load(std::memory_order_acquire);
+        // 空格，或先前的工作進程已崩潰而留下的格子
+        if (current != 0 && workerSlotLive(slot, now_ns)) continue;
+        // 先更新心跳再佔用，其他連接不會把剛佔用的格子當成逾時
+        slot.heartbeat_ns.store(now_ns, std::memory_order_relaxed);
+        if (slot.pid.compare_exchange_strong(current, self, std::memory_order_acq_rel)) {
+            slot.service_time_us.store(0, std::memory_order_relaxed);
+            slot.queue_depth.store(0, std::memory_order_relaxed);
+            worker_slot_ = static_cast<int>(i);
+            return;
+        }
+    }
+    worker_slot_ = -1;
+    std::cerr << "消費者指標格已滿，這個連接不回報處理時間" << std::endl;
+}
+
+void SharedMemoryManager::releaseWorkerSlot() {
+    if (worker_slot_ < 0) {
+        return;
+    }
+    SharedImageData::WorkerSlot& slot = shared_data_->worker_slots[worker_slot_];
+    slot.queue_depth.store(0, std::memory_order_relaxed);
+    int32_t self = getpid();
+    slot.pid.compare_exchange_strong(self, 0, std::memory_order_acq_rel);
+    worker_slot_ = -1;
+}
+
+void SharedMemoryManager::adoptConsumerIdentity() {
+    // 消費者身份由其中一個工作進程代表並更新心跳；該進程終止後由其他工作進程接手
+    SharedImageData::ConsumerState& consumer = shared_data_->consumer;
+    int32_t current = consumer.pid.load();
+    if (current == getpid() || isAlive(current, consumer.heartbeat_ns.load())) {
+        return;
+    }
+    if (consumer.pid.compare_exchange_strong(current, getpid())) {
+        consumer.heartbeat_ns = steadyNowNs();
+        ++consumer.attach_count;
+    }
+}
+
+void SharedMemoryManager::heartbeatLoop() {
+    std::unique_lock<std::mutex> lock(heartbeat_mutex_);
+    while (heartbeat_running_) {
+        if (is_creator_) {
+            shared_data_->producer.heartbeat_ns = steadyNowNs();
+        } else {
+            if (mode_ == SharedMemoryMode::WORKER) {
+                adoptConsumerIdentity();
+            }
+            if (shared_data_->consumer.pid.load() == getpid()) {
+                shared_data_->consumer.heartbeat_ns = steadyNowNs();
+            }
+            if (worker_slot_ >= 0) {
+                shared_data_->worker_slots[worker_slot_].heartbeat_ns = steadyNowNs();
+            }
+        }
+        heartbeat_cond_.wait_for(lock, std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS));
+    }
+}
+
+size_t SharedMemoryManager::prefault() {
+    size_t pages = 0;
+    if (is_creator_ && shared_data_->producer.published_count.load(std::memory_order_acquire) == 0) {
+        // 標頭在創建時已寫入；圖像數據區與灰階平面尚無內容，以寫入觸碰，第一次寫入時不再需要配置分頁
+        const size_t header = shared_data_->layout.frame_offset;
+        pages += prefaultMemory(segmentAddress(), header, false);
+        pages += prefaultMemory(shared_data_->frameData(), segmentSize() - header, true);
+    } else {
+        pages = prefaultMemory(segmentAddress(), segmentSize(), false);
+    }
+    std::cout << "預先觸碰共享記憶體: " << pages << " 頁 (" << segmentSize() << " bytes)" << std::endl;
+    return pages;
+}
+
+void SharedMemoryManager::warmUpWriter(const cv::Mat& sample) {
+    if (!is_creator_ || sample.empty()) {
+        return;
+    }
+    if (sample.total() * sample.elemSize() > max_image_size_) {
+        std::cerr << "預熱用的合成幀超過共享記憶體容量，略過寫入路徑的預熱" << std::endl;
+        return;
+    }
+    
+    // 與 writeImage() 相同的順序：先算雜湊，再加鎖寫入數據區
+    if (contentHashWanted()) {
+        hashFrame(sample);
+    }
+    
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
+    if (shared_data_->producer.published_count.load(std::memory_order_acquire) != 0) {
+        // 消費者可能仍在讀取已發佈的幀，不能覆寫
+        std::cerr << "已發佈過幀，略過寫入路徑的預熱" << std::endl;
+        return;
+    }
+    
+    // 只寫入數據區，不更新幀標頭也不通知，消費者看不到這一幀
+    size_t payload_size = 0;
+    bool fuse_luma = false;
+    storePayload(sample, payload_size, fuse_luma);
+}
+
+void SharedMemoryManager::setPublishLuma(bool publish) {
+    publish_luma_ = publish;
     if (is_creator_) {
-        std::cout << "清理共享記憶體: " << name_ << std::endl;
-        remove(name_);
+        shared_data_->producer.publishes_luma.store(publish ? 1 : 0, std::memory_order_relaxed);
     }
 }
 
-bool SharedMemoryManager::writeImage(const cv::Mat& image) {
+void SharedMemoryManager::requestContentHash(bool request) {
+    if (is_creator_ || mode_ == SharedMemoryMode::MONITOR) {
+        return;
+    }
+    hash_requested_ = request;
+    // 多個工作進程共用同一個旗標，只設置不清除：其中一個停用快取時，其他工作進程可能仍需要
+    if (request || mode_ == SharedMemoryMode::OPEN) {
+        shared_data_->consumer.hash_requested.store(request ? 1 : 0, std::memory_order_relaxed);
+    }
+}
+
+void SharedMemoryManager::setReady(bool ready) {
+    if (mode_ == SharedMemoryMode::MONITOR) {
+        return;
+    }
+    ready_ = ready;
+    std::atomic<uint32_t>& flag = is_creator_ ? shared_data_->producer.ready : shared_data_->consumer.ready;
+    flag.store(ready ? 1 : 0, std::memory_order_release);
+}
+
+bool SharedMemoryManager::waitForConsumerReady(int timeout_ms) {
+    // 只在啟動時等待一次，輪詢即可
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!isConsumerReady()) {
+        if (timeout_ms >= 0 && std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool SharedMemoryManager::writeImage(const cv::Mat& image, int64_t capture_ns) {
     if (image.empty()) {
         std::cerr << "無法寫入空圖像" << std::endl;
         return false;
@@ -70,68 +695,340 @@ bool SharedMemoryManager::writeImage(const cv::Mat& image) {
         return false;
     }
     
+    // 內容雜湊在加鎖前計算，不延長消費者等待鎖的時間
+    const uint64_t content_hash = contentHashWanted() ? hashFrame(image) : 0;
+    
     // 獲取鎖
-    std::unique_lock<bip::interprocess_mutex> lock(shared_data_->mutex);
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
     
     // 更新共享記憶體中的圖像信息
-    shared_data_->width = image.cols;
-    shared_data_->height = image.rows;
-    shared_data_->channels = image.channels();
-    shared_data_->data_size = data_size;
+    shared_data_->producer.width = image.cols;
+    shared_data_->producer.height = image.rows;
+    shared_data_->producer.channels = image.channels();
+    shared_data_->producer.type = image.type();
+    shared_data_->producer.data_size = data_size;
+    shared_data_->producer.resolution_tier = static_cast<uint32_t>(resolution_tier_);
+    
+    // 幀序號與擷取時間；發佈時間在 notifyNewImage() 時填入
+    FrameInfo& frame = shared_data_->producer.frame;
+    frame.sequence = next_sequence_++;
+    frame.capture_ns = capture_ns != 0 ? capture_ns : steadyNowNs();
+    frame.publish_ns = 0;
+    frame.source_id = source_id_;
+    frame.content_hash = content_hash;
+    
+    size_t payload_size = 0;
+    bool fuse_luma = false;
+    const FrameEncoding encoding = storePayload(image, payload_size, fuse_luma);
     
-    // 複製圖像數據到共享記憶體
-    std::memcpy(shared_data_->image_data, image.data, data_size);
-    std::cout << "複製圖像到共享記憶體 (" << data_size << " bytes)" << std::endl;
+    shared_data_->producer.encoding = static_cast<uint32_t>(encoding);
+    shared_data_->producer.payload_size = payload_size;
+    shared_data_->producer.luma_valid = fuse_luma ? 1 : 0;
+    if (verbose_) std::cout << "複製圖像到共享記憶體 (" << frameEncodingName(encoding) << ", " << payload_size << " bytes)" << std::endl;
     
     return true;
 }
 
-cv::Mat SharedMemoryManager::readImage() {
+FrameEncoding SharedMemoryManager::storePayload(const cv::Mat& image, size_t& payload_size, bool& fuse_luma) {
+    char* dst = shared_data_->frameData();
+    const size_t data_size = image.total() * image.elemSize();
+    
+    // 依設定編碼；不支援或壓縮後放不下時退回原始格式
+    FrameEncoding encoding = encoding_;
+    payload_size = 0;
+    if (encoding != FrameEncoding::RAW) {
+        payload_size = encodeFrame(image, encoding, dst, max_image_size_, encode_workspace_);
+    }
+    
+    // 只有原始 BGR/BGRA 需要另外的灰階平面；YUV 編碼本身就帶有 Y 平面
+    fuse_luma = publish_luma_ && payload_size == 0 &&
+                (image.type() == CV_8UC3 || image.type() == CV_8UC4) &&
+                image.total() <= shared_data_->layout.luma_capacity;
+    
+    if (payload_size == 0) {
+        // 複製圖像數據到共享記憶體
+        encoding = FrameEncoding::RAW;
+        payload_size = data_size;
+        const size_t row_size = image.cols * image.elemSize();
+        if (fuse_luma) {
+            // 逐列複製，趁該列還在快取中時算出灰階，省下消費者端的一整趟轉換
+            uint8_t* luma = reinterpret_cast<uint8_t*>(shared_data_->lumaData());
+            for (int y = 0; y < image.rows; y++) {
+                const uint8_t* src = image.ptr<uint8_t>(y);
+                std::memcpy(dst + y * row_size, src, row_size);
+                if (image.channels() == 3) {
+                    frame_kernels::grayRow<uint8_t, 3>(src, luma + static_cast<size_t>(y) * image.cols, image.cols);
+                } else {
+                    frame_kernels::grayRow<uint8_t, 4>(src, luma + static_cast<size_t>(y) * image.cols, image.cols);
+                }
+            }
+        } else if (image.isContinuous()) {
+            std::memcpy(dst, image.data, data_size);
+        } else {
+            for (int y = 0; y < image.rows; y++) {
+                std::memcpy(dst + y * row_size, image.ptr(y), row_size);
+            }
+        }
+    }
+    return encoding;
+}
+
+cv::Mat SharedMemoryManager::readImage(cv::Mat* gray) {
     // 獲取鎖
-    std::unique_lock<bip::interprocess_mutex> lock(shared_data_->mutex);
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
+    
+    const SharedImageData::ProducerState& producer = shared_data_->producer;
+    if (producer.width == 0 || producer.height == 0 || producer.data_size == 0) {
+        return cv::Mat();
+    }
     
-    if (shared_data_->width == 0 || shared_data_->height == 0 || shared_data_->data_size == 0) {
+    // 記錄這一幀，處理完成時據此更新 consumed_count
+    if (!claimCurrentFrame()) {
         return cv::Mat();
     }
     
-    // 從共享記憶體創建cv::Mat對象
-    cv::Mat image(
-        shared_data_->height,
-        shared_data_->width,
-        CV_8UC3,  // 假設彩色圖像，如需支援其他格式，可根據channels值確定
-        shared_data_->image_data
-    );
+    // 依標頭的編碼解碼，類型由標頭決定；結果為獨立的複製以確保安全
+    cv::Mat image;
+    if (!decodeFrame(shared_data_->frameData(), producer.payload_size,
+                     static_cast<FrameEncoding>(producer.encoding),
+                     producer.height, producer.width, producer.type, image)) {
+        std::cerr << "解碼共享記憶體中的圖像失敗" << std::endl;
+        return cv::Mat();
+    }
+    
+    if (gray) {
+        // 與彩色圖在同一次加鎖中複製，確保兩者屬於同一幀
+        // 只取生產者算好的灰階平面（與 cvtColor 結果一致），YUV 的 Y 平面值域不同，不在此使用
+        gray->release();
+        if (producer.luma_valid) {
+            cv::Mat(producer.height, producer.width, CV_8UC1, shared_data_->lumaData()).copyTo(*gray);
+        }
+    }
     
-    return image.clone(); // 返回複製以確保安全
+    return image;
+}
+
+cv::Mat SharedMemoryManager::readGrayImage() {
+    cv::Mat luma = readLumaPlane(true);
+    if (!luma.empty()) {
+        return luma;
+    }
+    
+    // 其他編碼需要先解碼再轉換
+    cv::Mat image = readImage();
+    if (image.empty() || image.channels() == 1) {
+        return image;
+    }
+    
+    cv::Mat gray;
+    cv::cvtColor(image, gray, image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    return gray;
+}
+
+cv::Mat SharedMemoryManager::lumaPlaneView() {
+    // 工作進程讀取後生產者即可寫入下一幀，不能交出指向共享記憶體的視圖
+    return readLumaPlane(mode_ == SharedMemoryMode::WORKER);
+}
+
+cv::Mat SharedMemoryManager::readLumaPlane(bool copy) {
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
+    
+    const SharedImageData::ProducerState& producer = shared_data_->producer;
+    if (producer.width == 0 || producer.height == 0 || producer.payload_size == 0) {
+        return cv::Mat();
+    }
+    
+    cv::Mat luma;
+    if (producer.luma_valid) {
+        // 生產者預先算好的灰階平面
+        luma = cv::Mat(producer.height, producer.width, CV_8UC1, shared_data_->lumaData());
+        if (copy) {
+            luma = luma.clone();
+        }
+    } else if (!decodeLuma(shared_data_->frameData(), producer.payload_size,
+                           static_cast<FrameEncoding>(producer.encoding), producer.height, producer.width, luma)) {
+        // 不是 YUV 編碼，或 payload 不完整
+        return cv::Mat();
+    }
+    if (!claimCurrentFrame()) {
+        return cv::Mat();
+    }
+    return luma;
+}
+
+bool SharedMemoryManager::frameAvailable() const {
+    return mode_ == SharedMemoryMode::WORKER ? shared_data_->frameClaimable() : shared_data_->newImageReady();
+}
+
+bool SharedMemoryManager::claimCurrentFrame() {
+    const FrameInfo& frame = shared_data_->producer.frame;
+    if (claimed_count_ != 0 && frame.sequence == current_frame_.sequence) {
+        // 同一幀在處理期間再次讀取（例如先取灰階平面再讀彩色圖），不重複計數
+        return true;
+    }
+    
+    const uint64_t published = shared_data_->producer.published_count.load(std::memory_order_acquire);
+    if (mode_ == SharedMemoryMode::WORKER && shared_data_->consumer.claimed_count.load() == published) {
+        // 已被其他工作進程讀取（持有鎖，不會與其他工作進程同時判斷）
+        return false;
+    }
+    shared_data_->consumer.claimed_count.store(published, std::memory_order_release);
+    
+    claimed_count_ = published;
+    claim_time_ = std::chrono::steady_clock::now();
+    current_frame_ = frame;
+    current_tier_ = static_cast<int>(shared_data_->producer.resolution_tier);
+    
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+    FrameTransportStats& stats = transport_stats_;
+    stats.frames++;
+    if (frame.publish_ns != 0) {
+        const double transport_ms = (steadyNowNs() - frame.publish_ns) / 1e6;
+        stats.avg_transport_ms += (transport_ms - stats.avg_transport_ms) / stats.frames;
+    }
+    
+    // 依序號判斷漏接、重複與亂序
+    const uint64_t sequence = frame.sequence;
+    if (sequence == 0 || last_sequence_ == 0) {
+        last_sequence_ = std::max(last_sequence_, sequence);
+        return true;
+    }
+    if (sequence == last_sequence_) {
+        stats.duplicates++;
+    } else if (sequence < last_sequence_) {
+        stats.reordered++;
+    } else {
+        // 工作進程之間輪流取幀，序號跳號是正常的，不計為漏接
+        if (sequence > last_sequence_ + 1 && mode_ != SharedMemoryMode::WORKER) {
+            stats.gaps++;
+            stats.missed += sequence - last_sequence_ - 1;
+            shared_data_->consumer.missed_frames.fetch_add(sequence - last_sequence_ - 1, std::memory_order_relaxed);
+        }
+        last_sequence_ = sequence;
+    }
+    return true;
+}
+
+void SharedMemoryManager::recordCompletion() {
+    if (current_frame_.capture_ns == 0) {
+        return;
+    }
+    
+    const double latency_ms = (steadyNowNs() - current_frame_.capture_ns) / 1e6;
+    
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+    FrameTransportStats& stats = transport_stats_;
+    const bool first = stats.avg_latency_ms == 0;
+    stats.last_latency_ms = latency_ms;
+    stats.max_latency_ms = std::max(stats.max_latency_ms, latency_ms);
+    // 與處理時間相同，以權重 1/8 的移動平均發佈給生產者與監控端
+    stats.avg_latency_ms = first ? latency_ms : stats.avg_latency_ms + (latency_ms - stats.avg_latency_ms) / 8;
+    if (late_threshold_ms_ > 0 && latency_ms > late_threshold_ms_) {
+        stats.late++;
+        shared_data_->consumer.late_frames.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    SharedImageData::ConsumerState& consumer = shared_data_->consumer;
+    consumer.latency_us.store(static_cast<uint32_t>(stats.avg_latency_ms * 1000), std::memory_order_relaxed);
+    consumer.last_sequence.store(current_frame_.sequence, std::memory_order_relaxed);
+}
+
+FrameTransportStats SharedMemoryManager::transportStats() const {
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+    return transport_stats_;
+}
+
+ConsumerFeedback SharedMemoryManager::consumerFeedback() const {
+    const SharedImageData::ConsumerState& consumer = shared_data_->consumer;
+    ConsumerFeedback feedback;
+    // 各工作進程分別處理不同的幀：處理時間取平均，排隊的工作數相加
+    const int64_t now_ns = steadyNowNs();
+    uint64_t service_sum_us = 0;
+    uint32_t measured = 0;
+    for (const auto& slot : shared_data_->worker_slots) {
+        if (!workerSlotLive(slot, now_ns)) continue;
+        const uint32_t service_us = slot.service_time_us.load(std::memory_order_relaxed);
+        if (service_us != 0) {
+            service_sum_us += service_us;
+            measured++;
+        }
+        feedback.queue_depth += slot.queue_depth.load(std::memory_order_relaxed);
+    }
+    feedback.service_time_ms = measured > 0 ? service_sum_us / 1000.0 / measured : 0;
+    feedback.workers = std::max<uint32_t>(1, consumer.worker_count.load(std::memory_order_relaxed));
+    // 多個工作進程時，最新的幀一被讀取就可以寫入下一幀，其他工作進程可以並行處理
+    feedback.busy = feedback.workers > 1 ? shared_data_->frameClaimable() : shared_data_->newImageReady();
+    feedback.alive = isConsumerAlive();
+    return feedback;
+}
+
+SegmentMetrics SharedMemoryManager::segmentMetrics() const {
+    const SharedImageData::ProducerState& producer = shared_data_->producer;
+    const SharedImageData::ConsumerState& consumer = shared_data_->consumer;
+    SegmentMetrics metrics;
+    metrics.published = producer.published_count.load(std::memory_order_acquire);
+    metrics.consumed = consumer.consumed_count.load(std::memory_order_acquire);
+    metrics.missed_frames = consumer.missed_frames.load(std::memory_order_relaxed);
+    metrics.late_frames = consumer.late_frames.load(std::memory_order_relaxed);
+    metrics.cache_hits = consumer.cache_hits.load(std::memory_order_relaxed);
+    metrics.cache_bytes_saved = consumer.cache_bytes_saved.load(std::memory_order_relaxed);
+    metrics.publish_interval_ms = producer.publish_interval_us.load(std::memory_order_relaxed) / 1000.0;
+    metrics.latency_ms = consumer.latency_us.load(std::memory_order_relaxed) / 1000.0;
+    const int64_t now_ns = steadyNowNs();
+    for (const auto& slot : shared_data_->worker_slots) {
+        if (!workerSlotLive(slot, now_ns)) continue;
+        WorkerMetrics worker;
+        worker.pid = slot.pid.load(std::memory_order_relaxed);
+        worker.service_time_ms = slot.service_time_us.load(std::memory_order_relaxed) / 1000.0;
+        worker.queue_depth = slot.queue_depth.load(std::memory_order_relaxed);
+        metrics.worker_metrics.push_back(worker);
+    }
+    metrics.workers = consumer.worker_count.load(std::memory_order_relaxed);
+    metrics.producer_alive = isProducerAlive();
+    metrics.consumer_alive = isConsumerAlive();
+    metrics.producer_ready = isProducerReady();
+    metrics.consumer_ready = isConsumerReady();
+    return metrics;
 }
 
 void SharedMemoryManager::notifyNewImage() {
-    std::unique_lock<bip::interprocess_mutex> lock(shared_data_->mutex);
-    shared_data_->new_image_ready = true;
-    shared_data_->processing_done = false;
-    std::cout << "通知處理進程開始工作" << std::endl;
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
+    const int64_t now_ns = steadyNowNs();
+    if (last_publish_ns_ != 0) {
+        // 發佈間隔的移動平均 (權重 1/8)，監督程式據此估計需要的工作進程數
+        const double interval_us = (now_ns - last_publish_ns_) / 1000.0;
+        publish_interval_us_ = publish_interval_us_ == 0 ? interval_us
+                                                         : publish_interval_us_ + (interval_us - publish_interval_us_) / 8;
+        shared_data_->producer.publish_interval_us.store(static_cast<uint32_t>(publish_interval_us_),
+                                                         std::memory_order_relaxed);
+    }
+    last_publish_ns_ = now_ns;
+    shared_data_->producer.frame.publish_ns = now_ns;
+    shared_data_->producer.published_count.fetch_add(1, std::memory_order_release);
+    if (verbose_) std::cout << "通知處理進程開始工作" << std::endl;
     shared_data_->new_image_cond.notify_one();
+    signalEvent();
 }
 
 bool SharedMemoryManager::waitForNewImage(int timeout_ms) {
-    std::unique_lock<bip::interprocess_mutex> lock(shared_data_->mutex);
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
     
-    std::cout << "等待新圖像..." << std::endl;
+    if (verbose_) std::cout << "等待新圖像..." << std::endl;
     
     if (timeout_ms < 0) {
         // 無限等待
-        while (!shared_data_->new_image_ready) {
+        while (!frameAvailable()) {
             shared_data_->new_image_cond.wait(lock);
         }
         return true;
     } else {
         // 有超時限制的等待
-        auto now = std::chrono::system_clock::now();
+        auto now = std::chrono::steady_clock::now();
         auto end_time = now + std::chrono::milliseconds(timeout_ms);
         
-        while (!shared_data_->new_image_ready) {
-            if (shared_data_->new_image_cond.timed_wait(lock, end_time)) {
-                if (shared_data_->new_image_ready) {
+        while (!frameAvailable()) {
+            if (shared_data_->new_image_cond.wait_until(lock, end_time)) {
+                if (frameAvailable()) {
                     return true;
                 }
             } else {
@@ -144,32 +1041,56 @@ bool SharedMemoryManager::waitForNewImage(int timeout_ms) {
 }
 
 void SharedMemoryManager::notifyProcessingDone() {
-    std::unique_lock<bip::interprocess_mutex> lock(shared_data_->mutex);
-    shared_data_->new_image_ready = false;
-    shared_data_->processing_done = true;
-    std::cout << "通知讀取進程處理完成" << std::endl;
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
+    // 只標記已讀取的那一幀；處理期間若有更新的幀，仍保持「有新圖像」
+    uint64_t done = claimed_count_ != 0 ? claimed_count_
+                                        : shared_data_->producer.published_count.load(std::memory_order_acquire);
+    if (mode_ == SharedMemoryMode::WORKER) {
+        // 工作進程可能比讀取較新幀的其他工作進程晚完成，consumed_count 只增不減
+        std::atomic<uint64_t>& consumed = shared_data_->consumer.consumed_count;
+        uint64_t current = consumed.load(std::memory_order_acquire);
+        while (claimed_count_ != 0 && current < done &&
+               !consumed.compare_exchange_weak(current, done, std::memory_order_release)) {
+        }
+    } else {
+        shared_data_->consumer.consumed_count.store(done, std::memory_order_release);
+    }
+    if (claimed_count_ != 0) {
+        // 更新處理時間的移動平均 (權重 1/8)，生產者據此調節發佈速率
+        const double elapsed_us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - claim_time_).count();
+        service_time_us_ = service_time_us_ == 0 ? elapsed_us : service_time_us_ + (elapsed_us - service_time_us_) / 8;
+        if (worker_slot_ >= 0) {
+            shared_data_->worker_slots[worker_slot_].service_time_us.store(static_cast<uint32_t>(service_time_us_),
+                                                                            std::memory_order_relaxed);
+        }
+        recordCompletion();
+    }
+    claimed_count_ = 0;
+    if (verbose_) std::cout << "通知讀取進程處理完成" << std::endl;
     shared_data_->processing_done_cond.notify_one();
+    signalEvent();
 }
 
 bool SharedMemoryManager::waitForProcessingDone(int timeout_ms) {
-    std::unique_lock<bip::interprocess_mutex> lock(shared_data_->mutex);
+    std::unique_lock<RobustMutex> lock(shared_data_->mutex);
     
-    std::cout << "等待處理完成..." << std::endl;
+    if (verbose_) std::cout << "等待處理完成..." << std::endl;
     
     if (timeout_ms < 0) {
         // 無限等待
-        while (!shared_data_->processing_done) {
+        while (!shared_data_->processingDone()) {
             shared_data_->processing_done_cond.wait(lock);
         }
         return true;
     } else {
         // 有超時限制的等待
-        auto now = std::chrono::system_clock::now();
+        auto now = std::chrono::steady_clock::now();
         auto end_time = now + std::chrono::milliseconds(timeout_ms);
         
-        while (!shared_data_->processing_done) {
-            if (shared_data_->processing_done_cond.timed_wait(lock, end_time)) {
-                if (shared_data_->processing_done) {
+        while (!shared_data_->processingDone()) {
+            if (shared_data_->processing_done_cond.wait_until(lock, end_time)) {
+                if (shared_data_->processingDone()) {
                     return true;
                 }
             } else {
@@ -181,6 +1102,89 @@ bool SharedMemoryManager::waitForProcessingDone(int timeout_ms) {
     }
 }
 
+void SharedMemoryManager::signalEvent() {
+    // 沒有訂閱者時只讀取標頭，不進入核心
+    for (auto& subscriber : shared_data_->event_subscribers) {
+        const uint64_t token = subscriber.load(std::memory_order_acquire);
+        if (token == 0 || token == event_token_) {
+            continue;
+        }
+        sockaddr_un address;
+        const socklen_t length = eventAddress(name_, token, address);
+        const char byte = 0;
+        if (sendto(notifySocket(), &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL,
+                   reinterpret_cast<const sockaddr*>(&address), length) < 0 && errno == ECONNREFUSED) {
+            // 訂閱者的進程已結束，socket 隨之消失
+            uint64_t expected = token;
+            subscriber.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+        }
+        // EAGAIN：對方的接收緩衝區已滿，表示它已經有未處理的通知
+    }
+}
+
+bool SharedMemoryManager::subscribeEvents(SharedImageData* data) {
+    for (auto& subscriber : data->event_subscribers) {
+        uint64_t expected = 0;
+        if (subscriber.compare_exchange_strong(expected, event_token_, std::memory_order_acq_rel)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SharedMemoryManager::unsubscribeEvents(SharedImageData* data) {
+    if (event_token_ == 0) {
+        return;
+    }
+    for (auto& subscriber : data->event_subscribers) {
+        uint64_t expected = event_token_;
+        subscriber.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+    }
+}
+
+int SharedMemoryManager::eventFd() {
+    std::lock_guard<std::mutex> lock(event_mutex_);
+    if (event_fd_ >= 0) {
+        return event_fd_;
+    }
+    
+    static std::atomic<uint32_t> next_local_id{1};
+    event_token_ = static_cast<uint64_t>(getpid()) << 32 | next_local_id.fetch_add(1);
+    
+    event_fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (event_fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "無法建立事件 socket");
+    }
+    sockaddr_un address;
+    const socklen_t length = eventAddress(name_, event_token_, address);
+    if (bind(event_fd_, reinterpret_cast<const sockaddr*>(&address), length) < 0) {
+        const int err = errno;
+        close(event_fd_);
+        event_fd_ = -1;
+        throw std::system_error(err, std::generic_category(), "無法綁定事件 socket");
+    }
+    
+    if (!subscribeEvents(shared_data_)) {
+        std::cerr << "事件訂閱表已滿，改為定期檢查" << std::endl;
+        close(event_fd_);
+        event_fd_ = -1;
+        event_token_ = 0;
+    }
+    return event_fd_;
+}
+
+SegmentAwaiter SharedMemoryManager::nextFrame(FrameReactor& reactor, int timeout_ms) {
+    // 每次都經由 this 讀取，重新連接後仍指向新的共享記憶體
+    return SegmentAwaiter(reactor, [this] { return hasNewImage(); }, timeout_ms, eventFd());
+}
+
+SegmentAwaiter SharedMemoryManager::processingDone(FrameReactor& reactor, int timeout_ms) {
+    return SegmentAwaiter(reactor, [this] { return isProcessingDone(); }, timeout_ms, eventFd());
+}
+
 bool SharedMemoryManager::remove(const std::string& name) {
+    if (isMemfdName(name)) {
+        return SegmentBroker::removeSocket(memfdSocketName(name));
+    }
     return bip::shared_memory_object::remove(name.c_str());
 }
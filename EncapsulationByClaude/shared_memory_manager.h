@@ -1,73 +1,467 @@
 // shared_memory_manager.h
 #pragma once
 
+#include "robust_sync.h"
+#include "frame_reactor.h"
+#include "frame_codec.h"
+#include "frame_info.h"
+#include "memfd_segment.h"
+#include "warm_start.h"
 #include <boost/interprocess/shared_memory_object.hpp>
 #include <boost/interprocess/mapped_region.hpp>
-#include <boost/interprocess/sync/interprocess_mutex.hpp>
-#include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <memory>
+#include <thread>
+#include <vector>
 
 namespace bip = boost::interprocess;
 
+// 共享記憶體標頭的識別碼與版本
+constexpr uint32_t SHM_MAGIC = 0x46435049;   // "IPCF"
+constexpr uint32_t SHM_VERSION = 14;
+// 快取行大小，生產者與消費者的欄位分開放在不同的快取行上
+constexpr size_t CACHE_LINE_SIZE = 64;
+// 圖像數據的最小對齊 (實際對齊到分頁大小，方便零複製映射)
+constexpr size_t FRAME_ALIGNMENT = 64;
+// 標頭中事件訂閱表的格數（呼叫過 eventFd() 的連接數上限）
+constexpr size_t MAX_EVENT_SUBSCRIBERS = 16;
+// 標頭中各消費者連接（工作進程）回報指標的格數
+constexpr size_t MAX_WORKER_SLOTS = 16;
+
 // 共享記憶體中的數據結構
+// 圖像數據不再放在結構體尾端的柔性數組中，而是位於 layout.frame_offset 處
 struct SharedImageData {
-    bool new_image_ready;          // 表示有新圖像
-    bool processing_done;          // 表示處理完成
-    size_t width;                  // 圖像寬度
-    size_t height;                 // 圖像高度
-    size_t channels;               // 圖像通道數
-    size_t data_size;              // 圖像數據大小
-    bip::interprocess_mutex mutex; // 互斥鎖
-    bip::interprocess_condition new_image_cond;   // 條件變數：有新圖像
-    bip::interprocess_condition processing_done_cond;  // 條件變數：處理完成
-    char image_data[0];            // 柔性數組成員，存儲實際圖像數據
+    // 版面資訊：創建後唯讀
+    struct alignas(CACHE_LINE_SIZE) Layout {
+        uint32_t magic;                // 識別碼
+        uint32_t version;              // 版本
+        uint32_t header_size;          // 標頭大小
+        uint32_t abi_tag;              // 同步原語與欄位大小的組合，用於 ABI 檢查
+        uint64_t frame_offset;         // 圖像數據相對於標頭起點的位移
+        uint64_t frame_capacity;       // 圖像數據區大小
+        uint64_t luma_offset;          // 灰階平面相對於標頭起點的位移
+        uint64_t luma_capacity;        // 灰階平面大小
+        uint64_t generation;           // 世代計數，每次重建共享記憶體時遞增
+    } layout;
+
+    // 生產者擁有的欄位：只有生產者寫入
+    struct alignas(CACHE_LINE_SIZE) ProducerState {
+        std::atomic<uint64_t> published_count;   // 已發佈的幀數
+        uint32_t width;                          // 圖像寬度
+        uint32_t height;                         // 圖像高度
+        uint32_t channels;                       // 圖像通道數
+        int32_t type;                            // OpenCV 圖像類型
+        uint64_t data_size;                      // 圖像數據大小 (解碼後)
+        uint32_t encoding;                       // 幀數據的編碼方式 (FrameEncoding)
+        uint64_t payload_size;                   // 共享記憶體中實際存放的位元組數
+        uint32_t luma_valid;                     // 灰階平面是否對應目前這一幀
+        uint32_t resolution_tier;                // 解析度層級：寬高各縮小 2^tier 倍 (0 為原始解析度)
+        FrameInfo frame;                         // 目前這一幀的序號、時間戳與來源
+        std::atomic<uint32_t> publish_interval_us;  // 發佈間隔的移動平均
+        std::atomic<int32_t> pid;                // 生產者 (創建者) 進程 ID
+        std::atomic<int64_t> heartbeat_ns;       // 生產者心跳 (steady_clock, 奈秒)
+        std::atomic<uint32_t> ready;             // 生產者已完成預熱
+        std::atomic<uint32_t> publishes_luma;    // 生產者會發佈灰階平面，消費者預熱時一併預熱灰階輸入的路徑
+    } producer;
+
+    // 消費者擁有的欄位：只有消費者寫入
+    struct alignas(CACHE_LINE_SIZE) ConsumerState {
+        std::atomic<uint64_t> consumed_count;    // 已處理完成的幀數 (對應 published_count)
+        std::atomic<uint64_t> claimed_count;     // 已被消費者讀取的幀數 (對應 published_count)
+        std::atomic<uint32_t> worker_count;      // 以 WORKER 模式連接的工作進程數
+        std::atomic<int32_t> pid;                // 消費者進程 ID
+        std::atomic<int64_t> heartbeat_ns;       // 消費者心跳 (steady_clock, 奈秒)
+        std::atomic<uint32_t> attach_count;      // 消費者連接次數
+        std::atomic<uint32_t> latency_us;        // 端到端延遲 (擷取到處理完成) 的移動平均
+        std::atomic<uint64_t> last_sequence;     // 最後處理完成的幀序號
+        std::atomic<uint64_t> missed_frames;     // 序號跳號累計的漏接幀數
+        std::atomic<uint64_t> late_frames;       // 端到端延遲超過門檻的幀數
+        std::atomic<uint64_t> cache_hits;        // 內容相同而使用快取結果的幀數
+        std::atomic<uint64_t> cache_bytes_saved; // 命中快取而省下處理的圖像位元組數
+        std::atomic<uint32_t> ready;             // 消費者 (任一工作進程) 已完成預熱
+        std::atomic<uint32_t> hash_requested;    // 消費者 (任一工作進程) 需要幀標頭中的內容雜湊
+    } consumer;
+
+    // 各消費者連接自己的指標：多個工作進程各寫一格，不互相覆寫；讀取端彙總心跳未逾時的格子
+    struct alignas(CACHE_LINE_SIZE) WorkerSlot {
+        std::atomic<int32_t> pid;                // 佔用此格的進程 ID，0 為空格
+        std::atomic<int64_t> heartbeat_ns;       // 心跳 (steady_clock, 奈秒)，逾時的格子可被其他連接取代
+        std::atomic<uint32_t> service_time_us;   // 每幀處理時間 (讀取到處理完成) 的移動平均，供生產者調節速率
+        std::atomic<uint32_t> queue_depth;       // 尚待完成的工作數 (例如排隊中的回調)
+    } worker_slots[MAX_WORKER_SLOTS];
+
+    // 同步原語：雙方都會修改，獨立放在自己的快取行上
+    alignas(CACHE_LINE_SIZE) RobustMutex mutex;                  // 互斥鎖（持有者崩潰時可恢復）
+    alignas(CACHE_LINE_SIZE) RobustCondition new_image_cond;     // 條件變數：有新圖像
+    alignas(CACHE_LINE_SIZE) RobustCondition processing_done_cond; // 條件變數：處理完成
+    // 事件訂閱表：每格為一個連接的通知 socket 編號 (進程 ID << 32 | 進程內編號)，0 為空格
+    // 條件變數無法放進 epoll，發佈或處理完成時改由發出通知的一方直接寫入各訂閱者的 socket
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> event_subscribers[MAX_EVENT_SUBSCRIBERS];
+
+    // 有新圖像尚未處理
+    bool newImageReady() const {
+        return producer.published_count.load(std::memory_order_acquire) !=
+               consumer.consumed_count.load(std::memory_order_acquire);
+    }
+
+    // 所有已發佈的圖像都已處理完成
+    bool processingDone() const { return !newImageReady(); }
+    
+    // 最新的圖像尚未被任何消費者讀取
+    bool frameClaimable() const {
+        return producer.published_count.load(std::memory_order_acquire) !=
+               consumer.claimed_count.load(std::memory_order_acquire);
+    }
+
+    // 圖像數據起點
+    char* frameData() { return reinterpret_cast<char*>(this) + layout.frame_offset; }
+    const char* frameData() const { return reinterpret_cast<const char*>(this) + layout.frame_offset; }
+    
+    // 灰階平面起點
+    char* lumaData() { return reinterpret_cast<char*>(this) + layout.luma_offset; }
+    const char* lumaData() const { return reinterpret_cast<const char*>(this) + layout.luma_offset; }
+};
+
+// ABI 標記：結構體與同步原語的大小改變時隨之改變
+constexpr uint32_t SHM_ABI_TAG =
+    static_cast<uint32_t>(sizeof(SharedImageData)) << 16 ^
+    static_cast<uint32_t>(sizeof(RobustMutex)) << 8 ^
+    static_cast<uint32_t>(sizeof(RobustCondition)) ^
+    static_cast<uint32_t>(sizeof(size_t)) << 28;
+
+static_assert(offsetof(SharedImageData, producer) % CACHE_LINE_SIZE == 0, "生產者欄位必須對齊快取行");
+static_assert(offsetof(SharedImageData, consumer) - offsetof(SharedImageData, producer) >= CACHE_LINE_SIZE,
+              "生產者與消費者欄位不可共用快取行");
+
+// 消費者回報給生產者的狀態，用於速率控制
+struct ConsumerFeedback {
+    double service_time_ms = 0;   // 每幀處理時間的移動平均（多個工作進程時取平均），尚無量測時為 0
+    uint32_t queue_depth = 0;     // 消費者端排隊中的工作數（各工作進程的總和）
+    bool busy = false;            // 目前是否仍有已發佈但未處理完成的幀（多個工作進程時為尚未被讀取的幀）
+    bool alive = false;           // 消費者是否存活
+    uint32_t workers = 1;         // 共同消費的工作進程數
+};
+
+// 單一消費者連接（工作進程）回報的指標
+struct WorkerMetrics {
+    int32_t pid = 0;
+    double service_time_ms = 0;       // 每幀處理時間的移動平均，尚無量測時為 0
+    uint32_t queue_depth = 0;         // 排隊中的工作數
+};
+
+// 共享記憶體中的運行指標，供監督程式決定工作進程數
+struct SegmentMetrics {
+    uint64_t published = 0;           // 已發佈的幀數
+    uint64_t consumed = 0;            // 已處理完成的幀數
+    uint64_t missed_frames = 0;       // 消費者回報的漏接幀數
+    uint64_t late_frames = 0;         // 消費者回報的遲到幀數
+    uint64_t cache_hits = 0;          // 消費者使用快取結果的幀數
+    uint64_t cache_bytes_saved = 0;   // 命中快取而省下處理的位元組數
+    double publish_interval_ms = 0;   // 發佈間隔的移動平均
+    double latency_ms = 0;            // 端到端延遲的移動平均
+    std::vector<WorkerMetrics> worker_metrics;  // 心跳未逾時的各消費者連接，由使用端彙總
+    uint32_t workers = 0;             // 工作進程數
+    bool producer_alive = false;      // 生產者是否存活
+    bool consumer_alive = false;      // 消費者是否存活
+    bool producer_ready = false;      // 生產者是否已完成預熱
+    bool consumer_ready = false;      // 消費者是否已完成預熱
+};
+
+// 消費者端依幀序號與時間戳計算的傳輸統計
+struct FrameTransportStats {
+    uint64_t frames = 0;            // 讀取的幀數
+    uint64_t gaps = 0;              // 序號跳號的次數
+    uint64_t missed = 0;            // 跳號累計的漏接幀數（未讀取就被覆寫）
+    uint64_t duplicates = 0;        // 重複讀取到已處理過的幀
+    uint64_t reordered = 0;         // 序號倒退的次數
+    uint64_t late = 0;              // 端到端延遲超過門檻的幀數
+    double last_latency_ms = 0;     // 最近一幀從擷取到處理完成的延遲
+    double avg_latency_ms = 0;      // 平均端到端延遲
+    double max_latency_ms = 0;      // 最大端到端延遲
+    double avg_transport_ms = 0;    // 平均傳輸延遲（發佈到讀取）
 };
 
 enum class SharedMemoryMode {
-    CREATE, // 創建新的共享記憶體
-    OPEN    // 打開已存在的共享記憶體
+    CREATE,  // 創建新的共享記憶體（若舊的已無人使用則自動回收）
+    OPEN,    // 打開已存在的共享記憶體，作為唯一的消費者（接手先前的消費者）
+    WORKER,  // 以工作進程身份打開，多個工作進程共同消費，每幀只由最先讀取的工作進程處理
+    MONITOR  // 只讀取狀態與指標，不登記為消費者（例如監督程式）
 };
 
 class SharedMemoryManager {
 public:
+    // 心跳更新間隔
+    static constexpr int HEARTBEAT_INTERVAL_MS = 100;
+    // 超過此時間沒有心跳即視為失效
+    static constexpr int HEARTBEAT_TIMEOUT_MS = 1000;
+
     // 建構函數
-    SharedMemoryManager(const std::string& name, SharedMemoryMode mode, size_t max_image_size = 1920 * 1080 * 3);
-    
+    // name 以 "memfd:" 開頭時改用 memfd 後端：生產者建立匿名的 memfd 並由本機代理經 Unix socket 交給消費者，
+    // 不使用 /dev/shm 中的具名物件；memfd_options 只在此後端的生產者端使用
+    SharedMemoryManager(const std::string& name, SharedMemoryMode mode, size_t max_image_size = 1920 * 1080 * 3,
+                        const MemfdOptions& memfd_options = MemfdOptions());
+
     // 解構函數 - 清理資源
     ~SharedMemoryManager();
+
+    // 寫入圖像到共享記憶體，並指派下一個幀序號
+    // capture_ns 為擷取時間 (steady_clock, 奈秒)，0 表示以寫入時間為準
+    bool writeImage(const cv::Mat& image, int64_t capture_ns = 0);
+    
+    // 生產者：寫入幀標頭的來源編號
+    void setSourceId(uint32_t source_id) { source_id_ = source_id; }
+
+    // 從共享記憶體讀取圖像（依幀標頭的編碼解碼）
+    // gray 不為空時，若生產者發布了灰階平面，在同一次加鎖中一併複製出來（否則清空 gray）
+    // WORKER 模式下這一幀已被其他工作進程讀取時回傳空
+    cv::Mat readImage(cv::Mat* gray = nullptr);
+    
+    // 讀取灰階圖：YUV 編碼由 Y 平面擴展值域而得，不必先解碼為彩色
+    cv::Mat readGrayImage();
+    
+    // 讀取灰階平面：生產者預先算好的灰階平面為零複製的視圖，在 notifyProcessingDone() 前有效
+    // YUV 編碼的 Y 平面是有限值域，轉換為完整值域的複製；兩者皆無時回傳空
+    // WORKER 模式下生產者在讀取後即可覆寫，因此一律回傳複製
+    cv::Mat lumaPlaneView();
+    
+    // 生產者：寫入時順便計算灰階平面，存放在彩色數據旁，多個消費者不必各自轉換
+    // 設置記錄在標頭中，消費者可在第一幀之前經由 producerPublishesLuma() 得知
+    void setPublishLuma(bool publish);
+    
+    // 消費者：生產者是否設置了發佈灰階平面（預熱時決定是否預熱灰階輸入的路徑）
+    bool producerPublishesLuma() const {
+        return shared_data_->producer.publishes_luma.load(std::memory_order_relaxed) != 0;
+    }
+    
+    // 生產者：發佈時一律計算內容雜湊並寫入幀標頭（預設關閉，只在消費者經由 requestContentHash() 要求時計算）
+    void setContentHash(bool enable) { content_hash_ = enable; }
+    
+    // 消費者：在標頭中要求生產者計算內容雜湊（例如啟用結果快取時），重新連接後在新的標頭中重新要求
+    void requestContentHash(bool request);
+    
+    // 生產者：之後寫入的幀所屬的解析度層級（由呼叫端先縮小圖像），記錄在幀標頭中
+    void setResolutionTier(int tier) { resolution_tier_ = tier; }
     
-    // 寫入圖像到共享記憶體
-    bool writeImage(const cv::Mat& image);
+    // 消費者：目前讀取的這一幀的解析度層級（與 frameInfo() 同時取得），座標乘上 2^tier 即為原始解析度
+    int frameResolutionTier() const { return current_tier_; }
     
-    // 從共享記憶體讀取圖像
-    cv::Mat readImage();
+    // 消費者：目前讀取的這一幀的序號、時間戳與來源（readImage() 或 lumaPlaneView() 時取得）
+    FrameInfo frameInfo() const { return current_frame_; }
     
+    // 是否輸出每幀的訊息（寫入、通知、等待）；預設關閉，建立、連接與清理等訊息一律輸出
+    void setVerbose(bool verbose) { verbose_ = verbose; }
+    
+    // 消費者：端到端延遲超過此值 (毫秒) 的幀計為遲到
+    void setLateThreshold(double threshold_ms) { late_threshold_ms_ = threshold_ms; }
+    
+    // 消費者：漏接、重複、亂序與遲到的統計
+    FrameTransportStats transportStats() const;
+    
+    // 生產者：讀取消費者回報的處理時間與佇列深度（無鎖讀取）
+    ConsumerFeedback consumerFeedback() const;
+    
+    // 讀取運行指標（無鎖讀取，任何模式皆可）
+    SegmentMetrics segmentMetrics() const;
+    
+    // 消費者：回報自己尚待完成的工作數，生產者據此放慢速度
+    void reportQueueDepth(uint32_t depth);
+    
+    // 消費者：回報一次結果快取命中（多個工作進程時累加）
+    void reportCacheHit(uint64_t bytes_saved) {
+        shared_data_->consumer.cache_hits.fetch_add(1, std::memory_order_relaxed);
+        shared_data_->consumer.cache_bytes_saved.fetch_add(bytes_saved, std::memory_order_relaxed);
+    }
+    
+    // 生產者：設置寫入時使用的編碼（圖像格式不支援時該幀退回 RAW）
+    void setEncoding(FrameEncoding encoding) { encoding_ = encoding; }
+    FrameEncoding encoding() const { return encoding_; }
+
     // 通知有新圖像可處理
     void notifyNewImage();
-    
+
     // 等待新圖像
     bool waitForNewImage(int timeout_ms = -1);
-    
+
     // 通知圖像處理完成
     void notifyProcessingDone();
-    
+
     // 等待圖像處理完成
     bool waitForProcessingDone(int timeout_ms = -1);
+
+    // 是否有尚未處理的新圖像（無鎖讀取）；WORKER 模式下為尚未被其他工作進程讀取的圖像
+    bool hasNewImage() const { return frameAvailable(); }
     
-    // 移除共享記憶體（靜態方法）
-    static bool remove(const std::string& name);
+    // 所有已發佈的圖像是否都已處理完成（無鎖讀取）
+    bool isProcessingDone() const { return shared_data_->processingDone(); }
+    
+    // 共享記憶體狀態可能改變（發佈、處理完成、重新連接）時變為可讀的 fd，可登記到 epoll
+    // 第一次呼叫時建立本連接的通知 socket 並登記到標頭的訂閱表，對方進程發出通知時直接寫入；fd 由本物件擁有
+    // 訂閱表已滿時回傳 -1，反應器退回定期檢查
+    int eventFd();
+    
+    // 協程介面：co_await nextFrame(reactor) 等待新圖像，反應器直接等待 eventFd()，不佔用執行緒
+    // 結果為 false 表示超時
+    SegmentAwaiter nextFrame(FrameReactor& reactor, int timeout_ms = -1);
+    
+    // 協程介面：co_await processingDone(reactor) 等待處理完成
+    SegmentAwaiter processingDone(FrameReactor& reactor, int timeout_ms = -1);
+    
+    // 生產者是否仍存活（進程存在且心跳未逾時）
+    bool isProducerAlive() const;
+
+    // 消費者是否仍存活
+    bool isConsumerAlive() const;
+
+    // 消費者端：若生產者已重啟並重建了共享記憶體，重新連接到新的共享記憶體
+    // 回傳 true 表示已切換到新的世代，之前取得的 getData() 指針失效
+    bool reattachIfStale();
+
+    // 當前連接的世代
+    uint64_t generation() const { return generation_; }
+    
+    // 預先觸碰整個映射區域，第一幀不必承擔分頁錯誤；回傳觸碰的分頁數
+    // 生產者以寫入觸碰圖像數據區（須在發佈第一幀之前），消費者只讀取
+    size_t prefault();
+    
+    // 生產者：以合成幀走一次寫入路徑（內容雜湊、編碼、灰階平面）但不發佈，讓工作區配置到該尺寸
+    // 已發佈過幀時不覆寫圖像數據區，略過寫入
+    void warmUpWriter(const cv::Mat& sample);
     
+    // 在標頭中標示自己已完成預熱；生產者與消費者各有一個旗標，MONITOR 模式不標示
+    // 重新連接到重啟後的生產者時，會在新的標頭中重新標示
+    void setReady(bool ready = true);
+    
+    // 對方或自己是否已完成預熱（無鎖讀取）
+    bool isProducerReady() const { return shared_data_->producer.ready.load(std::memory_order_acquire) != 0; }
+    bool isConsumerReady() const { return shared_data_->consumer.ready.load(std::memory_order_acquire) != 0; }
+    
+    // 生產者：等待消費者完成預熱後再發佈第一幀；逾時回傳 false
+    bool waitForConsumerReady(int timeout_ms = -1);
+
+    // 移除共享記憶體（靜態方法）；memfd 後端只移除代理的 socket 檔案
+    static bool remove(const std::string& name);
+
     // 獲取共享數據指針
     SharedImageData* getData() { return shared_data_; }
+    
+    // 獲取圖像數據指針
+    char* frameData() { return shared_data_->frameData(); }
 
 private:
     std::string name_;                          // 共享記憶體名稱
     bip::shared_memory_object shm_;             // 共享記憶體物件
     bip::mapped_region region_;                 // 映射區域
+    bool use_memfd_;                            // 是否使用 memfd 後端
+    MemfdOptions memfd_options_;                // memfd 後端的選項
+    MemfdSegment memfd_;                        // memfd 後端的映射
+    std::unique_ptr<SegmentBroker> broker_;     // 生產者：把 memfd 交給消費者的代理
     SharedImageData* shared_data_;              // 共享數據指針
     size_t max_image_size_;                     // 最大圖像大小
     bool is_creator_;                           // 是否為創建者
-};
+    SharedMemoryMode mode_;                     // 連接方式
+    uint64_t generation_ = 0;                   // 連接時的世代
+    uint64_t claimed_count_ = 0;                // 消費者目前處理中的幀對應的 published_count
+    std::chrono::steady_clock::time_point claim_time_;  // 消費者讀取這一幀的時間
+    double service_time_us_ = 0;                // 消費者處理時間的移動平均
+    int resolution_tier_ = 0;                   // 生產者寫入時的解析度層級
+    uint32_t source_id_ = 0;                    // 生產者的來源編號
+    uint64_t next_sequence_ = 1;                // 生產者下一幀的序號
+    int64_t last_publish_ns_ = 0;               // 生產者上一次發佈的時間
+    double publish_interval_us_ = 0;            // 生產者發佈間隔的移動平均
+    FrameInfo current_frame_;                   // 消費者目前處理中的幀
+    int current_tier_ = 0;                      // 消費者目前處理中的幀的解析度層級
+    double late_threshold_ms_ = 100.0;          // 遲到門檻
+    mutable std::mutex stats_mutex_;            // 保護 transport_stats_
+    FrameTransportStats transport_stats_;       // 消費者的傳輸統計
+    uint64_t last_sequence_ = 0;                // 最後讀取的幀序號 (世代切換時歸零)
+    FrameEncoding encoding_ = FrameEncoding::RAW;  // 生產者寫入時使用的編碼
+    bool publish_luma_ = false;                 // 生產者是否發佈灰階平面
+    bool content_hash_ = false;                 // 生產者是否一律計算內容雜湊
+    bool hash_requested_ = false;               // 消費者是否已在標頭中要求內容雜湊
+    cv::Mat encode_workspace_;                  // 編碼的中間緩衝區
+    bool ready_ = false;                        // 是否已在標頭中標示完成預熱
+    bool verbose_ = false;                      // 是否輸出每幀的訊息
+    int worker_slot_ = -1;                      // 消費者：在標頭中佔用的指標格，-1 表示沒有
 
+    // 心跳執行緒
+    std::thread heartbeat_thread_;
+    std::mutex heartbeat_mutex_;                // 保護 shared_data_ 在重新連接時的切換
+    std::condition_variable heartbeat_cond_;
+    bool heartbeat_running_ = false;
+    
+    // 事件通知：綁定在抽象命名空間的 datagram socket，由發出通知的進程直接寫入
+    std::mutex event_mutex_;                    // 保護 event_fd_ 與重新連接時訂閱的切換
+    int event_fd_ = -1;
+    uint64_t event_token_ = 0;                  // 本連接在訂閱表中的編號，0 表示尚未訂閱
+
+    // 在標頭的訂閱表中登記本連接，表已滿時回傳 false（需持有 event_mutex_）
+    bool subscribeEvents(SharedImageData* data);
+    
+    // 從標頭的訂閱表移除本連接（需持有 event_mutex_）
+    void unsubscribeEvents(SharedImageData* data);
+    
+    // 通知訂閱表中的其他連接；socket 已不存在（進程已結束）的訂閱者從表中移除
+    void signalEvent();
+
+    // 生產者：這一幀是否需要計算內容雜湊
+    bool contentHashWanted() const {
+        return content_hash_ || shared_data_->consumer.hash_requested.load(std::memory_order_relaxed) != 0;
+    }
+
+    // 創建共享記憶體，必要時回收失效的舊共享記憶體
+    void create();
+
+    // 打開已存在的共享記憶體並登記為消費者
+    void open();
+    
+    // 檢查標頭的識別碼、版本與 ABI
+    static bool validateHeader(const SharedImageData* data, size_t region_size, std::string* reason = nullptr);
+
+    // 檢查同名的舊共享記憶體是否已無人使用，回傳舊的世代 (無法回收時拋出例外)
+    uint64_t reclaimStale();
+
+    // 心跳循環
+    void heartbeatLoop();
+    
+    // 生產者：把圖像（依設定編碼）與灰階平面寫入數據區，回傳實際使用的編碼（需持有鎖）
+    FrameEncoding storePayload(const cv::Mat& image, size_t& payload_size, bool& fuse_luma);
+
+    // 消費者：記錄讀取了哪一幀並依序號更新統計（需持有鎖）
+    // WORKER 模式下這一幀已被其他工作進程讀取時回傳 false
+    bool claimCurrentFrame();
+    
+    // 消費者：是否有可讀取的新圖像
+    bool frameAvailable() const;
+    
+    // 消費者：讀取灰階平面並記錄這一幀；copy 為 false 時生產者的灰階平面以視圖回傳
+    cv::Mat readLumaPlane(bool copy);
+    
+    // 工作進程：登記的消費者已失效時接手消費者身份與心跳
+    void adoptConsumerIdentity();
+    
+    // 消費者：佔用一個指標格（空格或心跳已逾時的格子），沒有可用的格子時不回報指標
+    void claimWorkerSlot();
+    
+    // 消費者：釋放佔用的指標格
+    void releaseWorkerSlot();
+    
+    // 指標格的心跳是否未逾時
+    static bool workerSlotLive(const SharedImageData::WorkerSlot& slot, int64_t now_ns);
+    
+    // 消費者：處理完成時記錄端到端延遲（需持有鎖）
+    void recordCompletion();
+    
+    // 判斷某個角色是否存活
+    bool isAlive(int32_t pid, int64_t heartbeat_ns) const;
+    
+    // 目前映射區域的起點與大小（兩種後端）
+    void* segmentAddress() const { return use_memfd_ ? memfd_.address() : region_.get_address(); }
+    size_t segmentSize() const { return use_memfd_ ? memfd_.size() : region_.get_size(); }
+};
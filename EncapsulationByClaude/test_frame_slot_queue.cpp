@@ -0,0 +1,303 @@
+// test_frame_slot_queue.cpp
+// FrameSlotQueue 的測試：多執行緒放入/取出不遺失也不重複、各生產者的公平配額，以及崩潰進程留下的狀態
+// 同一進程中的多個 FrameSlotQueue 物件各自登記為不同的生產者；崩潰以 fork() 後的 _exit() 模擬
+#include "frame_slot_queue.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "失敗: " << message << std::endl;
+        failures++;
+    }
+}
+
+std::string queueName(const char* suffix) {
+    return "test_frame_slot_queue_" + std::to_string(getpid()) + "_" + suffix;
+}
+
+// 幀的內容由生產者編號與序號決定，取出時據此驗證數據沒有被其他幀覆寫
+uint8_t frameValue(uint32_t producer_id, uint64_t sequence) {
+    return static_cast<uint8_t>(producer_id * 31 + sequence * 7);
+}
+
+bool frameMatches(const cv::Mat& image, const FrameInfo& info) {
+    const uint8_t expected = frameValue(info.source_id, info.sequence);
+    for (int y = 0; y < image.rows; y++) {
+        const uint8_t* row = image.ptr<uint8_t>(y);
+        for (int x = 0; x < image.cols; x++) {
+            if (row[x] != expected) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 多個生產者與消費者執行緒同時存取：每一幀恰好被取出一次，內容正確
+void testConcurrentPushPop() {
+    const std::string name = queueName("concurrent");
+    FrameSlotQueue::remove(name);
+
+    constexpr int PRODUCERS = 4;
+    constexpr int CONSUMERS = 3;
+    constexpr uint64_t FRAMES_PER_PRODUCER = 2000;
+
+    SlotQueueConfig config;
+    config.slot_count = 8;
+    config.slot_capacity = 32 * 32;
+    FrameSlotQueue owner(name, config);
+
+    std::vector<std::unique_ptr<FrameSlotQueue>> producers;
+    for (int i = 0; i < PRODUCERS; i++) {
+        producers.push_back(std::make_unique<FrameSlotQueue>(name));
+        producers.back()->registerProducer();
+    }
+
+    std::atomic<bool> producing(true);
+    std::atomic<int> corrupted(0);
+    std::vector<std::vector<std::pair<uint32_t, uint64_t>>> received(CONSUMERS);
+
+    std::vector<std::thread> consumer_threads;
+    for (int c = 0; c < CONSUMERS; c++) {
+        consumer_threads.emplace_back([&, c] {
+            FrameSlotQueue queue(name);
+            cv::Mat image;
+            FrameInfo info;
+            // 生產者結束後繼續取到佇列為空為止
+            while (producing || queue.size() > 0) {
+                if (!queue.pop(image, &info, 10)) {
+                    continue;
+                }
+                if (!frameMatches(image, info)) {
+                    corrupted++;
+                }
+                received[c].emplace_back(info.source_id, info.sequence);
+            }
+        });
+    }
+
+    std::vector<std::thread> producer_threads;
+    for (int p = 0; p < PRODUCERS; p++) {
+        producer_threads.emplace_back([&, p] {
+            FrameSlotQueue& queue = *producers[p];
+            const uint32_t id = queue.registerProducer();
+            // 只有成功放入時序號才遞增，第 n 次成功的序號為 n
+            for (uint64_t sequence = 1; sequence <= FRAMES_PER_PRODUCER;) {
+                cv::Mat frame(16 + p, 16, CV_8UC1, cv::Scalar(frameValue(id, sequence)));
+                const PushResult result = queue.push(frame);
+                if (result == PushResult::OK) {
+                    sequence++;
+                } else if (result == PushResult::FULL || result == PushResult::THROTTLED) {
+                    std::this_thread::yield();
+                } else {
+                    corrupted++;
+                    return;
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : producer_threads) {
+        thread.join();
+    }
+    producing = false;
+    for (std::thread& thread : consumer_threads) {
+        thread.join();
+    }
+
+    std::set<std::pair<uint32_t, uint64_t>> unique;
+    size_t total = 0;
+    for (const auto& frames : received) {
+        total += frames.size();
+        unique.insert(frames.begin(), frames.end());
+    }
+    check(corrupted == 0, "取出的幀內容與生產者寫入的不符");
+    check(total == PRODUCERS * FRAMES_PER_PRODUCER,
+          "取出 " + std::to_string(total) + " 幀，應為 " + std::to_string(PRODUCERS * FRAMES_PER_PRODUCER));
+    check(unique.size() == total, "有幀被取出不只一次");
+    for (const auto& producer : producers) {
+        const uint32_t id = producer->registerProducer();
+        check(unique.count({id, 1}) == 1 && unique.count({id, FRAMES_PER_PRODUCER}) == 1,
+              "生產者 #" + std::to_string(id) + " 的幀不完整");
+    }
+    check(owner.size() == 0, "所有幀取出後佇列應為空");
+}
+
+// 沒有消費者時，每個生產者最多佔用 槽位數 / 生產者數 個槽位；取出後名額歸還
+void testFairShare() {
+    const std::string name = queueName("fairness");
+    FrameSlotQueue::remove(name);
+
+    SlotQueueConfig config;
+    config.slot_count = 8;
+    config.slot_capacity = 16 * 16;
+    FrameSlotQueue consumer(name, config);
+    FrameSlotQueue busy(name);
+    FrameSlotQueue quiet(name);
+    const uint32_t busy_id = busy.registerProducer();
+    const uint32_t quiet_id = quiet.registerProducer();
+
+    check(busy.fairShare() == 4 && quiet.fairShare() == 4, "兩個生產者時配額應為 4");
+
+    const cv::Mat frame(16, 16, CV_8UC1, cv::Scalar(0));
+    int busy_accepted = 0;
+    for (int i = 0; i < 8; i++) {
+        const PushResult result = busy.push(frame);
+        if (result == PushResult::OK) {
+            busy_accepted++;
+        } else {
+            check(result == PushResult::THROTTLED, std::string("超過配額時應為 THROTTLED，實際為 ") + pushResultName(result));
+        }
+    }
+    check(busy_accepted == 4, "頻繁發佈的生產者放入 " + std::to_string(busy_accepted) + " 幀，應為 4");
+
+    // 頻繁發佈的生產者沒有佔滿佇列，另一個生產者仍有自己的名額
+    int quiet_accepted = 0;
+    for (int i = 0; i < 4; i++) {
+        quiet_accepted += quiet.push(frame) == PushResult::OK ? 1 : 0;
+    }
+    check(quiet_accepted == 4, "另一個生產者放入 " + std::to_string(quiet_accepted) + " 幀，應為 4");
+    check(quiet.push(frame) != PushResult::OK, "佇列已滿時不應再放入");
+
+    // 依放入順序取出，各生產者的幀數與配額相同
+    int from_busy = 0;
+    int from_quiet = 0;
+    cv::Mat image;
+    FrameInfo info;
+    while (consumer.pop(image, &info, 0)) {
+        from_busy += info.source_id == busy_id ? 1 : 0;
+        from_quiet += info.source_id == quiet_id ? 1 : 0;
+    }
+    check(from_busy == 4 && from_quiet == 4,
+          "取出 " + std::to_string(from_busy) + " + " + std::to_string(from_quiet) + " 幀，應為 4 + 4");
+
+    // 取出後名額歸還
+    check(busy.push(frame) == PushResult::OK, "取出後生產者應能再次放入");
+    for (const SlotQueueProducerStats& stats : consumer.producerStats()) {
+        if (stats.producer_id == busy_id) {
+            check(stats.in_flight == 1 && stats.pushed == 5 && stats.throttled == 4, "生產者統計不正確");
+        }
+    }
+}
+
+uint32_t inFlight(const FrameSlotQueue& queue, uint32_t producer_id) {
+    for (const SlotQueueProducerStats& stats : queue.producerStats()) {
+        if (stats.producer_id == producer_id) {
+            return stats.in_flight;
+        }
+    }
+    return 0;
+}
+
+bool queueExists(const std::string& name) {
+    const int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+// 崩潰的生產者留在佇列中的幀被取出時，不扣到接手同一格的新生產者的名額
+void testCrashedProducer() {
+    const std::string name = queueName("crashed_producer");
+    FrameSlotQueue::remove(name);
+
+    SlotQueueConfig config;
+    config.slot_count = 8;
+    config.slot_capacity = 16 * 16;
+    FrameSlotQueue consumer(name, config);
+    const cv::Mat frame(16, 16, CV_8UC1, cv::Scalar(0));
+
+    const pid_t child = fork();
+    if (child == 0) {
+        FrameSlotQueue crashed(name);
+        crashed.registerProducer();
+        for (int i = 0; i < 3; i++) {
+            crashed.push(frame);
+        }
+        _exit(0);  // 不經過解構函數，佔用的生產者與連接格子都留在共享記憶體中
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    FrameSlotQueue producer(name);
+    const uint32_t producer_id = producer.registerProducer();
+    check(producer_id == 1, "新的生產者應接手崩潰生產者的格子，實際為 " + std::to_string(producer_id));
+    check(producer.push(frame) == PushResult::OK, "新的生產者應能放入");
+
+    // 先取出崩潰的生產者留下的 3 幀
+    cv::Mat image;
+    for (int i = 0; i < 3; i++) {
+        consumer.pop(image, nullptr, 0);
+    }
+    check(inFlight(consumer, producer_id) == 1,
+          "取出舊的幀後新生產者的在途幀數為 " + std::to_string(inFlight(consumer, producer_id)) + "，應為 1");
+    check(consumer.pop(image, nullptr, 0), "應能取出新生產者的幀");
+    check(inFlight(consumer, producer_id) == 0, "取出後新生產者的在途幀數應為 0");
+}
+
+// 崩潰的進程留下的連接不妨礙最後一個連接移除佇列；初始化未完成的殘留佇列會被重新建立
+void testStaleAttachments() {
+    const std::string name = queueName("stale");
+    FrameSlotQueue::remove(name);
+
+    {
+        FrameSlotQueue owner(name);
+        const pid_t child = fork();
+        if (child == 0) {
+            FrameSlotQueue crashed(name);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+    }
+    check(!queueExists(name), "崩潰的進程留下連接時佇列沒有被移除");
+
+    // 創建者在設置大小前就已終止：等待逾時後移除並重新建立
+    const int fd = shm_open(("/" + name).c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    check(fd >= 0, "無法建立殘留的共享記憶體");
+    if (fd >= 0) {
+        close(fd);
+    }
+    try {
+        FrameSlotQueue recovered(name);
+        recovered.registerProducer();
+        check(recovered.push(cv::Mat(16, 16, CV_8UC1, cv::Scalar(0))) == PushResult::OK && recovered.size() == 1,
+              "重新建立的佇列應能放入");
+    } catch (const std::exception& ex) {
+        check(false, std::string("殘留的佇列沒有被重新建立: ") + ex.what());
+    }
+    check(!queueExists(name), "重新建立的佇列在最後一個連接斷開後應被移除");
+}
+
+} // namespace
+
+int main() {
+    testConcurrentPushPop();
+    testFairShare();
+    testCrashedProducer();
+    testStaleAttachments();
+
+    if (failures != 0) {
+        std::cerr << failures << " 項檢查失敗" << std::endl;
+        return 1;
+    }
+    std::cout << "FrameSlotQueue 測試通過" << std::endl;
+    return 0;
+}
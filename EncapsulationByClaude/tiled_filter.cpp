@@ -0,0 +1,154 @@
+// tiled_filter.cpp
+#include "tiled_filter.h"
+#include "frame_kernels.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace {
+
+// 條帶至少的列數，太薄時光暈的重複計算比例過高
+constexpr int MIN_BAND_ROWS = 16;
+
+// 將 [y0, y1) 列轉為 8 位元灰階
+void grayRows(const cv::Mat& src, cv::Mat& gray, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        uint8_t* dst = gray.ptr<uint8_t>(y);
+        switch (src.type()) {
+            case CV_8UC3:  frame_kernels::grayRow<uint8_t, 3>(src.ptr<uint8_t>(y), dst, src.cols); break;
+            case CV_8UC4:  frame_kernels::grayRow<uint8_t, 4>(src.ptr<uint8_t>(y), dst, src.cols); break;
+            case CV_16UC1: frame_kernels::grayRow<uint16_t, 1>(src.ptr<uint16_t>(y), dst, src.cols); break;
+        }
+    }
+}
+
+// 與 OpenCV getThreshVal_Otsu_8u 相同的計算順序，確保閾值一致
+double otsuThreshold(const uint32_t* hist, size_t total) {
+    const double scale = 1.0 / static_cast<double>(total);
+    double mu = 0;
+    for (int i = 0; i < 256; i++) {
+        mu += i * static_cast<double>(hist[i]);
+    }
+    mu *= scale;
+
+    double mu1 = 0, q1 = 0;
+    double max_sigma = 0, max_val = 0;
+    for (int i = 0; i < 256; i++) {
+        const double p_i = hist[i] * scale;
+        mu1 *= q1;
+        q1 += p_i;
+        const double q2 = 1.0 - q1;
+
+        if (std::min(q1, q2) < FLT_EPSILON || std::max(q1, q2) > 1.0 - FLT_EPSILON) continue;
+
+        mu1 = (mu1 + i * p_i) / q1;
+        const double mu2 = (mu - q1 * mu1) / q2;
+        const double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+        if (sigma > max_sigma) {
+            max_sigma = sigma;
+            max_val = i;
+        }
+    }
+    return max_val;
+}
+
+} // namespace
+
+TiledBlurThreshold::TiledBlurThreshold(WorkStealingPool& pool, int band_count)
+    : pool_(pool), band_count_(band_count) {}
+
+bool TiledBlurThreshold::supports(int type, int ksize) {
+    const bool type_ok = type == CV_8UC1 || type == CV_8UC3 || type == CV_8UC4 || type == CV_16UC1;
+    const bool ksize_ok = ksize == 3 || ksize == 5 || ksize == 7;
+    return type_ok && ksize_ok;
+}
+
+template <int K>
+void TiledBlurThreshold::blurBand(const cv::Mat& gray, cv::Mat& blurred, int band, int y0, int y1) {
+    constexpr int R = K / 2;
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+
+    // 水平方向：本條帶的列加上下各 R 列光暈，光暈以反射映射到圖內的列
+    cv::Mat& workspace = band_workspace_[band];
+    workspace.create(y1 - y0 + 2 * R, cols, CV_16UC1);
+    for (int j = 0; j < workspace.rows; j++) {
+        const int src_y = frame_kernels::reflect101(y0 - R + j, rows);
+        frame_kernels::blurRowHorizontal<K>(gray.ptr<uint8_t>(src_y), workspace.ptr<uint16_t>(j), cols);
+    }
+
+    // 垂直方向，同時統計直方圖
+    std::array<uint32_t, 256>& hist = band_hist_[band];
+    hist.fill(0);
+    const uint16_t* taps[K];
+    for (int y = y0; y < y1; y++) {
+        for (int k = 0; k < K; k++) {
+            // 與序列版相同：邊界列先反射到圖內，再換算成條帶內的位置
+            const int src_y = frame_kernels::reflect101(y + k - R, rows);
+            taps[k] = workspace.ptr<uint16_t>(src_y - (y0 - R));
+        }
+        uint8_t* dst = blurred.ptr<uint8_t>(y);
+        frame_kernels::blurRowVertical<K>(taps, dst, cols);
+        for (int x = 0; x < cols; x++) {
+            hist[dst[x]]++;
+        }
+    }
+}
+
+double TiledBlurThreshold::apply(const cv::Mat& src, int ksize, cv::Mat& blurred, cv::Mat& binary) {
+    CV_Assert(supports(src.type(), ksize));
+
+    const int rows = src.rows;
+    const int cols = src.cols;
+    blurred.create(rows, cols, CV_8UC1);
+    binary.create(rows, cols, CV_8UC1);
+
+    int bands = band_count_ > 0 ? band_count_ : static_cast<int>(pool_.concurrency() * 4);
+    bands = std::max(1, std::min(bands, rows / MIN_BAND_ROWS));
+    band_workspace_.resize(bands);
+    band_hist_.resize(bands);
+    auto bandBegin = [rows, bands](int b) { return static_cast<int>(static_cast<int64_t>(rows) * b / bands); };
+
+    // 灰階轉換：模糊的光暈需要相鄰條帶的灰階，因此先全部轉完
+    const cv::Mat* gray = &src;
+    if (src.type() != CV_8UC1) {
+        gray_.create(rows, cols, CV_8UC1);
+        pool_.parallelFor(bands, [&](size_t b) {
+            grayRows(src, gray_, bandBegin(b), bandBegin(b + 1));
+        });
+        gray = &gray_;
+    }
+
+    // 模糊並統計各條帶的直方圖
+    pool_.parallelFor(bands, [&](size_t b) {
+        const int y0 = bandBegin(b);
+        const int y1 = bandBegin(b + 1);
+        switch (ksize) {
+            case 3: blurBand<3>(*gray, blurred, b, y0, y1); break;
+            case 5: blurBand<5>(*gray, blurred, b, y0, y1); break;
+            case 7: blurBand<7>(*gray, blurred, b, y0, y1); break;
+        }
+    });
+
+    // 合併直方圖並計算 Otsu 閾值
+    std::array<uint32_t, 256> hist{};
+    for (int b = 0; b < bands; b++) {
+        for (int i = 0; i < 256; i++) {
+            hist[i] += band_hist_[b][i];
+        }
+    }
+    const double thresh = otsuThreshold(hist.data(), static_cast<size_t>(rows) * cols);
+
+    // 二值化 (THRESH_BINARY_INV)
+    const uint8_t level = static_cast<uint8_t>(thresh);
+    pool_.parallelFor(bands, [&](size_t b) {
+        for (int y = bandBegin(b); y < bandBegin(b + 1); y++) {
+            const uint8_t* in = blurred.ptr<uint8_t>(y);
+            uint8_t* out = binary.ptr<uint8_t>(y);
+            for (int x = 0; x < cols; x++) {
+                out[x] = in[x] > level ? 0 : 255;
+            }
+        }
+    });
+
+    return thresh;
+}
@@ -0,0 +1,35 @@
+// tiled_filter.h
+#pragma once
+
+#include "work_stealing_pool.h"
+#include <opencv2/opencv.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// 單幀內平行的 灰階 → 高斯模糊 → Otsu 二值化
+// 畫面切成水平條帶，每個條帶帶 K/2 列的光暈做模糊，並統計自己那幾列的直方圖；
+// 合併各條帶的直方圖後算出 Otsu 閾值，再平行二值化
+// 與 selectGrayBlurKernel() + cv::threshold(THRESH_BINARY_INV | THRESH_OTSU) 的結果逐位元相同
+class TiledBlurThreshold {
+public:
+    // band_count：條帶數，0 表示依執行緒池大小決定（多切幾條讓工作竊取平衡負載）
+    explicit TiledBlurThreshold(WorkStealingPool& pool, int band_count = 0);
+
+    // 是否支援此圖像類型與模糊核大小
+    static bool supports(int type, int ksize);
+
+    // 處理一幀，回傳 Otsu 閾值；binary 為 THRESH_BINARY_INV 的結果
+    double apply(const cv::Mat& src, int ksize, cv::Mat& blurred, cv::Mat& binary);
+
+private:
+    WorkStealingPool& pool_;
+    int band_count_;
+    cv::Mat gray_;                                      // 非 8 位元灰階輸入時的轉換結果
+    std::vector<cv::Mat> band_workspace_;               // 每個條帶的水平模糊結果（含光暈）
+    std::vector<std::array<uint32_t, 256>> band_hist_;  // 每個條帶的模糊值直方圖
+
+    // 模糊並統計直方圖
+    template <int K>
+    void blurBand(const cv::Mat& gray, cv::Mat& blurred, int band, int y0, int y1);
+};
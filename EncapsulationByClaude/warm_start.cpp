@@ -0,0 +1,66 @@
+// warm_start.cpp
+#include "warm_start.h"
+#include <algorithm>
+#include <cstdint>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 舊的標頭檔沒有這兩個值 (Linux 5.14 起支援)
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+size_t prefaultMemory(void* address, size_t size, bool write) {
+    if (address == nullptr || size == 0) {
+        return 0;
+    }
+
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+    const uintptr_t end = begin + size;
+    // madvise 要求起點對齊分頁
+    const uintptr_t aligned = begin & ~(page_size - 1);
+    const size_t pages = (end - aligned + page_size - 1) / page_size;
+
+    if (madvise(reinterpret_cast<void*>(aligned), end - aligned, write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0) {
+        return pages;
+    }
+
+    // 退回逐頁存取；第一頁從區域起點開始，不觸碰區域外的數據
+    uint8_t sink = 0;
+    for (uintptr_t addr = begin; addr < end; addr = (addr & ~(page_size - 1)) + page_size) {
+        volatile uint8_t* byte = reinterpret_cast<volatile uint8_t*>(addr);
+        if (write) {
+            *byte = 0;
+        } else {
+            sink ^= *byte;
+        }
+    }
+    (void)sink;
+    return pages;
+}
+
+cv::Mat makeWarmUpFrame(const cv::Size& size, int type) {
+    const double full = CV_MAT_DEPTH(type) == CV_16U ? 65535.0 : 255.0;
+    cv::Mat frame(size, type, cv::Scalar::all(full * 0.8));
+
+    // 格狀排列、大小不一的物體，面積有的低於、有的高於預設的最小面積
+    constexpr int SPACING = 64;
+    const int radii[] = {8, 16, 24};
+    for (int y = SPACING / 2; y < size.height; y += SPACING) {
+        for (int x = SPACING / 2; x < size.width; x += SPACING) {
+            const int radius = radii[(x / SPACING + y / SPACING) % 3];
+            cv::circle(frame, cv::Point(x, y), radius, cv::Scalar::all(full * 0.2), cv::FILLED);
+        }
+    }
+    return frame;
+}
+
+void warmOpenCvThreads() {
+    // 每個執行緒分到一份空工作，迫使執行緒池建立所有工作執行緒
+    const int threads = std::max(1, cv::getNumThreads());
+    cv::parallel_for_(cv::Range(0, threads), [](const cv::Range&) {}, threads);
+}
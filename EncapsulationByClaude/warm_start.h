@@ -0,0 +1,26 @@
+// warm_start.h
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+
+// 啟動預熱的共用工具：讓第一幀不必承擔分頁錯誤、緩衝區配置與執行緒池啟動的成本
+
+// 預熱設定
+struct WarmUpConfig {
+    cv::Size max_size = cv::Size(1920, 1080);   // 預先配置工作區所依據的最大解析度
+    int type = CV_8UC3;                         // 合成幀的圖像類型
+    int max_resolution_tier = 0;                // 速率控制可能降到的最大解析度層級 (RateControlConfig::max_resolution_tier)，
+                                                // 處理者在每一層的尺寸各預熱一次
+};
+
+// 逐頁觸碰一段記憶體，使分頁在第一幀之前就映射好
+// write 為 true 時以寫入觸發（退回逐頁存取時每頁會寫入一個 0，只能用於尚未存放數據的區域），否則只讀取
+// 優先使用 MADV_POPULATE_READ/WRITE 一次完成，核心不支援時退回逐頁存取；回傳觸碰的分頁數
+size_t prefaultMemory(void* address, size_t size, bool write);
+
+// 產生預熱用的合成幀：亮背景上散佈不同大小的暗色物體，讓二值化與物體擷取走完整的路徑
+cv::Mat makeWarmUpFrame(const cv::Size& size, int type);
+
+// 啟動 OpenCV 的執行緒池（第一次 parallel_for_ 時才建立工作執行緒）
+void warmOpenCvThreads();
@@ -0,0 +1,150 @@
+// work_stealing_pool.cpp
+#include "work_stealing_pool.h"
+#include <exception>
+
+// 一次 parallelFor 的狀態，存放在呼叫端的堆疊上
+struct WorkStealingPool::Batch {
+    const std::function<void(size_t)>* fn;
+    size_t remaining;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+WorkStealingPool::WorkStealingPool(size_t worker_count) {
+    if (worker_count == 0) {
+        const size_t cores = std::thread::hardware_concurrency();
+        worker_count = cores > 1 ? cores - 1 : 0;
+    }
+
+    for (size_t i = 0; i < worker_count; i++) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < worker_count; i++) {
+        workers_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    sleep_cond_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void WorkStealingPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+
+    // 沒有工作執行緒或只有一個工作時直接在呼叫端執行
+    if (queues_.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.fn = &fn;
+    batch.remaining = count;
+
+    // 依序分配到各佇列；相鄰的工作落在不同執行緒上
+    for (size_t i = 0; i < count; i++) {
+        Queue& queue = *queues_[i % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(Task{&batch, i});
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        pending_.fetch_add(static_cast<int64_t>(count), std::memory_order_release);
+    }
+    sleep_cond_.notify_all();
+
+    // 呼叫端也參與：竊取任何佇列中的工作（可能包含其他批次的工作）
+    Task task;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            if (batch.remaining == 0) break;
+        }
+        if (!steal(0, queues_.size(), task)) break;
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+        run(task);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(batch.mutex);
+        batch.done.wait(lock, [&batch] { return batch.remaining == 0; });
+    }
+
+    if (batch.error) {
+        std::rethrow_exception(batch.error);
+    }
+}
+
+void WorkStealingPool::workerLoop(size_t self) {
+    Task task;
+    while (true) {
+        if (popLocal(self, task) || steal(self + 1, self, task)) {
+            pending_.fetch_sub(1, std::memory_order_acq_rel);
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleep_cond_.wait(lock, [this] { return stopping_ || pending_.load(std::memory_order_acquire) > 0; });
+        if (stopping_ && pending_.load(std::memory_order_acquire) <= 0) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::popLocal(size_t self, Task& task) {
+    Queue& queue = *queues_[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t start, size_t skip, Task& task) {
+    const size_t n = queues_.size();
+    for (size_t i = 0; i < n; i++) {
+        const size_t victim = (start + i) % n;
+        if (victim == skip) continue;
+
+        Queue& queue = *queues_[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        stolen_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::run(const Task& task) {
+    Batch* batch = task.batch;
+    std::exception_ptr error;
+    try {
+        (*batch->fn)(task.index);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // 在鎖內遞減，呼叫端看到 0 之後才可能釋放 batch
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    if (error && !batch->error) {
+        batch->error = error;
+    }
+    if (--batch->remaining == 0) {
+        batch->done.notify_all();
+    }
+}
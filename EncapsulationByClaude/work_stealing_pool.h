@@ -0,0 +1,69 @@
+// work_stealing_pool.h
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作竊取執行緒池，用於單幀內的平行處理
+// 每個工作執行緒有自己的佇列，從尾端取自己的工作，閒置時從其他佇列的前端竊取
+// parallelFor() 的呼叫端執行緒也會參與執行，因此巢狀呼叫不會鎖死
+class WorkStealingPool {
+public:
+    // worker_count：背景工作執行緒數，0 表示 CPU 核心數減一（呼叫端執行緒補上最後一個核心）
+    explicit WorkStealingPool(size_t worker_count = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // 平行執行 fn(0) ... fn(count - 1)，全部完成後返回；fn 拋出的第一個例外會在這裡重新拋出
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    // 參與執行的執行緒數（含呼叫端）
+    size_t concurrency() const { return queues_.size() + 1; }
+
+    // 不是由原本分配到的工作執行緒執行的工作數（被竊取或由呼叫端代為執行）
+    uint64_t stolenCount() const { return stolen_.load(std::memory_order_relaxed); }
+
+private:
+    struct Batch;
+
+    struct Task {
+        Batch* batch;
+        size_t index;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;   // 每個工作執行緒一個
+    std::vector<std::thread> workers_;
+    std::atomic<uint64_t> stolen_{0};
+
+    // 閒置的工作執行緒在此等待；pending_ 為已排入但尚未取出的工作數
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cond_;
+    std::atomic<int64_t> pending_{0};
+    bool stopping_ = false;
+
+    void workerLoop(size_t self);
+
+    // 從自己的佇列尾端取工作
+    bool popLocal(size_t self, Task& task);
+
+    // 從其他佇列前端竊取，從 start 開始輪流嘗試
+    bool steal(size_t start, size_t skip, Task& task);
+
+    // 執行一個工作並更新所屬批次的完成計數
+    void run(const Task& task);
+};